@@ -1,4 +1,10 @@
 -- premake5.lua
+newoption
+{
+	trigger = "depth16",
+	description = "Store the software raycaster's depth buffer as 16-bit normalised values (uploaded as R16) instead of floats"
+}
+
 workspace "Spear"
 	architecture "x64"
 	configurations { "Debug", "Release", "Shipping" }
@@ -19,10 +25,19 @@ workspace "Spear"
 		"SpearEngine/Source"
 	}
 
+	-- Must be consistent across Engine & Game, as it changes the Renderer's background depth interface
+	filter "options:depth16"
+		defines { "SPEAR_DEPTH16" }
+	filter {}
+
 OutputDir = "%{cfg.system}-%{cfg.architecture}/%{cfg.buildcfg}"
 
 group "Engine"
 	include "SpearEngine/Build-Engine.lua"
 group ""
 
-include "SpearGame/Build-Game.lua"
\ No newline at end of file
+include "SpearGame/Build-Game.lua"
+
+group "Tools"
+	include "SpearBenchmark/Build-Benchmark.lua"
+group ""
\ No newline at end of file
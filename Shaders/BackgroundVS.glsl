@@ -1,5 +1,7 @@
 #version 410 core
 
+uniform vec2 texCoordScale; // portion of the background texture covered by the current frame
+
 out vec2 v_texCoord;
 
 void main() 
@@ -17,5 +19,5 @@ void main()
 	uvCoords[3] = vec2(1, 1);
 	
 	gl_Position = vec4(linePoints[gl_VertexID].xy, 0.0, 1.0);	
-	v_texCoord = uvCoords[gl_VertexID];
+	v_texCoord = uvCoords[gl_VertexID] * texCoordScale;
 }
\ No newline at end of file
@@ -24,6 +24,9 @@ struct RaycasterConfig
 	int yResolution;
 	int rayEncounterLimit;
 	float scale2D;
+	bool dynamicResolution;
+	float dynamicResolutionTargetMs;
+	float dynamicResolutionMinScale;
 	bool highlightCorrectivePixels;
 	float correctivePixelDepthTolerance;
 };
@@ -58,6 +61,8 @@ struct SpriteData
 	ivec2 spriteEnd;
 	int spriteTex;
 	float spriteDepth;
+	int portalTrace;	// always 0 here: clones seen through mirrors/portals are only made for the software renderer
+	int portalWindow;
 };
 
 // UBOs
@@ -71,14 +76,25 @@ layout(std430, binding = 2) buffer GridNodes { GridNode nodes[]; };
 layout(binding = 3) uniform sampler2DArray worldTextures;
 layout(binding = 4) uniform sampler2DArray spriteTextures;
 layout(std430, binding = 5) buffer SpritesData { SpriteData spriteData[]; };
+layout(std430, binding = 7) buffer ChunkSlots { int chunkSlots[]; }; // GridNodes/TileFlags slot per map chunk, see MapData::NodeIndex
 
 // UNIFORMS
 layout(location = 0) uniform ivec2 gridDimensions;
 layout(location = 1) uniform int spriteCount;
+layout(location = 2) uniform int chunksX;
 
 // eLevelTexture definitions
 const int TEX_NONE = -1;
 
+// MapData chunk definitions
+const int MAP_CHUNK_SHIFT = 4;
+const int MAP_CHUNK_MASK = (1 << MAP_CHUNK_SHIFT) - 1;
+
+int GetNodeIndex(int x, int y)
+{
+	return (chunkSlots[(x >> MAP_CHUNK_SHIFT) + ((y >> MAP_CHUNK_SHIFT) * chunksX)] << (2 * MAP_CHUNK_SHIFT)) + (x & MAP_CHUNK_MASK) + ((y & MAP_CHUNK_MASK) << MAP_CHUNK_SHIFT);
+}
+
 // eRayHit definitions
 const int RAY_NOHIT = 0;
 const int RAY_HIT_FRONT = 1;
@@ -116,7 +132,7 @@ void main()
 	int rayPitch;
 	if(bIsFloor)
 	{		
-		rayPitch = int(((imageSize(outTexture).y - screen.y - 1) - (rayConfig.yResolution / 2)) + frame.viewPitch);
+		rayPitch = int(((rayConfig.yResolution - screen.y - 1) - (rayConfig.yResolution / 2)) + frame.viewPitch);
 	}
 	else
 	{
@@ -165,7 +181,7 @@ void main()
 
 			if(cellX < gridDimensions.x && cellY < gridDimensions.y && cellX >= 0 && cellY >= 0)
 			{
-				GridNode node = nodes[cellX + (cellY * gridDimensions.x)];
+				GridNode node = nodes[GetNodeIndex(cellX, cellY)];
 			
 				// Tex sampling
 				if ((bIsFloor && node.texIdFloor[layer] != TEX_NONE) || (!bIsFloor && node.texIdRoof[layer] != TEX_NONE))
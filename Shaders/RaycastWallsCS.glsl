@@ -24,6 +24,9 @@ struct RaycasterConfig
 	int yResolution;
 	int rayEncounterLimit;
 	float scale2D;
+	bool dynamicResolution;
+	float dynamicResolutionTargetMs;
+	float dynamicResolutionMinScale;
 	bool highlightCorrectivePixels;
 	float correctivePixelDepthTolerance;
 };
@@ -61,13 +64,33 @@ layout(rgba8, binding = 0) uniform image2D outTexture;
 layout(r32f, binding = 1) uniform image2D outDepth;
 layout(std430, binding = 2) buffer GridNodes { GridNode nodes[]; };
 layout(binding = 3) uniform sampler2DArray worldTextures;
+layout(std430, binding = 6) buffer TileFlags { uint tileFlags[]; }; // u8 eTileFlags per tile, packed 4 per uint
+layout(std430, binding = 7) buffer ChunkSlots { int chunkSlots[]; }; // GridNodes/TileFlags slot per map chunk, see MapData::NodeIndex
 
 // UNIFORMS
 layout(location = 0) uniform ivec2 gridDimensions;
+layout(location = 2) uniform int chunksX;
 
 // eLevelTexture definitions
 const int TEX_NONE = -1;
 
+// MapData chunk definitions
+const int MAP_CHUNK_SHIFT = 4;
+const int MAP_CHUNK_MASK = (1 << MAP_CHUNK_SHIFT) - 1;
+
+int GetNodeIndex(int x, int y)
+{
+	return (chunkSlots[(x >> MAP_CHUNK_SHIFT) + ((y >> MAP_CHUNK_SHIFT) * chunksX)] << (2 * MAP_CHUNK_SHIFT)) + (x & MAP_CHUNK_MASK) + ((y & MAP_CHUNK_MASK) << MAP_CHUNK_SHIFT);
+}
+
+// eTileFlags definitions
+const uint TILE_WALL = 1u << 0;
+
+uint GetTileFlags(int nodeIndex)
+{
+	return (tileFlags[nodeIndex >> 2] >> ((nodeIndex & 3) * 8)) & 0xFFu;
+}
+
 // eRayHit definitions
 const int RAY_NOHIT = 0;
 const int RAY_HIT_FRONT = 1;
@@ -229,13 +252,12 @@ void main()
 			// Check position is within range of array
 			if(mapCheck.x < gridDimensions.x && mapCheck.y < gridDimensions.y && mapCheck.x >= 0 && mapCheck.y >= 0)
 			{
-				wallNodeIndex = mapCheck.x + (mapCheck.y * gridDimensions.x);
-				node = nodes[wallNodeIndex];
+				wallNodeIndex = GetNodeIndex(mapCheck.x, mapCheck.y);
 					
-				// if tile has a wall texture and is tall enough to be visible...
-				const bool wallExists = node.texIdWall != TEX_NONE || (node.extendUp != 0 && node.texIdRoof[0] != TEX_NONE) || (node.extendDown != 0 && node.texIdFloor[0] != TEX_NONE);
-				if (wallExists)
+				// if tile has a wall texture and is tall enough to be visible... (full node is only fetched on a hit)
+				if ((GetTileFlags(wallNodeIndex) & TILE_WALL) != 0)
 				{
+					node = nodes[wallNodeIndex];
 					rayHit = side ? RAY_HIT_SIDE : RAY_HIT_FRONT;
 					rayEncounters++;
 				}
@@ -251,7 +273,7 @@ void main()
 			const float halfHeight = (1 + (rayConfig.yResolution / 2) / depth) * frame.fovWallMultiplier;
 			const float fullHeight = halfHeight * 2;
 
-			int mid = int(frame.viewPitch + (imageSize(outTexture).y / 2));
+			int mid = int(frame.viewPitch + (rayConfig.yResolution / 2));
 			float bottom = mid - halfHeight;
 			float top = mid + halfHeight;
 
@@ -307,7 +329,7 @@ void main()
 					}
 
 					// If we go off the bottom of the screen, skip any pixels remaining in wall strip.
-					if (screenY >= imageSize(outTexture).y)
+					if (screenY >= rayConfig.yResolution)
 					{
 						break;
 					}
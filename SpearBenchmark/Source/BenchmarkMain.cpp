@@ -0,0 +1,288 @@
+#include "Core/Core.h"
+#include "Core/ServiceLocator.h"
+#include "Core/ThreadManager.h"
+#include "Graphics/ScreenRenderer.h"
+#include "Graphics/TextureArray.h"
+#include "GameObject/GameObject.h"
+
+#include "Raycaster/Raycaster.h"
+#include "Raycaster/RaycasterConfig.h"
+#include "LevelFileManager.h"
+#include "GlobalTextureBatches.h"
+#include "Objects/OLevelLink.h"
+#include "CameraPath.h"
+#include "BenchmarkReport.h"
+#include <thread>
+
+// Headless benchmark for the software raycaster
+// Usage: SpearBenchmark [--frames N] [--warmup N] [--load-runs N] [--convert] [--json path] [--csv path] [--columns] [--no-mips] [--half-rate-planes] [--fixed-dda] [Level.level ...]
+// Each level is rendered along CameraPaths/<LevelName>.path if present, otherwise along a default route from its spawn point
+// Level loads are timed from the text level and, when one exists, its binary counterpart (--convert writes these first)
+
+struct BenchmarkSettings
+{
+	int frames{ 600 };
+	int warmupFrames{ 30 };
+	int loadRuns{ 10 };
+	bool bConvertLevels{ false };
+	std::string jsonPath{ "BenchmarkResults.json" };
+	std::string csvPath{ "BenchmarkResults.csv" };
+	bool bColumnRendering{ false };
+	bool bMipmapping{ true };
+	bool bHalfRatePlanes{ false };
+	bool bFixedPointDDA{ false };
+	std::vector<std::string> levels;
+};
+
+static BenchmarkSettings ParseArguments(int argc, char* argv[])
+{
+	BenchmarkSettings settings;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool bHasValue = i + 1 < argc;
+		if (arg == "--frames" && bHasValue)
+		{
+			settings.frames = std::max(1, std::stoi(argv[++i]));
+		}
+		else if (arg == "--warmup" && bHasValue)
+		{
+			settings.warmupFrames = std::max(0, std::stoi(argv[++i]));
+		}
+		else if (arg == "--load-runs" && bHasValue)
+		{
+			settings.loadRuns = std::max(0, std::stoi(argv[++i]));
+		}
+		else if (arg == "--convert")
+		{
+			settings.bConvertLevels = true;
+		}
+		else if (arg == "--json" && bHasValue)
+		{
+			settings.jsonPath = argv[++i];
+		}
+		else if (arg == "--csv" && bHasValue)
+		{
+			settings.csvPath = argv[++i];
+		}
+		else if (arg == "--columns")
+		{
+			settings.bColumnRendering = true;
+		}
+		else if (arg == "--no-mips")
+		{
+			settings.bMipmapping = false;
+		}
+		else if (arg == "--half-rate-planes")
+		{
+			settings.bHalfRatePlanes = true;
+		}
+		else if (arg == "--fixed-dda")
+		{
+			settings.bFixedPointDDA = true;
+		}
+		else
+		{
+			settings.levels.push_back(arg);
+		}
+	}
+
+	if (settings.levels.empty())
+	{
+		settings.levels = { "Main.level", "PortalsDemo.level" };
+	}
+	return settings;
+}
+
+static Vector2f FindSpawnPosition(const MapData& mapData)
+{
+	// Match FlowstateGame: the player spawns at LevelLink 0, falling back to the map's player start
+	std::vector<OLevelLink*> levelLinks;
+	GameObject::GetAllObjects(levelLinks);
+	for (OLevelLink* levelLink : levelLinks)
+	{
+		if (levelLink->GetLinkId() == 0)
+		{
+			return levelLink->GetPosition().XY();
+		}
+	}
+	return mapData.playerStart.ToFloat() + Vector2f(0.5f, 0.5f);
+}
+
+static LevelBenchmarkResult RunLevel(const BenchmarkSettings& settings, const std::string& levelName, MapData& mapData, Spear::TextureArray* pTextures)
+{
+	Spear::Renderer& renderer = Spear::ServiceLocator::GetScreenRenderer();
+
+	LevelBenchmarkResult result;
+	result.levelName = levelName;
+
+	// Time repeated loads in each format. Loads only trace the visibility regions around the spawn which the cache doesn't hold yet, so just the first can include that.
+	for (int run = 0; run < settings.loadRuns; run++)
+	{
+		for (const bool bAllowBinary : { false, true })
+		{
+			GameObject::GlobalDestroy();
+			const u64 loadStart = SDL_GetPerformanceCounter();
+			LevelFileManager::LoadLevel(levelName.c_str(), mapData, bAllowBinary);
+			const float loadMs = 1000.f * (static_cast<float>(SDL_GetPerformanceCounter() - loadStart) / SDL_GetPerformanceFrequency());
+			if (!bAllowBinary)
+			{
+				result.textLoadSamplesMs.push_back(loadMs);
+			}
+			else if (mapData.mappedLevel.IsOpen())
+			{
+				result.binaryLoadSamplesMs.push_back(loadMs);
+			}
+		}
+	}
+
+	// Unload previous level
+	GameObject::GlobalDestroy();
+	renderer.ReleaseAll();
+
+	// Load level exactly as the game does
+	LevelFileManager::LoadLevel(levelName.c_str(), mapData);
+	Raycaster::Init(mapData);
+	pTextures[GlobalTextureBatches::BATCH_TILESET_1].InitialiseFromDirectory(mapData.tileDirectory.path().string().c_str());
+	pTextures[GlobalTextureBatches::BATCH_SPRITESET_1].InitialiseFromDirectory(mapData.spriteDirectory.path().string().c_str());
+	for (int i = 0; i < GlobalTextureBatches::BATCH_TOTALS; i++)
+	{
+		renderer.CreateSpriteBatch(pTextures[i], 1000);
+	}
+
+	CameraPath path;
+	const std::string levelStem = std::filesystem::path(levelName).stem().string();
+	const std::string pathFile = "CameraPaths/" + levelStem + ".path";
+	if (path.LoadFromFile(pathFile.c_str()))
+	{
+		result.cameraPath = pathFile;
+	}
+	else
+	{
+		path.MakeDefault(FindSpawnPosition(mapData));
+		result.cameraPath = "default";
+	}
+
+	const int totalFrames = settings.warmupFrames + settings.frames;
+	auto FrameTime = [&settings](int frame)
+	{
+		return settings.frames > 1 ? static_cast<float>(std::max(0, frame - settings.warmupFrames)) / (settings.frames - 1) : 0.f;
+	};
+
+	// The game traces visibility regions in the background as the camera reaches them. Trace every region along the path up front instead,
+	// so frame times (and what gets culled) don't depend on how much of the level's visibility cache was already there.
+	for (int frame = 0; frame < totalFrames; frame++)
+	{
+		mapData.visibility.PrepareRegionsAround(mapData, path.Sample(FrameTime(frame)).pos.ToInt());
+	}
+
+	for (int frame = 0; frame < totalFrames; frame++)
+	{
+		const CameraKeyframe camera = path.Sample(FrameTime(frame));
+
+		// Sprites are submitted by GameObjects each frame, same as FlowstateGame::StateRender
+		GameObject::GlobalDraw();
+
+		const u64 frameStart = SDL_GetPerformanceCounter();
+		Raycaster::Draw3DGrid(camera.pos, camera.pitch, camera.angle);
+		const float frameMs = 1000.f * (static_cast<float>(SDL_GetPerformanceCounter() - frameStart) / SDL_GetPerformanceFrequency());
+
+		Raycaster::ClearSprites();
+
+		// Keep the GL queue from building up across frames (outside of timed region)
+		glFinish();
+
+		if (frame < settings.warmupFrames)
+		{
+			continue;
+		}
+
+		const Raycaster::RaycastFrameStats& stats = Raycaster::GetLastFrameStats();
+		for (int phase = 0; phase < Raycaster::PHASE_TOTAL; phase++)
+		{
+			result.phaseSamplesMs[phase].push_back(stats.phaseMs[phase]);
+		}
+		result.frameSamplesMs.push_back(frameMs);
+		result.finalFrameChecksum = stats.outputChecksum;
+		result.combinedChecksum = (result.combinedChecksum ^ stats.outputChecksum) * 1099511628211ull;
+	}
+
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	const BenchmarkSettings settings = ParseArguments(argc, argv);
+
+	// Initialise Spear engine without ever showing a window (a GL context is still required for texture/upload paths)
+	Spear::WindowParams params;
+	params.title = "SpearBenchmark";
+	params.fullscreen = false;
+	params.hidden = true;
+	params.xpos = SDL_WINDOWPOS_UNDEFINED;
+	params.ypos = SDL_WINDOWPOS_UNDEFINED;
+	params.width = 1280;
+	params.height = 720;
+	params.scale = 1.f;
+	Spear::Core::Initialise(params);
+
+	// Fixed config so results are comparable across machines/runs
+	Raycaster::ApplyConfig(RaycasterConfig());
+	Raycaster::SetOutputChecksumEnabled(true);
+	Raycaster::SetColumnRenderingEnabled(settings.bColumnRendering);
+	Raycaster::SetMipmappingEnabled(settings.bMipmapping);
+	Raycaster::SetHalfRatePlanesEnabled(settings.bHalfRatePlanes);
+	Raycaster::SetFixedPointDDAEnabled(settings.bFixedPointDDA);
+
+	if (settings.bConvertLevels)
+	{
+		for (const std::string& level : settings.levels)
+		{
+			std::cout << (LevelFileManager::ConvertLevelToBinary(level.c_str()) ? "Converted " : "Failed to convert ") << level << std::endl;
+		}
+	}
+
+	// Level data must outlive the Raycaster's use of it
+	MapData mapData;
+	Spear::TextureArray textures[GlobalTextureBatches::BATCH_TOTALS];
+
+	std::vector<LevelBenchmarkResult> results;
+	for (const std::string& level : settings.levels)
+	{
+		std::cout << "Benchmarking " << level << "..." << std::endl;
+		results.push_back(RunLevel(settings, level, mapData, textures));
+
+		const TimingSummary frameSummary = BenchmarkReport::Summarise(results.back().frameSamplesMs);
+		std::cout << "\tmedian " << frameSummary.median << "ms, p95 " << frameSummary.p95 << "ms, p99 " << frameSummary.p99 << "ms" << std::endl;
+		if (!results.back().textLoadSamplesMs.empty())
+		{
+			std::cout << "\tload (text) median " << BenchmarkReport::Summarise(results.back().textLoadSamplesMs).median << "ms";
+			if (!results.back().binaryLoadSamplesMs.empty())
+			{
+				std::cout << ", load (binary) median " << BenchmarkReport::Summarise(results.back().binaryLoadSamplesMs).median << "ms";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	const int threads = static_cast<int>(std::thread::hardware_concurrency());
+	const Vector2i resolution = Raycaster::GetResolution();
+	if (!BenchmarkReport::WriteJSON(settings.jsonPath.c_str(), results, threads, resolution))
+	{
+		std::cout << "Failed to write " << settings.jsonPath << std::endl;
+	}
+	if (!BenchmarkReport::WriteCSV(settings.csvPath.c_str(), results))
+	{
+		std::cout << "Failed to write " << settings.csvPath << std::endl;
+	}
+
+	GameObject::GlobalDestroy();
+	Spear::ServiceLocator::GetScreenRenderer().ReleaseAll();
+	for (Spear::TextureArray& textureArray : textures)
+	{
+		textureArray.FreeTexture();
+	}
+	Spear::Core::Cleanup();
+
+	return 0;
+}
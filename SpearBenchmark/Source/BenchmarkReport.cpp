@@ -0,0 +1,117 @@
+#include "BenchmarkReport.h"
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <iomanip>
+#include <sstream>
+
+static float Percentile(const std::vector<float>& sortedSamples, float percentile)
+{
+	// Nearest-rank percentile
+	const int rank = static_cast<int>(std::ceil((percentile / 100.f) * sortedSamples.size()));
+	return sortedSamples[std::clamp(rank - 1, 0, static_cast<int>(sortedSamples.size()) - 1)];
+}
+
+static std::string ChecksumToString(u64 checksum)
+{
+	std::ostringstream stream;
+	stream << std::hex << std::setw(16) << std::setfill('0') << checksum;
+	return stream.str();
+}
+
+TimingSummary BenchmarkReport::Summarise(std::vector<float> samples)
+{
+	TimingSummary summary;
+	if (samples.empty())
+	{
+		return summary;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	summary.median = Percentile(samples, 50.f);
+	summary.p95 = Percentile(samples, 95.f);
+	summary.p99 = Percentile(samples, 99.f);
+	summary.mean = std::accumulate(samples.begin(), samples.end(), 0.f) / samples.size();
+	return summary;
+}
+
+bool BenchmarkReport::WriteJSON(const char* filepath, const std::vector<LevelBenchmarkResult>& results, int threads, const Vector2i& resolution)
+{
+	std::ofstream file(filepath);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	auto WriteSummary = [&file](const TimingSummary& summary)
+	{
+		file << "{ \"median\": " << summary.median << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"mean\": " << summary.mean << " }";
+	};
+
+	file << std::fixed << std::setprecision(4);
+	file << "{\n";
+	file << "\t\"threads\": " << threads << ",\n";
+	file << "\t\"resolution\": [" << resolution.x << ", " << resolution.y << "],\n";
+	file << "\t\"levels\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const LevelBenchmarkResult& result = results[i];
+		file << "\t\t{\n";
+		file << "\t\t\t\"level\": \"" << result.levelName << "\",\n";
+		file << "\t\t\t\"cameraPath\": \"" << result.cameraPath << "\",\n";
+		file << "\t\t\t\"frames\": " << result.frameSamplesMs.size() << ",\n";
+		file << "\t\t\t\"checksum\": \"" << ChecksumToString(result.combinedChecksum) << "\",\n";
+		file << "\t\t\t\"finalFrameChecksum\": \"" << ChecksumToString(result.finalFrameChecksum) << "\",\n";
+		file << "\t\t\t\"frameMs\": ";
+		WriteSummary(Summarise(result.frameSamplesMs));
+		file << ",\n";
+		file << "\t\t\t\"loadMs\": {\n";
+		file << "\t\t\t\t\"text\": ";
+		WriteSummary(Summarise(result.textLoadSamplesMs));
+		file << ",\n";
+		file << "\t\t\t\t\"binary\": ";
+		WriteSummary(Summarise(result.binaryLoadSamplesMs));
+		file << "\n";
+		file << "\t\t\t},\n";
+		file << "\t\t\t\"phasesMs\": {\n";
+		for (int phase = 0; phase < Raycaster::PHASE_TOTAL; phase++)
+		{
+			file << "\t\t\t\t\"" << Raycaster::PHASE_NAMES[phase] << "\": ";
+			WriteSummary(Summarise(result.phaseSamplesMs[phase]));
+			file << (phase < Raycaster::PHASE_TOTAL - 1 ? ",\n" : "\n");
+		}
+		file << "\t\t\t}\n";
+		file << "\t\t}" << (i < results.size() - 1 ? ",\n" : "\n");
+	}
+	file << "\t]\n";
+	file << "}\n";
+	return true;
+}
+
+bool BenchmarkReport::WriteCSV(const char* filepath, const std::vector<LevelBenchmarkResult>& results)
+{
+	std::ofstream file(filepath);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file << std::fixed << std::setprecision(4);
+	file << "level,phase,median_ms,p95_ms,p99_ms,mean_ms,checksum" << std::endl;
+	for (const LevelBenchmarkResult& result : results)
+	{
+		auto WriteRow = [&](const char* phaseName, const TimingSummary& summary)
+		{
+			file << result.levelName << "," << phaseName << "," << summary.median << "," << summary.p95 << "," << summary.p99 << "," << summary.mean << "," << ChecksumToString(result.combinedChecksum) << std::endl;
+		};
+
+		WriteRow("Frame", Summarise(result.frameSamplesMs));
+		for (int phase = 0; phase < Raycaster::PHASE_TOTAL; phase++)
+		{
+			WriteRow(Raycaster::PHASE_NAMES[phase], Summarise(result.phaseSamplesMs[phase]));
+		}
+		WriteRow("LoadText", Summarise(result.textLoadSamplesMs));
+		WriteRow("LoadBinary", Summarise(result.binaryLoadSamplesMs));
+	}
+	return true;
+}
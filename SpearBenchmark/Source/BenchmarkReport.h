@@ -0,0 +1,33 @@
+#pragma once
+#include "Core/Core.h"
+#include "Raycaster/Raycaster.h"
+
+// Per-level timing samples gathered by the benchmark, summarised into median/p95/p99 on output
+struct LevelBenchmarkResult
+{
+	std::string levelName;
+	std::string cameraPath;
+	std::vector<float> phaseSamplesMs[Raycaster::PHASE_TOTAL];
+	std::vector<float> frameSamplesMs;
+	std::vector<float> textLoadSamplesMs;
+	std::vector<float> binaryLoadSamplesMs;	// empty if the level has no binary counterpart
+	u64 finalFrameChecksum{ 0 };	// checksum of the last frame rendered on the path
+	u64 combinedChecksum{ 0 };		// all frame checksums folded together, catches divergence anywhere along the path
+};
+
+struct TimingSummary
+{
+	float median{ 0.f };
+	float p95{ 0.f };
+	float p99{ 0.f };
+	float mean{ 0.f };
+};
+
+class BenchmarkReport
+{
+public:
+	static TimingSummary Summarise(std::vector<float> samples);
+
+	static bool WriteJSON(const char* filepath, const std::vector<LevelBenchmarkResult>& results, int threads, const Vector2i& resolution);
+	static bool WriteCSV(const char* filepath, const std::vector<LevelBenchmarkResult>& results);
+};
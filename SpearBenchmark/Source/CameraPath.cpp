@@ -0,0 +1,73 @@
+#include "CameraPath.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+bool CameraPath::LoadFromFile(const char* filepath)
+{
+	m_keyframes.clear();
+
+	std::ifstream file(filepath);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream stream(line);
+		CameraKeyframe keyframe;
+		float angleDegrees{ 0.f };
+		if (stream >> keyframe.pos.x >> keyframe.pos.y >> angleDegrees >> keyframe.pitch)
+		{
+			keyframe.angle = TO_RADIANS(angleDegrees);
+			m_keyframes.push_back(keyframe);
+		}
+	}
+
+	return m_keyframes.size() > 0;
+}
+
+void CameraPath::MakeDefault(const Vector2f& origin)
+{
+	m_keyframes.clear();
+
+	constexpr int turnSteps{ 8 };
+	for (int i = 0; i <= turnSteps; i++)
+	{
+		CameraKeyframe keyframe;
+		keyframe.pos = origin;
+		keyframe.angle = TO_RADIANS(360.f * i / turnSteps);
+		keyframe.pitch = (i % 2 == 0) ? 0.f : ((i % 4 == 1) ? 0.25f : -0.25f);
+		m_keyframes.push_back(keyframe);
+	}
+}
+
+CameraKeyframe CameraPath::Sample(float t) const
+{
+	ASSERT(m_keyframes.size());
+	if (m_keyframes.size() == 1)
+	{
+		return m_keyframes[0];
+	}
+
+	// Find the pair of keyframes surrounding t
+	const float scaledT = std::clamp(t, 0.f, 1.f) * (m_keyframes.size() - 1);
+	const int index = std::min(static_cast<int>(scaledT), static_cast<int>(m_keyframes.size()) - 2);
+	const float alpha = scaledT - index;
+
+	const CameraKeyframe& a = m_keyframes[index];
+	const CameraKeyframe& b = m_keyframes[index + 1];
+
+	CameraKeyframe result;
+	result.pos = a.pos + ((b.pos - a.pos) * alpha);
+	result.angle = a.angle + ((b.angle - a.angle) * alpha);
+	result.pitch = a.pitch + ((b.pitch - a.pitch) * alpha);
+	return result;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "Core/Core.h"
+
+struct CameraKeyframe
+{
+	Vector2f pos{ Vector2f::ZeroVector };
+	float angle{ 0.f };	// radians
+	float pitch{ 0.f };	// -1 to +1, same as Player::GetLookPitch
+};
+
+// Deterministic camera route for benchmarking: keyframes are linearly interpolated, so the same path always produces the same frames
+class CameraPath
+{
+public:
+	// Reads one keyframe per line as 'x y angleDegrees pitch'. Blank lines and lines starting with '#' are ignored.
+	bool LoadFromFile(const char* filepath);
+
+	// Fallback route for levels without a recorded path: a full turn on the spot while sweeping pitch
+	void MakeDefault(const Vector2f& origin);
+
+	// t ranges from 0.0 (first keyframe) to 1.0 (last keyframe)
+	CameraKeyframe Sample(float t) const;
+
+	int KeyframeCount() const { return static_cast<int>(m_keyframes.size()); }
+
+private:
+	std::vector<CameraKeyframe> m_keyframes;
+};
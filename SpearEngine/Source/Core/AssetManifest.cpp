@@ -3,6 +3,7 @@
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <mutex>
 
 namespace Spear
 {
@@ -10,6 +11,10 @@ namespace Spear
 
 	bool AssetManifest::GetManifest(const char* dir, const char* extension, Manifest& out_manifest)
 	{
+		// Manifests may be read and rewritten by level streaming threads as well as the main thread
+		static std::mutex manifestMutex;
+		std::scoped_lock<std::mutex> lock(manifestMutex);
+
 		out_manifest.clear();
 
 		// Load manifest containing prior known files (allows loaded indexes to match values saved inside level.dats after file removals/additions)
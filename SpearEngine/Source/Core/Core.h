@@ -90,6 +90,7 @@ namespace Spear
 		int xpos, ypos;
 		int width, height;
 		bool fullscreen;
+		bool hidden{false}; // create the window (and GL context) without ever showing it, eg. for headless tools
 	};
 
 	class Core
@@ -0,0 +1,47 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SPEAR_CPUID_MSVC
+#elif defined(__x86_64__) || defined(__i386__)
+#define SPEAR_CPUID_BUILTIN
+#endif
+
+namespace Spear
+{
+	bool CpuFeatures::HasAVX2()
+	{
+		static const bool bHasAVX2 = DetectAVX2();
+		return bHasAVX2;
+	}
+
+	bool CpuFeatures::DetectAVX2()
+	{
+#if defined(SPEAR_DISABLE_SIMD)
+		return false;
+#elif defined(SPEAR_CPUID_MSVC)
+		int cpuInfo[4];
+		__cpuid(cpuInfo, 0);
+		if (cpuInfo[0] < 7)
+		{
+			return false;
+		}
+
+		// AVX support, and OS saves YMM registers on context switch (OSXSAVE + XCR0 bits 1/2)
+		__cpuid(cpuInfo, 1);
+		const bool bOSXSave = (cpuInfo[2] & (1 << 27)) != 0;
+		const bool bAVX = (cpuInfo[2] & (1 << 28)) != 0;
+		if (!bOSXSave || !bAVX || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+
+		__cpuidex(cpuInfo, 7, 0);
+		return (cpuInfo[1] & (1 << 5)) != 0;
+#elif defined(SPEAR_CPUID_BUILTIN)
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+}
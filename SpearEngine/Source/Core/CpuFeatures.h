@@ -0,0 +1,18 @@
+#pragma once
+#include "Core.h"
+
+namespace Spear
+{
+	// Runtime queries for instruction sets supported by the host CPU/OS, used to select SIMD code paths
+	// Define SPEAR_DISABLE_SIMD to force every query to report false (ie. scalar fallbacks only)
+	class CpuFeatures
+	{
+		NO_CONSTRUCT(CpuFeatures);
+
+	public:
+		static bool HasAVX2();
+
+	private:
+		static bool DetectAVX2();
+	};
+}
@@ -0,0 +1,123 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Spear
+{
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+			std::swap(m_fileHandle, other.m_fileHandle);
+			std::swap(m_mappingHandle, other.m_mappingHandle);
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const char* filepath)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		if (!view)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		m_fileHandle = file;
+		m_mappingHandle = mapping;
+		m_data = static_cast<u8*>(view);
+		m_size = static_cast<u64>(fileSize.QuadPart);
+#else
+		const int file = open(filepath, O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+		{
+			close(file);
+			return false;
+		}
+
+		void* view = mmap(nullptr, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file); // mapping keeps its own reference to the file
+		if (view == MAP_FAILED)
+		{
+			return false;
+		}
+
+		m_data = static_cast<u8*>(view);
+		m_size = static_cast<u64>(fileStat.st_size);
+#endif
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (!m_data)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+		CloseHandle(static_cast<HANDLE>(m_fileHandle));
+#else
+		munmap(m_data, m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+		m_fileHandle = nullptr;
+		m_mappingHandle = nullptr;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Core.h"
+
+namespace Spear
+{
+	// Read-only file mapped into memory, so file contents can be used in place rather than copied through a stream
+	// Mapping is copy-on-write: writes through Data() are private to this process and never reach the file
+	class MappedFile
+	{
+		NO_COPY(MappedFile);
+
+	public:
+		MappedFile() = default;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		~MappedFile();
+
+		bool Open(const char* filepath);
+		void Close();
+
+		bool IsOpen() const { return m_data != nullptr; }
+		u8* Data() const { return m_data; }
+		u64 Size() const { return m_size; }
+
+	private:
+		u8* m_data{ nullptr };
+		u64 m_size{ 0 };
+		void* m_fileHandle{ nullptr };
+		void* m_mappingHandle{ nullptr };
+	};
+}
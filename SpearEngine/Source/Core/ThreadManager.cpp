@@ -5,16 +5,20 @@
 #include <functional>
 #include <mutex>
 #include <queue>
-#include <condition_variable>
-#include <shared_mutex>
 #include <atomic>
+#include <algorithm>
 
 namespace Spear
 {
+	// Index of the WorkStealingQueue owned by the current thread, or -1 if it doesn't own one
+	static thread_local int tl_queueIndex{ -1 };
 
-	void TaskHandle::Initialise(int threads)
+	// Set while the current thread executes a background task, so anything it dispatches is background work too
+	static thread_local bool tl_bBackground{ false };
+
+	void TaskHandle::Initialise(int threads, ThreadManager* pThreadManager)
 	{
-		std::unique_lock lock(m_mutex);
+		m_pThreadManager = pThreadManager;
 		m_activeThreads.store(threads);
 	}
 
@@ -25,11 +29,14 @@ namespace Spear
 
 	void TaskHandle::DecrementRemainingThreads()
 	{
-		std::unique_lock lock(m_mutex);
-		m_activeThreads.store(std::max(m_activeThreads.load() - 1, 0));
-		if (m_activeThreads.load() == 0)
+		ASSERT(m_activeThreads.load() > 0);
+
+		// Cache the manager first: once the count hits zero a waiting thread may return and destroy this handle
+		ThreadManager* pThreadManager = m_pThreadManager;
+		if (m_activeThreads.fetch_sub(1) == 1)
 		{
-			m_conditionTaskComplete.notify_all();
+			pThreadManager->m_completionEpoch.fetch_add(1);
+			pThreadManager->m_completionEpoch.notify_all();
 		}
 	}
 
@@ -40,15 +47,101 @@ namespace Spear
 
 	void TaskHandle::WaitForTaskComplete()
 	{
-		ASSERT(m_activeThreads.load() > 0);
+		while (!IsTaskComplete())
+		{
+			ASSERT(m_pThreadManager);
+
+			// Help out rather than block idle
+			if (m_pThreadManager->TryExecuteTask())
+			{
+				continue;
+			}
+
+			// Nothing left to pick up, so remaining instances are already running on workers: sleep until a task completes
+			const u32 epoch = m_pThreadManager->m_completionEpoch.load();
+			if (IsTaskComplete())
+			{
+				break;
+			}
+			m_pThreadManager->m_completionEpoch.wait(epoch);
+		}
+	}
+
+	bool ThreadManager::WorkStealingQueue::Push(const QueuedTask& queuedTask)
+	{
+		const s64 bottom = m_bottom.load(std::memory_order_relaxed);
+		const s64 top = m_top.load(std::memory_order_acquire);
+		if (bottom - top >= CAPACITY)
+		{
+			return false;
+		}
+
+		Slot& slot = m_slots[bottom & (CAPACITY - 1)];
+		slot.pGroup.store(queuedTask.pGroup, std::memory_order_relaxed);
+		slot.taskInstanceID.store(queuedTask.taskInstanceID, std::memory_order_relaxed);
+		slot.bBackground.store(queuedTask.bBackground, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_release); // publishes slot (and the task it points to) to thieves
+		return true;
+	}
+
+	bool ThreadManager::WorkStealingQueue::Pop(QueuedTask& outTask)
+	{
+		const s64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		s64 top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			// Queue was empty
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		const Slot& slot = m_slots[bottom & (CAPACITY - 1)];
+		outTask.pGroup = slot.pGroup.load(std::memory_order_relaxed);
+		outTask.taskInstanceID = slot.taskInstanceID.load(std::memory_order_relaxed);
+		outTask.bBackground = slot.bBackground.load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			// Last item: race any thieves for it
+			const bool bWon = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return bWon;
+		}
+		return true;
+	}
 
-		std::shared_lock lock(m_mutex);
-		m_conditionTaskComplete.wait(lock, [&]() {return m_activeThreads.load() == 0; });
+	bool ThreadManager::WorkStealingQueue::Steal(QueuedTask& outTask, bool bAllowBackground)
+	{
+		s64 top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const s64 bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+		{
+			return false;
+		}
+
+		const Slot& slot = m_slots[top & (CAPACITY - 1)];
+		outTask.pGroup = slot.pGroup.load(std::memory_order_relaxed);
+		outTask.taskInstanceID = slot.taskInstanceID.load(std::memory_order_relaxed);
+		outTask.bBackground = slot.bBackground.load(std::memory_order_relaxed);
+		if (outTask.bBackground && !bAllowBackground)
+		{
+			// Left for another thread (if the slot was being reused this read is stale, which just means a missed steal)
+			return false;
+		}
+		return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
 	}
 
 	ThreadManager::ThreadManager()
 	{
 		const int safeThreadCount = std::min(std::jthread::hardware_concurrency() - 1, THREAD_COUNT);
+
+		m_queueCount = safeThreadCount + 1;
+		m_queues = std::make_unique<WorkStealingQueue[]>(m_queueCount);
+		tl_queueIndex = 0;
+
 		m_threads.reserve(safeThreadCount);
 		for (int i = 0; i < safeThreadCount; i++)
 		{
@@ -58,81 +151,229 @@ namespace Spear
 
 	ThreadManager::~ThreadManager()
 	{
-		std::scoped_lock<std::mutex> lock(m_mutex);
 		m_bKillThreads = true;
-		m_queuedTasksUpdated.notify_all();
+		m_workEpoch.fetch_add(1);
+		m_workEpoch.notify_all();
 
-		// no need to call join() in destructor when using jthread
+		// join before queues are destroyed
+		m_threads.clear();
+		tl_queueIndex = -1;
 	}
 
 	void ThreadManager::DispatchTask(const ThreadTask& task, TaskHandle* taskStatus)
+	{
+		DispatchTaskDistributed(task, taskStatus, 1);
+	}
+
+	void ThreadManager::DispatchTaskDistributed(const ThreadTask& task, TaskHandle* taskStatus, u32 taskInstances)
 	{
 		if (taskStatus)
 		{
-			taskStatus->Initialise(1); // initialise handle for a single thread
+			taskStatus->Initialise(taskInstances, this);
+		}
+		if (taskInstances == 0)
+		{
+			return;
 		}
 
-		std::scoped_lock<std::mutex> lock(m_mutex);
-		m_queuedTasks.push({task, taskStatus, 0});
+		TaskGroup* pGroup = new TaskGroup;
+		pGroup->task = task;
+		pGroup->pTaskStatus = taskStatus;
+		pGroup->remainingInstances.store(taskInstances);
 
-		// let a waiting thread know there is a new task available
-		m_queuedTasksUpdated.notify_one();
+		for (u32 i = 0; i < taskInstances; i++)
+		{
+			Enqueue({ pGroup, i, tl_bBackground });
+		}
+
+		// let all waiting threads know there are new tasks available
+		m_workEpoch.fetch_add(1);
+		m_workEpoch.notify_all();
 	}
 
-	void ThreadManager::DispatchTaskDistributed(const ThreadTask& task, TaskHandle* taskStatus, u32 taskInstances)
+	void ThreadManager::DispatchBackgroundTask(const ThreadTask& task, TaskHandle* taskStatus)
 	{
 		if (taskStatus)
 		{
-			taskStatus->Initialise(taskInstances);
+			taskStatus->Initialise(1, this);
+		}
+
+		TaskGroup* pGroup = new TaskGroup;
+		pGroup->task = task;
+		pGroup->pTaskStatus = taskStatus;
+		pGroup->remainingInstances.store(1);
+
+		{
+			std::scoped_lock<std::mutex> lock(m_mutex);
+			m_backgroundQueue.push({ pGroup, 0, true });
+			m_backgroundQueueSize++;
+		}
+
+		m_workEpoch.fetch_add(1);
+		m_workEpoch.notify_all();
+	}
+
+	void ThreadManager::ParallelFor(int begin, int end, int grain, const ParallelForTask& task)
+	{
+		const int range = end - begin;
+		if (range <= 0)
+		{
+			return;
+		}
+
+		if (grain <= AUTO_GRAIN)
+		{
+			// Aim for several chunks per thread, so threads finishing early can pick up the slack of slower chunks
+			constexpr int chunksPerThread{ 8 };
+			grain = std::max(1, range / (static_cast<int>(m_queueCount) * chunksPerThread));
+		}
+
+		const int chunkCount = (range + grain - 1) / grain;
+		std::atomic<int> nextChunk{ 0 };
+		auto ClaimChunks = [&](u32)
+		{
+			for (int chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1))
+			{
+				const int chunkBegin = begin + (chunk * grain);
+				task(chunkBegin, std::min(chunkBegin + grain, end));
+			}
+			return 0;
+		};
+
+		TaskHandle handle;
+		DispatchTaskDistributed(ClaimChunks, &handle, std::min(static_cast<u32>(chunkCount), m_queueCount));
+		handle.WaitForTaskComplete();
+	}
+
+	void ThreadManager::Enqueue(const QueuedTask& queuedTask)
+	{
+		if (tl_queueIndex >= 0)
+		{
+			if (!m_queues[tl_queueIndex].Push(queuedTask))
+			{
+				// Queue is full, just do the work now
+				ExecuteTask(queuedTask);
+			}
+			return;
 		}
 
 		std::scoped_lock<std::mutex> lock(m_mutex);
+		m_sharedQueue.push(queuedTask);
+		m_sharedQueueSize++;
+	}
 
-		for(u32 i = 0; i < taskInstances; i++)
+	bool ThreadManager::FindTask(QueuedTask& outTask)
+	{
+		// Own queue first (most recently pushed, likely still in cache)
+		if (tl_queueIndex >= 0 && m_queues[tl_queueIndex].Pop(outTask))
 		{
-			m_queuedTasks.push({ task, taskStatus, i });
+			return true;
 		}
 
-		// let all waiting threads know there are new tasks available
-		m_queuedTasksUpdated.notify_all();
+		if (m_sharedQueueSize.load() > 0)
+		{
+			std::scoped_lock<std::mutex> lock(m_mutex);
+			if (!m_sharedQueue.empty())
+			{
+				outTask = m_sharedQueue.front();
+				m_sharedQueue.pop();
+				m_sharedQueueSize--;
+				return true;
+			}
+		}
+
+		// Steal from other queues, starting with our neighbour so thieves spread out
+		// The main thread leaves background tasks to the workers (as in FindBackgroundTask), else waiting on a per-frame task could stall it behind streaming work
+		const bool bAllowBackground = tl_queueIndex != 0 || m_threads.empty();
+		const u32 startIndex = static_cast<u32>(tl_queueIndex + 1);
+		for (u32 i = 0; i < m_queueCount; i++)
+		{
+			const u32 victim = (startIndex + i) % m_queueCount;
+			if (static_cast<int>(victim) != tl_queueIndex && m_queues[victim].Steal(outTask, bAllowBackground))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ThreadManager::FindBackgroundTask(QueuedTask& outTask)
+	{
+		// Without any workers (single core machines) whoever waits on the task has to run it
+		const bool bWorkersAvailable = !m_threads.empty();
+		if ((bWorkersAvailable && tl_queueIndex <= 0) || m_backgroundQueueSize.load() == 0)
+		{
+			return false;
+		}
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		if (m_backgroundQueue.empty())
+		{
+			return false;
+		}
+		outTask = m_backgroundQueue.front();
+		m_backgroundQueue.pop();
+		m_backgroundQueueSize--;
+		return true;
 	}
 
-	// Function given to managed threads: loops endlessly until shutdown, grabbing and executing functions from ThreadManager queue
+	bool ThreadManager::TryExecuteTask()
+	{
+		QueuedTask queuedTask;
+		if (FindTask(queuedTask) || FindBackgroundTask(queuedTask))
+		{
+			ExecuteTask(queuedTask);
+			return true;
+		}
+		return false;
+	}
+
+	void ThreadManager::ExecuteTask(const QueuedTask& queuedTask)
+	{
+		TaskGroup* pGroup = queuedTask.pGroup;
+		const bool bWasBackground = tl_bBackground;
+		tl_bBackground = queuedTask.bBackground;
+		int returnValue = pGroup->task(queuedTask.taskInstanceID);
+		tl_bBackground = bWasBackground;
+		if (pGroup->pTaskStatus)
+		{
+			pGroup->pTaskStatus->DecrementRemainingThreads();
+		}
+		if (pGroup->remainingInstances.fetch_sub(1) == 1)
+		{
+			delete pGroup;
+		}
+	}
+
+	// Function given to managed threads: loops endlessly until shutdown, executing tasks from its own queue or stealing from others
 	void ThreadManager::WorkerThread(u8 threadId, ThreadManager* pThreadManager)
 	{
+		tl_queueIndex = threadId + 1;
 		pThreadManager->m_activeThreads++;
 
+		constexpr int spinAttempts{ 64 };
 		while (!pThreadManager->m_bKillThreads)
 		{
-			QueuedTask threadTask;
-			bool bClaimedJob{false};
+			// Read epoch before searching, so work queued mid-search always wakes us
+			const u32 epoch = pThreadManager->m_workEpoch.load();
 
-			while(!bClaimedJob && !pThreadManager->m_bKillThreads)
+			bool bFoundWork{ false };
+			for (int i = 0; i < spinAttempts && !bFoundWork; i++)
 			{
-				std::unique_lock<std::mutex> lock(pThreadManager->m_mutex);
-				if (!pThreadManager->m_queuedTasks.empty())
-				{
-					threadTask = pThreadManager->m_queuedTasks.front();
-					pThreadManager->m_queuedTasks.pop();
-					bClaimedJob = true;
-				}
-				else
+				bFoundWork = pThreadManager->TryExecuteTask();
+				if (!bFoundWork)
 				{
-					// if queue was empty, wait until new work is posted and JobManager sends notify
-					pThreadManager->m_queuedTasksUpdated.wait(lock);
+					std::this_thread::yield();
 				}
 			}
 
-			if (bClaimedJob)
+			if (!bFoundWork && !pThreadManager->m_bKillThreads)
 			{
-				int returnValue = threadTask.task(threadTask.taskInstanceID);
-				if (threadTask.pTaskStatus)
-				{
-					threadTask.pTaskStatus->DecrementRemainingThreads();
-				}
+				// if no work was found, sleep until new work is posted
+				pThreadManager->m_workEpoch.wait(epoch);
 			}
 		}
 
 		pThreadManager->m_activeThreads--;
 	}
-}
\ No newline at end of file
+}
@@ -3,34 +3,46 @@
 #include <functional>
 #include <thread>
 #include <mutex>
-#include <shared_mutex>
 #include <queue>
+#include <atomic>
+#include <memory>
 
 namespace Spear
 {
+	class ThreadManager;
+
 	// 'Task' refers to a function distributed across any number of threads
 	class TaskHandle
 	{
+		friend class ThreadManager;
 
 	public:
-		void Initialise(int threads);
 		int RemainingThreads();
-		void DecrementRemainingThreads();
 		bool IsTaskComplete();
+
+		// Calling thread executes queued work (from any task) until this task is complete, only sleeping once there is nothing left to pick up
 		void WaitForTaskComplete();
 
 	private:
-		std::atomic<int> m_activeThreads;
-		std::shared_mutex m_mutex;
-		std::condition_variable_any m_conditionTaskComplete;
+		void Initialise(int threads, ThreadManager* pThreadManager);
+		void DecrementRemainingThreads();
+
+		std::atomic<int> m_activeThreads{ 0 };
+		ThreadManager* m_pThreadManager{ nullptr };
 	};
 
 	class ThreadManager
 	{
+		friend class TaskHandle;
+
 	public:
 		NO_COPY(ThreadManager);
 
 		using ThreadTask = std::function<int(u32 taskInstanceID)>;
+		using ParallelForTask = std::function<void(int rangeBegin, int rangeEnd)>;
+
+		// Pass as ParallelFor grain to pick a chunk size from the range and thread count
+		static constexpr int AUTO_GRAIN{ 0 };
 
 		ThreadManager();
 		~ThreadManager();
@@ -38,22 +50,82 @@ namespace Spear
 		void DispatchTask(const ThreadTask& task, TaskHandle* taskStatus = nullptr);
 		void DispatchTaskDistributed(const ThreadTask& task, TaskHandle* taskStatus = nullptr, u32 taskInstances = THREAD_COUNT);
 
+		// For long-running work (eg. streaming): only worker threads pick this up, and only once they have nothing else to do
+		// Keeps it off the main thread, which would otherwise claim it while waiting on per-frame tasks
+		// Tasks dispatched from inside it (eg. its ParallelFor chunks) are background tasks too, so the main thread never steals those either
+		void DispatchBackgroundTask(const ThreadTask& task, TaskHandle* taskStatus = nullptr);
+
+		// Splits [begin, end) into chunks of 'grain' indices which threads claim one at a time until none remain, so uneven chunks don't leave threads idle
+		// Blocks until the whole range is processed (calling thread takes chunks too)
+		void ParallelFor(int begin, int end, int grain, const ParallelForTask& task);
+
 	private:
-		static void WorkerThread(u8 threadId, ThreadManager* pThreadManager);
+		// One dispatch call: shared by each of its instances, deleted once every instance has executed
+		struct TaskGroup
+		{
+			ThreadTask task;
+			TaskHandle* pTaskStatus{ nullptr };
+			std::atomic<u32> remainingInstances{ 0 };
+		};
 
 		struct QueuedTask
 		{
-			ThreadTask task;
-			TaskHandle* pTaskStatus;
-			u32 taskInstanceID;
+			TaskGroup* pGroup{ nullptr };
+			u32 taskInstanceID{ 0 };
+			bool bBackground{ false }; // dispatched by DispatchBackgroundTask, or from within a task which was
 		};
 
+		// Chase-Lev deque: owning thread pushes/pops at the bottom without locking, other threads steal from the top
+		class WorkStealingQueue
+		{
+		public:
+			bool Push(const QueuedTask& queuedTask);	// owner only, returns false if full
+			bool Pop(QueuedTask& outTask);				// owner only
+			bool Steal(QueuedTask& outTask, bool bAllowBackground);	// any thread, leaves background tasks for others unless allowed
+
+		private:
+			static constexpr s64 CAPACITY{ 1024 }; // must be a power of 2
+			struct Slot
+			{
+				// atomics since thieves may read a slot while the owner is reusing it (thief then fails its claim and discards the read)
+				std::atomic<TaskGroup*> pGroup{ nullptr };
+				std::atomic<u32> taskInstanceID{ 0 };
+				std::atomic<bool> bBackground{ false };
+			};
+			Slot m_slots[CAPACITY];
+			std::atomic<s64> m_top{ 0 };
+			std::atomic<s64> m_bottom{ 0 };
+		};
+
+		static void WorkerThread(u8 threadId, ThreadManager* pThreadManager);
+
+		void Enqueue(const QueuedTask& queuedTask);
+		bool FindTask(QueuedTask& outTask);
+		bool FindBackgroundTask(QueuedTask& outTask); // worker threads only, unless there are none
+		bool TryExecuteTask(); // returns false if no work was available
+		void ExecuteTask(const QueuedTask& queuedTask);
+
 		static const uint32_t THREAD_COUNT{16};
+
+		// Queue 0 is owned by the thread which created the ThreadManager (main thread), queues 1+ by each worker
+		std::unique_ptr<WorkStealingQueue[]> m_queues;
+		u32 m_queueCount{ 0 };
+
+		// Tasks dispatched from threads which do not own a queue
 		std::mutex m_mutex;
-		std::queue<QueuedTask> m_queuedTasks;
-		std::condition_variable m_queuedTasksUpdated;
+		std::queue<QueuedTask> m_sharedQueue;
+		std::atomic<u32> m_sharedQueueSize{ 0 };
+
+		// Tasks from DispatchBackgroundTask (guarded by m_mutex)
+		std::queue<QueuedTask> m_backgroundQueue;
+		std::atomic<u32> m_backgroundQueueSize{ 0 };
+
+		// Bumped whenever work is queued (wakes idle workers) or a TaskHandle completes (wakes waiting threads)
+		std::atomic<u32> m_workEpoch{ 0 };
+		std::atomic<u32> m_completionEpoch{ 0 };
+
+		std::atomic<uint32_t> m_activeThreads{ 0 };
+		std::atomic<bool> m_bKillThreads{ false };
 		std::vector<std::jthread> m_threads;
-		std::atomic<uint32_t> m_activeThreads;
-		bool m_bKillThreads{false};
 	};
-}
\ No newline at end of file
+}
@@ -8,7 +8,8 @@ namespace Spear
 	WindowManager::WindowManager(const WindowParams& params)
 	{
 		// Create window with OpenGL surface
-		const Uint32 windowFlags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL | (params.fullscreen ? SDL_WINDOW_FULLSCREEN : SDL_WINDOW_MAXIMIZED);
+		const Uint32 visibilityFlags = params.hidden ? SDL_WINDOW_HIDDEN : (SDL_WINDOW_SHOWN | (params.fullscreen ? SDL_WINDOW_FULLSCREEN : SDL_WINDOW_MAXIMIZED));
+		const Uint32 windowFlags = SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL | visibilityFlags;
 		m_window = SDL_CreateWindow(params.title, params.xpos, params.ypos, params.width * params.scale, params.height * params.scale, windowFlags);
 		ASSERT(m_window);
 
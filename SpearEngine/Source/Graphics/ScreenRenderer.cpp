@@ -4,6 +4,7 @@
 #include "ShaderCompiler.h"
 #include "TextureFont.h"
 #include <Core/ServiceLocator.h>
+#include <algorithm>
 
 namespace Spear
 {
@@ -40,6 +41,8 @@ namespace Spear
 	Renderer::~Renderer()
 	{
 		ReleaseAll();
+		ReleaseBackgroundStaging();
+		glDeleteTextures(1, &m_backgroundDepthBuffer);
 		glDeleteFramebuffers(1, &m_fbo);
 		glDeleteTextures(1, &m_fboRenderTexture[0]);
 		glDeleteTextures(1, &m_fboRenderTexture[1]);
@@ -385,33 +388,171 @@ namespace Spear
 		m_backgroundDepthFalloff = falloff;
 	}
 
-	void Renderer::SetBackgroundTextureDataRGBA(GLuint* pDataRGBA, GLfloat* pDataDepth, int width, int height, bool bUploadDoubleBuffered)
+	void Renderer::SetBackgroundTextureDataRGBA(GLuint* pDataRGBA, BackgroundDepth* pDataDepth, int width, int height, bool bUploadDoubleBuffered)
 	{
+		ReserveBackgroundResolution(width, height);
+		SetBackgroundResolution(width, height);
+
 		START_PROFILE("Upload Background Array");
-		m_backgroundTexture[m_backgroundTextureActive].SetDataFromArrayRGBA(pDataRGBA, width, height);
+		m_backgroundTexture[m_backgroundTextureActive].SetRegionFromArrayRGBA(pDataRGBA, width, height);
 		if(bUploadDoubleBuffered)
 		{
-			m_backgroundTexture[(m_backgroundTextureActive + 1) % 2].SetDataFromArrayRGBA(pDataRGBA, width, height);
+			m_backgroundTexture[(m_backgroundTextureActive + 1) % 2].SetRegionFromArrayRGBA(pDataRGBA, width, height);
 		}
 		END_PROFILE("Upload Background Array");
 
 		START_PROFILE("Upload Depth Array");
 		glBindTexture(GL_TEXTURE_2D, m_backgroundDepthBuffer);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_R32F,
-			width,
-			height,
-			0,
-			GL_RED,
-			GL_FLOAT,
-			pDataDepth
-		);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, BACKGROUND_DEPTH_UNPACK_ALIGNMENT);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, BACKGROUND_DEPTH_TYPE, pDataDepth);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		END_PROFILE("Upload Depth Array");
+	}
+
+	void Renderer::ResizeBackgroundDepthBuffer(int width, int height, GLenum internalFormat)
+	{
+		if (width <= m_backgroundDepthResolution.x && height <= m_backgroundDepthResolution.y && m_backgroundDepthFormat == internalFormat)
+		{
+			return;
+		}
+
+		// Storage is immutable, so growing requires a new texture (never shrinks, see ReserveBackgroundResolution)
+		width = std::max(width, m_backgroundDepthResolution.x);
+		height = std::max(height, m_backgroundDepthResolution.y);
+		glDeleteTextures(1, &m_backgroundDepthBuffer);
+		glGenTextures(1, &m_backgroundDepthBuffer);
+		glBindTexture(GL_TEXTURE_2D, m_backgroundDepthBuffer);
+		if (GLAD_GL_ARB_texture_storage)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+		}
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		glBindTexture(GL_TEXTURE_2D, 0);
-		END_PROFILE("Upload Depth Array");
+		m_backgroundDepthResolution = Vector2i(width, height);
+		m_backgroundDepthFormat = internalFormat;
+	}
+
+	bool Renderer::AcquireBackgroundStaging(int width, int height, BackgroundStaging& outStaging)
+	{
+		if (!GLAD_GL_ARB_buffer_storage)
+		{
+			return false;
+		}
+
+		const GLsizeiptr pixelCount = static_cast<GLsizeiptr>(width) * height;
+		if (pixelCount > m_backgroundStagingCapacity)
+		{
+			ReleaseBackgroundStaging();
+
+			// Sized for the whole reserved background (if larger) so frames at lower resolutions reuse the same buffers
+			const GLsizeiptr capacity = std::max(pixelCount, static_cast<GLsizeiptr>(m_backgroundTexture[0].GetWidth()) * m_backgroundTexture[0].GetHeight());
+
+			// READ_BIT since the raycaster depth tests against what it has already written. CLIENT_STORAGE keeps the memory CPU-side (cached) for those reads.
+			const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			const GLsizeiptr bufferSize = capacity * (sizeof(GLuint) + sizeof(BackgroundDepth));
+			for (BackgroundStagingSlot& slot : m_backgroundStaging)
+			{
+				glGenBuffers(1, &slot.pixelBuffer);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+				glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, mapFlags | GL_CLIENT_STORAGE_BIT);
+				slot.pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, mapFlags);
+			}
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			m_backgroundStagingCapacity = capacity;
+		}
+		m_backgroundStagingResolution = Vector2i(width, height);
+
+		BackgroundStagingSlot& slot = m_backgroundStaging[m_backgroundStagingActive];
+		if (slot.pMapped == nullptr)
+		{
+			return false;
+		}
+
+		if (slot.fence)
+		{
+			START_PROFILE("Background Staging Wait");
+			while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000) == GL_TIMEOUT_EXPIRED) {}
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+			END_PROFILE("Background Staging Wait");
+		}
+
+		// Colour first, depth immediately after (both packed at this frame's resolution, whatever the capacity)
+		outStaging.pRGBA = static_cast<GLuint*>(slot.pMapped);
+		outStaging.pDepth = reinterpret_cast<BackgroundDepth*>(outStaging.pRGBA + pixelCount);
+		return true;
+	}
+
+	void Renderer::SubmitBackgroundStaging()
+	{
+		START_PROFILE("Upload Background Staging");
+		BackgroundStagingSlot& slot = m_backgroundStaging[m_backgroundStagingActive];
+		const int width = m_backgroundStagingResolution.x;
+		const int height = m_backgroundStagingResolution.y;
+		ReserveBackgroundResolution(width, height);
+		SetBackgroundResolution(width, height);
+
+		// While a pixel unpack buffer is bound, pixel pointers are byte offsets into it: these uploads become GPU-side copies
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+		m_backgroundTexture[m_backgroundTextureActive].SetRegionFromArrayRGBA(nullptr, width, height);
+
+		glBindTexture(GL_TEXTURE_2D, m_backgroundDepthBuffer);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, BACKGROUND_DEPTH_UNPACK_ALIGNMENT);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, BACKGROUND_DEPTH_TYPE, reinterpret_cast<const void*>(static_cast<GLintptr>(width) * height * sizeof(GLuint)));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_backgroundStagingActive = (m_backgroundStagingActive + 1) % BACKGROUND_STAGING_BUFFERS;
+		END_PROFILE("Upload Background Staging");
+	}
+
+	void Renderer::ReleaseBackgroundStaging()
+	{
+		for (BackgroundStagingSlot& slot : m_backgroundStaging)
+		{
+			if (slot.fence)
+			{
+				// Buffer may still be in use by the GPU
+				while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000) == GL_TIMEOUT_EXPIRED) {}
+				glDeleteSync(slot.fence);
+			}
+			if (slot.pixelBuffer)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				glDeleteBuffers(1, &slot.pixelBuffer);
+			}
+			slot = BackgroundStagingSlot();
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		m_backgroundStagingActive = 0;
+		m_backgroundStagingResolution = Vector2i(0, 0);
+		m_backgroundStagingCapacity = 0;
+	}
+
+	void Renderer::ReserveBackgroundResolution(int width, int height, GLenum depthFormat)
+	{
+		for (Texture& texture : m_backgroundTexture)
+		{
+			if (!texture.Exists() || width > static_cast<int>(texture.GetWidth()) || height > static_cast<int>(texture.GetHeight()))
+			{
+				texture.Resize(std::max(width, static_cast<int>(texture.GetWidth())), std::max(height, static_cast<int>(texture.GetHeight())));
+			}
+		}
+		ResizeBackgroundDepthBuffer(width, height, depthFormat);
+	}
+
+	void Renderer::SetBackgroundResolution(int width, int height)
+	{
+		m_backgroundResolution = Vector2i(width, height);
 	}
 
 	void Renderer::EraseBackgroundTextureData()
@@ -613,6 +754,11 @@ namespace Spear
 			GLint depthFalloffLoc = glGetUniformLocation(m_backgroundShader, "depthFalloff");
 			glUniform1f(depthFalloffLoc, m_backgroundDepthFalloff);
 
+			// Stretch the region covered by this frame over the whole screen
+			const Texture& backgroundTexture = m_backgroundTexture[m_backgroundTextureActive];
+			GLint texCoordScaleLoc = glGetUniformLocation(m_backgroundShader, "texCoordScale");
+			glUniform2f(texCoordScaleLoc, static_cast<float>(m_backgroundResolution.x) / backgroundTexture.GetWidth(), static_cast<float>(m_backgroundResolution.y) / backgroundTexture.GetHeight());
+
 			GLCheck(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1));
 
 			// Unbind textures
@@ -1,6 +1,7 @@
 #pragma once
 #include "Texture.h"
 #include "TextureFont.h"
+#include <algorithm>
 
 namespace Spear
 {
@@ -28,6 +29,39 @@ namespace Spear
 	constexpr int LINE_POS_MAXBYTES{ LINE_FLOATS_PER_POS * LINE_MAX };
 	constexpr int LINE_COL_MAXBYTES{ LINE_FLOATS_PER_COLOR * LINE_MAX };
 
+	// BACKGROUND
+	constexpr int BACKGROUND_STAGING_BUFFERS{3}; // triple buffered so one frame can be written while up to two are still in flight on the GPU
+
+	// Background depth is normalised (0 at camera, 1 at far clip). Build with SPEAR_DEPTH16 (premake --depth16) to store it as 16-bit unorm, halving depth bandwidth.
+#ifdef SPEAR_DEPTH16
+	using BackgroundDepth = GLushort;
+	constexpr GLenum BACKGROUND_DEPTH_FORMAT{GL_R16};
+	constexpr GLenum BACKGROUND_DEPTH_TYPE{GL_UNSIGNED_SHORT};
+#else
+	using BackgroundDepth = GLfloat;
+	constexpr GLenum BACKGROUND_DEPTH_FORMAT{GL_R32F};
+	constexpr GLenum BACKGROUND_DEPTH_TYPE{GL_FLOAT};
+#endif
+	constexpr GLint BACKGROUND_DEPTH_UNPACK_ALIGNMENT{sizeof(BackgroundDepth)}; // depth rows are tightly packed: 16-bit rows of an odd width aren't 4-byte aligned (GL's default)
+
+	// Converts normalised depth to/from BackgroundDepth (16-bit storage clamps anything beyond the far clip)
+	inline BackgroundDepth ToBackgroundDepth(float depth)
+	{
+#ifdef SPEAR_DEPTH16
+		return static_cast<GLushort>((std::clamp(depth, 0.f, 1.f) * 65535.f) + 0.5f);
+#else
+		return depth;
+#endif
+	}
+	inline float FromBackgroundDepth(BackgroundDepth depth)
+	{
+#ifdef SPEAR_DEPTH16
+		return static_cast<float>(depth) / 65535.f;
+#else
+		return depth;
+#endif
+	}
+
 	// System for rendering 2D images to the screen
 	class Renderer
 	{
@@ -79,6 +113,13 @@ namespace Spear
 			int segments{ 3 };
 		};
 
+		// CPU-visible memory which a frame's background colour/depth can be written straight into (see AcquireBackgroundStaging)
+		struct BackgroundStaging
+		{
+			GLuint* pRGBA{nullptr};
+			BackgroundDepth* pDepth{nullptr};
+		};
+
 		struct LineBoxData
 		{
 			Colour4f colour{ 1.f, 1.f, 1.f, 1.f };
@@ -116,12 +157,24 @@ namespace Spear
 		Texture& GetBackgroundTextureForNextFrame();
 		GLuint GetBackgroundDepthBufferForNextFrame();
 		void SetBackgroundDepthFalloff(float falloff);
-		void SetBackgroundTextureDataRGBA(GLuint* pDataRGBA, GLfloat* pDataDepth, int width, int height, bool bUploadDoubleBuffered = false);
+		void SetBackgroundTextureDataRGBA(GLuint* pDataRGBA, BackgroundDepth* pDataDepth, int width, int height, bool bUploadDoubleBuffered = false);
 		void EraseBackgroundTextureData();
+		void ResizeBackgroundDepthBuffer(int width, int height, GLenum internalFormat = BACKGROUND_DEPTH_FORMAT); // (re)allocates only to grow or change format
+
+		// Background storage only ever grows: frames smaller than it fill its bottom-left region, which is stretched over the whole screen
+		// Reserving the largest resolution up front means a renderer changing resolution every frame (dynamic resolution) never reallocates
+		void ReserveBackgroundResolution(int width, int height, GLenum depthFormat = BACKGROUND_DEPTH_FORMAT);
+		void SetBackgroundResolution(int width, int height); // for writers filling the background textures directly (compute shaders), uploads set it themselves
+
+		// Persistent-mapped alternative to SetBackgroundTextureDataRGBA: write the next frame into outStaging (from any thread), then call SubmitBackgroundStaging
+		// Returns false if persistent mapping isn't supported, otherwise may wait for the GPU to finish with the frame which last used these buffers
+		bool AcquireBackgroundStaging(int width, int height, BackgroundStaging& outStaging);
+		void SubmitBackgroundStaging();
 
 	private:
 		void InitialiseFrameBufferObject();
 		void InitialiseBackgroundBuffers();
+		void ReleaseBackgroundStaging();
 		void InitialiseLineBuffers();
 		void InitialiseSpriteBuffers();
 		void InitialiseTextBuffers();
@@ -150,8 +203,23 @@ namespace Spear
 		Texture m_backgroundTexture[2]; // double buffer prevents having to wait for last frame to finish
 		int m_backgroundTextureActive{0};
 		GLuint m_backgroundDepthBuffer{0};
+		Vector2i m_backgroundDepthResolution{0, 0};
+		Vector2i m_backgroundResolution{0, 0}; // region of the background textures covered by the next frame
+		GLenum m_backgroundDepthFormat{0};
 		float m_backgroundDepthFalloff{ 2.f };
 
+		// screen background staging (pixel unpack buffers, persistently mapped)
+		struct BackgroundStagingSlot
+		{
+			GLuint pixelBuffer{0};
+			void* pMapped{nullptr};
+			GLsync fence{nullptr}; // signalled once the GPU has finished copying this slot into the background textures
+		};
+		BackgroundStagingSlot m_backgroundStaging[BACKGROUND_STAGING_BUFFERS];
+		int m_backgroundStagingActive{0};
+		Vector2i m_backgroundStagingResolution{0, 0};
+		GLsizeiptr m_backgroundStagingCapacity{0}; // pixels
+
 		// sprite data
 		GLuint m_spriteVAO{0};
 		GLuint m_spritePosBuffer{0};
@@ -48,6 +48,14 @@ namespace Spear
 			Allocate(width, height);
 		}
 
+		SetRegionFromArrayRGBA(pPixels, width, height);
+		return true;
+	}
+
+	void Texture::SetRegionFromArrayRGBA(GLuint* pPixels, int width, int height)
+	{
+		ASSERT(m_textureId != 0 && width <= static_cast<int>(m_textureWidth) && height <= static_cast<int>(m_textureHeight));
+
 		// bind THIS texture
 		glBindTexture(GL_TEXTURE_2D, m_textureId);
 
@@ -73,14 +81,16 @@ namespace Spear
 
 		// unbind texture
 		glBindTexture(GL_TEXTURE_2D, NULL);
-
-		m_textureWidth = width;
-		m_textureHeight = height;
-		return true;
 	}
 
 	void Texture::Resize(int width, int height)
 	{
+		if (m_textureId == 0)
+		{
+			Allocate(width, height);
+			return;
+		}
+
 		// bind THIS texture
 		glBindTexture(GL_TEXTURE_2D, m_textureId);
 
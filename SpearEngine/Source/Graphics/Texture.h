@@ -10,6 +10,7 @@ namespace Spear
 		~Texture();
 
 		bool SetDataFromArrayRGBA(GLuint* pPixels, int width, int height);
+		void SetRegionFromArrayRGBA(GLuint* pPixels, int width, int height); // updates the bottom-left width x height region without reallocating (must fit within the texture)
 		void Resize(int width, int height);
 
 		// TextureBase Overrides
@@ -20,7 +21,8 @@ namespace Spear
 		GLuint GetDepth() const override {return 0;};
 		bool Exists() const override {return (m_textureId != 0); };
 		bool IsArray() const override {return false;};
-		const SDL_Surface* GetSDLSurface(int slot = 0) const override {return nullptr;};
+		const u32* GetTexelsRGBA(int slot = 0) const override {return nullptr;};
+		const u32* GetTexelsRGBAColumnMajor(int slot = 0) const override {return nullptr;};
 
 	private:
 		void Allocate(int width, int height);
@@ -2,9 +2,91 @@
 #include "SDL_Image.h"
 #include "Core/Colour.h"
 #include "Core/AssetManifest.h"
+#include "Core/ServiceLocator.h"
+#include "Core/ThreadManager.h"
+#include <fstream>
+#include <algorithm>
 
 namespace Spear
 {
+	// Baked copy of a directory's decoded texels, written beside its files whenever they have to be decoded
+	constexpr const char* TEXTURE_BLOB_FILENAME{ "/textures.texbin" };
+	constexpr u32 TEXTURE_BLOB_MAGIC{ 0x42585453 }; // 'STXB'
+	constexpr u32 TEXTURE_BLOB_VERSION{ 1 };
+	constexpr u32 TEXTURE_BLOB_MAX_SIZE{ 8192 };
+
+	constexpr u64 FNV_OFFSET_BASIS{ 14695981039346656037ull };
+	constexpr u64 FNV_PRIME{ 1099511628211ull };
+
+	struct TextureBlobHeader
+	{
+		u32 magic{ TEXTURE_BLOB_MAGIC };
+		u32 version{ TEXTURE_BLOB_VERSION };
+		u32 width{ 0 };
+		u32 height{ 0 };
+		u32 slots{ 0 };
+		u32 padding{ 0 };
+		u64 contentHash{ 0 };	// of the files the texels were decoded from
+	};
+
+	static u64 HashBytes(u64 hash, const void* pData, size_t bytes)
+	{
+		// FNV-1a
+		const u8* pBytes = static_cast<const u8*>(pData);
+		for (size_t i = 0; i < bytes; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	// Colour is averaged over texels which aren't fully transparent (so cutout edges don't darken), alpha over all four rounding up (so cutouts don't vanish with distance)
+	static u32 AverageTexels(u32 a, u32 b, u32 c, u32 d)
+	{
+		const u32 texels[4]{ a, b, c, d };
+		u32 red{ 0 };
+		u32 green{ 0 };
+		u32 blue{ 0 };
+		u32 alpha{ 0 };
+		u32 visible{ 0 };
+		for (u32 texel : texels)
+		{
+			alpha += texel >> 24;
+			if (texel & 0xFF000000)
+			{
+				red += texel & 0xFF;
+				green += (texel >> 8) & 0xFF;
+				blue += (texel >> 16) & 0xFF;
+				visible++;
+			}
+		}
+		if (visible == 0)
+		{
+			return 0;
+		}
+
+		const u32 round = visible / 2;
+		return ((red + round) / visible) | (((green + round) / visible) << 8) | (((blue + round) / visible) << 16) | (((alpha + 3) / 4) << 24);
+	}
+
+	static void ReadFileBytes(const std::string& filename, std::vector<u8>& out_bytes)
+	{
+		out_bytes.clear();
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return;
+		}
+		out_bytes.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(out_bytes.data()), out_bytes.size());
+		if (!file)
+		{
+			out_bytes.clear();
+		}
+	}
+
 	TextureArray::TextureArray()
 	{}
 	
@@ -15,44 +97,260 @@ namespace Spear
 
 	bool TextureArray::InitialiseFromDirectory(const char* dir, int* out_totalSlots)
 	{
-		// Make sure any previously set memory is released
-		FreeTexture();
+		DecodedTextureArray decoded;
+		DecodeDirectory(dir, decoded, Exists() ? m_contentHash : 0);
+		const bool bResult = InitialiseFromDecoded(std::move(decoded));
+
+		// Return info
+		if (out_totalSlots)
+		{
+			*out_totalSlots = m_textureDepth;
+		}
+		return bResult;
+	}
+
+	bool TextureArray::DecodeDirectory(const char* dir, DecodedTextureArray& out_decoded, u64 residentContentHash)
+	{
+		out_decoded = DecodedTextureArray();
+		out_decoded.directory = dir;
 
 		// Load manifest of PNG files in directory
 		Manifest manifest;
 		AssetManifest::GetManifest(dir, ".png", manifest);
+		if (manifest.empty())
+		{
+			return false;
+		}
+		const int slotCount = static_cast<int>(manifest.size());
 
-		// Load first existing image as a 'template' we can use to configure width/height (assuming all images in a directory are always same resolution)
-		for (const std::string& file : manifest)
+		// Read every file up front (cheap next to decoding them) so the directory can be hashed before deciding whether anything needs decoding
+		ThreadManager& threadManager = ServiceLocator::GetThreadManager();
+		std::vector<std::vector<u8>> fileBytes(slotCount);
+		std::vector<u64> fileHashes(slotCount);
+		threadManager.ParallelFor(0, slotCount, 1, [&](int begin, int end)
 		{
-			if (file == "")
+			for (int slot = begin; slot < end; slot++)
+			{
+				ReadFileBytes(manifest[slot], fileBytes[slot]);
+				fileHashes[slot] = HashBytes(FNV_OFFSET_BASIS, fileBytes[slot].data(), fileBytes[slot].size());
+			}
+		});
+		u64 contentHash = HashBytes(FNV_OFFSET_BASIS, &slotCount, sizeof(slotCount));
+		out_decoded.contentHash = HashBytes(contentHash, fileHashes.data(), fileHashes.size() * sizeof(u64));
+
+		if (residentContentHash != 0 && out_decoded.contentHash == residentContentHash)
+		{
+			out_decoded.bUnchanged = true;
+			return true;
+		}
+
+		const std::string blobPath = std::string(dir) + TEXTURE_BLOB_FILENAME;
+		if (ReadBlob(blobPath, slotCount, out_decoded))
+		{
+			return true;
+		}
+
+		// Decode each slot from manifest
+		std::vector<SDL_Surface*> surfaces(slotCount, nullptr);
+		threadManager.ParallelFor(0, slotCount, 1, [&](int begin, int end)
+		{
+			for (int slot = begin; slot < end; slot++)
+			{
+				if (fileBytes[slot].size())
+				{
+					surfaces[slot] = IMG_Load_RW(SDL_RWFromConstMem(fileBytes[slot].data(), static_cast<int>(fileBytes[slot].size())), 1);
+				}
+				std::vector<u8>().swap(fileBytes[slot]);
+			}
+		});
+
+		// Use first existing image as a 'template' to configure width/height (assuming all images in a directory are always same resolution)
+		for (int slot = 0; slot < slotCount; slot++)
+		{
+			if (manifest[slot] == "")
 			{
 				continue;
 			}
 
-			SDL_Surface* paramsTemplate = IMG_Load(file.c_str());
-			Allocate(paramsTemplate->w, paramsTemplate->h, manifest.size());
-			SDL_FreeSurface(paramsTemplate);
+			if (surfaces[slot])
+			{
+				out_decoded.width = surfaces[slot]->w;
+				out_decoded.height = surfaces[slot]->h;
+				out_decoded.slots = slotCount;
+			}
 			break;
 		}
+		if (out_decoded.slots == 0)
+		{
+			for (SDL_Surface* pSurface : surfaces)
+			{
+				SDL_FreeSurface(pSurface);
+			}
+			return false;
+		}
+
+		const int layerTexels = out_decoded.width * out_decoded.height;
+		const size_t chainTexels = MipOffset(out_decoded.width, out_decoded.height, out_decoded.slots, MipLevelCount(out_decoded.width, out_decoded.height));
+		out_decoded.texelsRGBA.assign(chainTexels, 0);
+		out_decoded.texelsRGBAColumnMajor.assign(chainTexels, 0);
+
+		// Convert each slot (any missing files are generated a flat purple texture)
+		threadManager.ParallelFor(0, slotCount, 1, [&](int begin, int end)
+		{
+			for (int slot = begin; slot < end; slot++)
+			{
+				SDL_Surface* pSurface = surfaces[slot];
+				if (!pSurface)
+				{
+					LOG(std::string("Texture failed to load: ") + manifest[slot]);
+
+					pSurface = SDL_CreateRGBSurface(0, out_decoded.width, out_decoded.height, 32, 0, 0, 0, 0);
+					Uint32 color = SDL_MapRGB(pSurface->format, 255, 0, 255);
+					SDL_FillRect(pSurface, NULL, color);
+				}
+				ASSERT(pSurface->w == out_decoded.width && pSurface->h == out_decoded.height);
+
+				if (pSurface->format->format != SDL_PIXELFORMAT_RGBA32 && pSurface->format->format != SDL_PIXELFORMAT_BGRA32)
+				{
+					LOG(std::string("WARNING: Converted image from non-suitable texture format: ") + manifest[slot]);
+					SDL_Surface* pConvertedSurface = SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_RGBA32, 0);
+					SDL_FreeSurface(pSurface);
+					if (!pConvertedSurface)
+					{
+						LOG("\tABORT: Image conversion failed!");
+						continue;
+					}
+					pSurface = pConvertedSurface;
+				}
+
+				u32* pRowMajor = &out_decoded.texelsRGBA[slot * layerTexels];
+				ConvertSurfaceToRGBA(pSurface, pRowMajor);
+				TransposeToColumnMajor(pRowMajor, out_decoded.width, out_decoded.height, &out_decoded.texelsRGBAColumnMajor[slot * layerTexels]);
+				BuildMipChain(out_decoded.texelsRGBA.data(), out_decoded.texelsRGBAColumnMajor.data(), out_decoded.width, out_decoded.height, out_decoded.slots, slot);
+				SDL_FreeSurface(pSurface);
+			}
+		});
 
-		// Initialise each slot from manifest (any missing files will be generated a flat purple texture internally within SetDataFromFile)
+		WriteBlob(blobPath, out_decoded);
+		return true;
+	}
+
+	bool TextureArray::InitialiseFromDecoded(DecodedTextureArray&& decoded)
+	{
+		if (decoded.bUnchanged)
 		{
-			int i{ 0 };
-			for (const std::string& filepath : manifest)
+			if (Exists() && decoded.contentHash == m_contentHash)
 			{
-				SetDataFromFile(i++, filepath.c_str());
+				decoded = DecodedTextureArray();
+				return true;
 			}
+
+			// Array has been given something else since the directory was checked against it
+			const std::string directory = decoded.directory;
+			DecodeDirectory(directory.c_str(), decoded);
 		}
 
-		// Return info
-		if (out_totalSlots)
+		// Make sure any previously set memory is released
+		FreeTexture();
+		if (decoded.slots == 0)
+		{
+			return true;
+		}
+
+		Allocate(decoded.width, decoded.height, decoded.slots);
+		m_texelsRGBA = std::move(decoded.texelsRGBA);
+		m_texelsRGBAColumnMajor = std::move(decoded.texelsRGBAColumnMajor);
+		m_contentHash = decoded.contentHash;
+		decoded = DecodedTextureArray();
+		for (GLuint slot = 0; slot < m_textureDepth; slot++)
+		{
+			BuildOpaqueSpans(slot);
+		}
+
+		// Every slot in one upload
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureId);
+		GLCheck(glTexSubImage3D(
+			GL_TEXTURE_2D_ARRAY,
+			0,
+			0,
+			0,
+			0,
+			m_textureWidth,
+			m_textureHeight,
+			m_textureDepth,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			m_texelsRGBA.data()
+		));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, NULL);
+		return true;
+	}
+
+	bool TextureArray::ReadBlob(const std::string& blobPath, GLuint slots, DecodedTextureArray& decoded)
+	{
+		std::ifstream file(blobPath, std::ios::binary);
+		if (!file)
 		{
-			*out_totalSlots = manifest.size();
+			return false;
 		}
+
+		TextureBlobHeader header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file
+			|| header.magic != TEXTURE_BLOB_MAGIC
+			|| header.version != TEXTURE_BLOB_VERSION
+			|| header.contentHash != decoded.contentHash
+			|| header.slots != slots
+			|| header.width == 0 || header.width > TEXTURE_BLOB_MAX_SIZE
+			|| header.height == 0 || header.height > TEXTURE_BLOB_MAX_SIZE)
+		{
+			return false;
+		}
+
+		// Only level 0 is baked, mips are quicker to rebuild than to read
+		const int layerTexels = header.width * header.height;
+		decoded.texelsRGBA.resize(MipOffset(header.width, header.height, header.slots, MipLevelCount(header.width, header.height)));
+		file.read(reinterpret_cast<char*>(decoded.texelsRGBA.data()), static_cast<size_t>(layerTexels) * header.slots * sizeof(u32));
+		if (!file)
+		{
+			LOG("Texture blob is truncated, decoding files instead: " + blobPath);
+			decoded.texelsRGBA.clear();
+			return false;
+		}
+
+		decoded.width = header.width;
+		decoded.height = header.height;
+		decoded.slots = header.slots;
+		decoded.texelsRGBAColumnMajor.resize(decoded.texelsRGBA.size());
+		ServiceLocator::GetThreadManager().ParallelFor(0, header.slots, 1, [&](int begin, int end)
+		{
+			for (int slot = begin; slot < end; slot++)
+			{
+				TransposeToColumnMajor(&decoded.texelsRGBA[slot * layerTexels], decoded.width, decoded.height, &decoded.texelsRGBAColumnMajor[slot * layerTexels]);
+				BuildMipChain(decoded.texelsRGBA.data(), decoded.texelsRGBAColumnMajor.data(), decoded.width, decoded.height, decoded.slots, slot);
+			}
+		});
 		return true;
 	}
 
+	void TextureArray::WriteBlob(const std::string& blobPath, const DecodedTextureArray& decoded)
+	{
+		std::ofstream file(blobPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			LOG("Unable to write texture blob: " + blobPath);
+			return;
+		}
+
+		TextureBlobHeader header;
+		header.width = decoded.width;
+		header.height = decoded.height;
+		header.slots = decoded.slots;
+		header.contentHash = decoded.contentHash;
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(decoded.texelsRGBA.data()), static_cast<size_t>(decoded.width) * decoded.height * decoded.slots * sizeof(u32));
+	}
+
 	void TextureArray::Allocate(GLuint width, GLuint height, GLuint slots)
 	{
 		// Create new texture array
@@ -76,17 +374,30 @@ namespace Spear
 
 		glBindTexture(GL_TEXTURE_2D_ARRAY, 0); // unbind
 
+		m_contentHash = 0;
 		m_textureWidth = width;
 		m_textureHeight = height;
 		m_textureDepth = slots;
-		FreeSDLSurfaces();
-		m_pSDLSurfaces.resize(slots);
+		m_mipLevels = MipLevelCount(width, height);
+		for (int level = 0; level < m_mipLevels; level++)
+		{
+			m_mipOffsets[level] = MipOffset(width, height, slots, level);
+		}
+		m_texelsRGBA.assign(MipOffset(width, height, slots, m_mipLevels), 0);
+		m_texelsRGBAColumnMajor.assign(m_texelsRGBA.size(), 0);
+
+		// Every slot starts fully transparent: no opaque runs in any column
+		m_opaqueSpans.assign(slots, OpaqueSpanTable());
+		for (OpaqueSpanTable& table : m_opaqueSpans)
+		{
+			table.columnStarts.assign(width + 1, 0);
+		}
 
 		// Create the TextureViews array for accessing layers as individual textures
 		m_textureViews.clear();
 		m_textureViews.resize(slots);
 		glGenTextures(slots, m_textureViews.data());
-		for (int i = 0; i < slots; i++)
+		for (GLuint i = 0; i < slots; i++)
 		{
 			glTextureView(m_textureViews[i], GL_TEXTURE_2D, m_textureId, GL_RGBA8, 0, 1, i, 1);
 		}
@@ -94,30 +405,34 @@ namespace Spear
 
 	bool TextureArray::SetDataFromFile(GLuint slot, const char* filename)
 	{
-		m_pSDLSurfaces.at(slot) = IMG_Load(filename);
-		if (!m_pSDLSurfaces.at(slot))
+		SDL_Surface* pSurface = IMG_Load(filename);
+		if (!pSurface)
 		{
 			LOG(std::string("Texture failed to load: ") + filename);
 
-			m_pSDLSurfaces.at(slot) = SDL_CreateRGBSurface(0, m_textureWidth, m_textureHeight, 32, 0, 0, 0, 0);
-			Uint32 color = SDL_MapRGB(m_pSDLSurfaces.at(slot)->format, 255, 0, 255);
-			SDL_FillRect(m_pSDLSurfaces.at(slot), NULL, color);
+			pSurface = SDL_CreateRGBSurface(0, m_textureWidth, m_textureHeight, 32, 0, 0, 0, 0);
+			Uint32 color = SDL_MapRGB(pSurface->format, 255, 0, 255);
+			SDL_FillRect(pSurface, NULL, color);
 		}
-		ASSERT(m_pSDLSurfaces.at(slot)->w == m_textureWidth && m_pSDLSurfaces.at(slot)->h == m_textureHeight);
+		ASSERT(pSurface->w == m_textureWidth && pSurface->h == m_textureHeight);
 
-		if (m_pSDLSurfaces.at(slot)->format->format != SDL_PIXELFORMAT_RGBA32 && m_pSDLSurfaces.at(slot)->format->format != SDL_PIXELFORMAT_BGRA32)
+		if (pSurface->format->format != SDL_PIXELFORMAT_RGBA32 && pSurface->format->format != SDL_PIXELFORMAT_BGRA32)
 		{
 			LOG(std::string("WARNING: Converted image from non-suitable texture format: ") + filename);
-			SDL_Surface* pConvertedSurface = SDL_ConvertSurfaceFormat(m_pSDLSurfaces.at(slot), SDL_PIXELFORMAT_RGBA32, 0);
+			SDL_Surface* pConvertedSurface = SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_RGBA32, 0);
 			if (!pConvertedSurface)
 			{
 				LOG("\tABORT: Image conversion failed!");
+				SDL_FreeSurface(pSurface);
 				return false;
 			}
-			SDL_FreeSurface(m_pSDLSurfaces.at(slot));		// free up the old image
-			m_pSDLSurfaces.at(slot) = pConvertedSurface;	// update pointer to converted image
+			SDL_FreeSurface(pSurface);		// free up the old image
+			pSurface = pConvertedSurface;	// update pointer to converted image
 		}
 
+		SetCPUTexels(slot, pSurface);
+		m_contentHash = 0;
+
 		// bind THIS texture array
 		glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureId);
 
@@ -132,18 +447,20 @@ namespace Spear
 			1,						// 'depth' of texture (always 1 for a single slice)
 			GL_RGBA,
 			GL_UNSIGNED_BYTE,
-			m_pSDLSurfaces.at(slot)->pixels
+			GetTexelsRGBA(slot)
 		));		
 
 		// unbind texture
 		glBindTexture(GL_TEXTURE_2D_ARRAY, NULL);
 
+		SDL_FreeSurface(pSurface);
 		return true;
 	}
 
-	bool TextureArray::SetDataFromArrayRGBA(GLuint slot, float* pPixels, int width, int height)
+	bool TextureArray::SetDataFromArrayRGBA(GLuint slot, float* pPixels, int, int)
 	{
-		ASSERT(width == m_textureWidth && height == m_textureHeight);
+		SetCPUTexels(slot, reinterpret_cast<const u32*>(pPixels));
+		m_contentHash = 0;
 
 		// bind THIS texture
 		glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureId);
@@ -170,7 +487,7 @@ namespace Spear
 
 	GLuint TextureArray::GetTextureViewForLayer(int layer) const
 	{
-		if (layer >= 0 && layer < m_textureViews.size())
+		if (layer >= 0 && static_cast<size_t>(layer) < m_textureViews.size())
 		{
 			return m_textureViews[layer];
 		}
@@ -190,17 +507,139 @@ namespace Spear
 		m_textureWidth = 0;
 		m_textureHeight = 0;
 		m_textureDepth = 0;
+		m_mipLevels = 0;
+		m_contentHash = 0;
 
-		FreeSDLSurfaces();
+		m_texelsRGBA.clear();
+		m_texelsRGBAColumnMajor.clear();
+		m_opaqueSpans.clear();
 	}
 
-	void TextureArray::FreeSDLSurfaces()
+	void TextureArray::SetCPUTexels(GLuint slot, const SDL_Surface* pSurface)
 	{
-		for (SDL_Surface*& pSurf : m_pSDLSurfaces)
+		ASSERT(pSurface->w == m_textureWidth && pSurface->h == m_textureHeight);
+		u32* pRowMajor = &m_texelsRGBA[slot * LayerTexels()];
+		ConvertSurfaceToRGBA(pSurface, pRowMajor);
+		SetCPUTexels(slot, pRowMajor);
+	}
+
+	void TextureArray::SetCPUTexels(GLuint slot, const u32* pTexelsRGBA)
+	{
+		ASSERT(slot < m_textureDepth);
+		u32* pRowMajor = &m_texelsRGBA[slot * LayerTexels()];
+		if (pTexelsRGBA != pRowMajor)
+		{
+			std::copy(pTexelsRGBA, pTexelsRGBA + LayerTexels(), pRowMajor);
+		}
+		TransposeToColumnMajor(pRowMajor, m_textureWidth, m_textureHeight, &m_texelsRGBAColumnMajor[slot * LayerTexels()]);
+		BuildMipChain(m_texelsRGBA.data(), m_texelsRGBAColumnMajor.data(), m_textureWidth, m_textureHeight, m_textureDepth, slot);
+		BuildOpaqueSpans(slot);
+	}
+
+	void TextureArray::BuildOpaqueSpans(GLuint slot)
+	{
+		OpaqueSpanTable& table = m_opaqueSpans[slot];
+		table.spans.clear();
+		const u32* pColumnMajor = &m_texelsRGBAColumnMajor[slot * LayerTexels()];
+		for (GLuint x = 0; x < m_textureWidth; x++)
+		{
+			table.columnStarts[x] = static_cast<u32>(table.spans.size());
+			const u32* pColumn = &pColumnMajor[x * m_textureHeight];
+			GLuint y = 0;
+			while (y < m_textureHeight)
+			{
+				if (!(pColumn[y] & 0xFF000000))
+				{
+					y++;
+					continue;
+				}
+				TexelSpan span;
+				span.start = static_cast<u16>(y);
+				while (y < m_textureHeight && (pColumn[y] & 0xFF000000))
+				{
+					y++;
+				}
+				span.end = static_cast<u16>(y);
+				table.spans.push_back(span);
+			}
+		}
+		table.columnStarts[m_textureWidth] = static_cast<u32>(table.spans.size());
+	}
+
+	void TextureArray::ConvertSurfaceToRGBA(const SDL_Surface* pSurface, u32* pOutRowMajor)
+	{
+		// Resolve format/pitch once here, so software rendering never has to call SDL_GetRGBA per texel
+		for (int y = 0; y < pSurface->h; y++)
+		{
+			const Uint32* pRow = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(pSurface->pixels) + (y * pSurface->pitch));
+			for (int x = 0; x < pSurface->w; x++)
+			{
+				Uint8 r, g, b, a;
+				SDL_GetRGBA(pRow[x], pSurface->format, &r, &g, &b, &a);
+				pOutRowMajor[x + (y * pSurface->w)] = r | (g << 8) | (b << 16) | (a << 24);
+			}
+		}
+	}
+
+	void TextureArray::TransposeToColumnMajor(const u32* pRowMajor, int width, int height, u32* pOutColumnMajor)
+	{
+		for (int x = 0; x < width; x++)
 		{
-			SDL_FreeSurface(pSurf);
-			pSurf = nullptr;
+			for (int y = 0; y < height; y++)
+			{
+				pOutColumnMajor[y + (x * height)] = pRowMajor[x + (y * width)];
+			}
+		}
+	}
+
+	int TextureArray::MipLevelCount(GLuint width, GLuint height)
+	{
+		int levels{ 1 };
+		while ((width > 1 || height > 1) && levels < MAX_MIP_LEVELS)
+		{
+			width = std::max(1u, width >> 1);
+			height = std::max(1u, height >> 1);
+			levels++;
+		}
+		return levels;
+	}
+
+	size_t TextureArray::MipOffset(GLuint width, GLuint height, GLuint slots, int level)
+	{
+		size_t offset{ 0 };
+		for (int i = 0; i < level; i++)
+		{
+			offset += static_cast<size_t>(std::max(1u, width >> i)) * std::max(1u, height >> i) * slots;
+		}
+		return offset;
+	}
+
+	void TextureArray::BuildMipChain(u32* pRowMajor, u32* pColumnMajor, GLuint width, GLuint height, GLuint slots, int slot)
+	{
+		const int levels = MipLevelCount(width, height);
+		for (int level = 1; level < levels; level++)
+		{
+			const GLuint srcWidth = std::max(1u, width >> (level - 1));
+			const GLuint srcHeight = std::max(1u, height >> (level - 1));
+			const GLuint dstWidth = std::max(1u, width >> level);
+			const GLuint dstHeight = std::max(1u, height >> level);
+			const u32* pSrc = &pRowMajor[MipOffset(width, height, slots, level - 1) + (slot * srcWidth * srcHeight)];
+			const size_t dstOffset = MipOffset(width, height, slots, level) + (slot * dstWidth * dstHeight);
+			u32* pDst = &pRowMajor[dstOffset];
+
+			// 2x2 box filter, clamped where a dimension has already reached 1
+			for (GLuint y = 0; y < dstHeight; y++)
+			{
+				const GLuint y0 = std::min(y * 2, srcHeight - 1) * srcWidth;
+				const GLuint y1 = std::min((y * 2) + 1, srcHeight - 1) * srcWidth;
+				for (GLuint x = 0; x < dstWidth; x++)
+				{
+					const GLuint x0 = std::min(x * 2, srcWidth - 1);
+					const GLuint x1 = std::min((x * 2) + 1, srcWidth - 1);
+					pDst[x + (y * dstWidth)] = AverageTexels(pSrc[x0 + y0], pSrc[x1 + y0], pSrc[x0 + y1], pSrc[x1 + y1]);
+				}
+			}
+			TransposeToColumnMajor(pDst, dstWidth, dstHeight, &pColumnMajor[dstOffset]);
 		}
-		m_pSDLSurfaces.clear();
 	}
 }
\ No newline at end of file
@@ -3,6 +3,19 @@
 
 namespace Spear
 {
+	// Texture array decoded from disk but not yet uploaded, see TextureArray::DecodeDirectory
+	struct DecodedTextureArray
+	{
+		std::string directory;
+		u64 contentHash{ 0 };						// of the directory's files in manifest order, 0 if nothing was found
+		bool bUnchanged{ false };					// contentHash matched the hash DecodeDirectory was told is already resident, so nothing was decoded
+		GLuint width{ 0 };
+		GLuint height{ 0 };
+		GLuint slots{ 0 };
+		std::vector<u32> texelsRGBA;				// mip chain of every slot, row-major (laid out as TextureBase::GetTexelsRGBAMip)
+		std::vector<u32> texelsRGBAColumnMajor;		// mip chain of every slot, column-major
+	};
+
 	class TextureArray : public TextureBase
 	{
 	public:
@@ -10,8 +23,19 @@ namespace Spear
 		~TextureArray();
 
 		// For automatically allocating an array from a directory (all files must have equal dimensions)
+		// Does nothing if the array already holds the directory's current contents
 		bool InitialiseFromDirectory(const char* dir, int* out_totalSlots = nullptr);
 
+		// InitialiseFromDirectory split into its CPU and GPU halves, so files can be decoded ahead of time on any thread
+		// Files are decoded in parallel, or read from the directory's baked blob if it was made from identical files (the blob is rewritten otherwise)
+		// Pass the GetContentHash() of an array the result may be given to, to skip decoding entirely if the directory still matches it
+		static bool DecodeDirectory(const char* dir, DecodedTextureArray& out_decoded, u64 residentContentHash = 0);
+		// Only uploads (main thread), taking ownership of the decoded texels
+		bool InitialiseFromDecoded(DecodedTextureArray&& decoded);
+
+		// Hash of the files this array was initialised from, 0 if it was not initialised from a directory or has been written to since
+		u64 GetContentHash() const { return m_contentHash; }
+
 		// For manually allocating an array slot-by-slot:
 		void Allocate(GLuint width, GLuint height, GLuint slots);
 		bool SetDataFromFile(GLuint slot, const char* filename);
@@ -28,16 +52,54 @@ namespace Spear
 		GLuint GetDepth() const override { return m_textureDepth; };
 		bool Exists() const override { return (m_textureId != 0); }
 		bool IsArray() const override { return true; };
-		const SDL_Surface* GetSDLSurface(int slot = 0) const override { return m_pSDLSurfaces.at(slot); };
+		const u32* GetTexelsRGBA(int slot = 0) const override { ASSERT(slot >= 0 && slot < m_textureDepth); return &m_texelsRGBA[slot * LayerTexels()]; };
+		const u32* GetTexelsRGBAColumnMajor(int slot = 0) const override { ASSERT(slot >= 0 && slot < m_textureDepth); return &m_texelsRGBAColumnMajor[slot * LayerTexels()]; };
+		int GetMipLevels() const override { return m_mipLevels; }
+		const u32* GetTexelsRGBAMip(int level, int slot = 0) const override { ASSERT(level >= 0 && level < m_mipLevels && slot >= 0 && slot < m_textureDepth); return &m_texelsRGBA[m_mipOffsets[level] + (slot * GetMipWidth(level) * GetMipHeight(level))]; };
+		const u32* GetTexelsRGBAColumnMajorMip(int level, int slot = 0) const override { ASSERT(level >= 0 && level < m_mipLevels && slot >= 0 && slot < m_textureDepth); return &m_texelsRGBAColumnMajor[m_mipOffsets[level] + (slot * GetMipWidth(level) * GetMipHeight(level))]; };
+		bool HasOpaqueSpans() const override { return true; }
+		const TexelSpan* GetOpaqueSpans(int slot, int column, int& outCount) const override
+		{
+			ASSERT(slot >= 0 && slot < m_textureDepth && column >= 0 && column < m_textureWidth);
+			const OpaqueSpanTable& table = m_opaqueSpans[slot];
+			outCount = table.columnStarts[column + 1] - table.columnStarts[column];
+			return table.spans.data() + table.columnStarts[column];
+		}
 
 	private:
-		void FreeSDLSurfaces();
-		std::vector<SDL_Surface*> m_pSDLSurfaces; // TODO: Shouldn't really keep this data on the CPU, except software renderer needs it - free these up somehow?
+		static constexpr int MAX_MIP_LEVELS{ 16 };
+
+		int LayerTexels() const { return m_textureWidth * m_textureHeight; }
+		static int MipLevelCount(GLuint width, GLuint height);
+		static size_t MipOffset(GLuint width, GLuint height, GLuint slots, int level); // level == MipLevelCount gives the size of the whole chain
+		static void BuildMipChain(u32* pRowMajor, u32* pColumnMajor, GLuint width, GLuint height, GLuint slots, int slot); // from the slot's level 0 row-major texels
+		static bool ReadBlob(const std::string& blobPath, GLuint slots, DecodedTextureArray& decoded);
+		static void WriteBlob(const std::string& blobPath, const DecodedTextureArray& decoded);
+		static void ConvertSurfaceToRGBA(const SDL_Surface* pSurface, u32* pOutRowMajor);
+		static void TransposeToColumnMajor(const u32* pRowMajor, int width, int height, u32* pOutColumnMajor);
+		void SetCPUTexels(GLuint slot, const SDL_Surface* pSurface);
+		void SetCPUTexels(GLuint slot, const u32* pTexelsRGBA);
+		void BuildOpaqueSpans(GLuint slot); // from the slot's level 0 column-major texels
+
+		// Software renderer reads these instead of the loaded SDL_Surfaces, which are freed as soon as each layer is uploaded
+		std::vector<u32> m_texelsRGBA;
+		std::vector<u32> m_texelsRGBAColumnMajor;
+		int m_mipLevels{ 0 };
+		size_t m_mipOffsets[MAX_MIP_LEVELS]{};
+
+		// Opaque runs down each column of a slot: column c's are spans[columnStarts[c]] until spans[columnStarts[c + 1]]
+		struct OpaqueSpanTable
+		{
+			std::vector<u32> columnStarts;
+			std::vector<TexelSpan> spans;
+		};
+		std::vector<OpaqueSpanTable> m_opaqueSpans;
 		std::vector<GLuint> m_textureViews; // for accessing layers within texture array as individual textures - particularly useful for passing to ImGui
 		GLuint m_textureId{ 0 };
 		GLuint m_textureWidth{ 0 };
 		GLuint m_textureHeight{ 0 };
 		GLuint m_textureDepth{ 0 };
+		u64 m_contentHash{ 0 };
 	};
 
 }
\ No newline at end of file
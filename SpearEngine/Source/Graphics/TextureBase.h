@@ -3,6 +3,13 @@
 
 namespace Spear
 {
+	// Run of texels down one column of a texture, rows [start, end)
+	struct TexelSpan
+	{
+		u16 start;
+		u16 end;
+	};
+
 	class TextureBase
 	{
 	public:
@@ -15,7 +22,25 @@ namespace Spear
 		virtual GLuint GetTextureViewForLayer(int layer = 0) const { return 0; }
 		virtual bool Exists() const = 0;
 		virtual bool IsArray() const = 0;
-		virtual const SDL_Surface* GetSDLSurface(int slot = 0) const = 0;
+
+		// CPU copies of texels for software rendering, pre-converted to RGBA8 (r | g << 8 | b << 16 | a << 24, the same layout as raycaster background data)
+		// Row-major: texel (x, y) is at [x + (y * width)]. Column-major: texel (x, y) is at [y + (x * height)], for reading vertical strips contiguously
+		// Layers are contiguous, so GetTexelsRGBA(slot) == GetTexelsRGBA(0) + (slot * width * height)
+		virtual const u32* GetTexelsRGBA(int slot = 0) const = 0;
+		virtual const u32* GetTexelsRGBAColumnMajor(int slot = 0) const = 0;
+
+		// Box-filtered CPU mip chain of the above, so distant surfaces can sample small (cache resident) copies. Level 0 is the texels above.
+		// Each level halves width/height (to a minimum of 1) with layers contiguous in the same way, so GetTexelsRGBAMip(level, slot) == GetTexelsRGBAMip(level, 0) + (slot * GetMipWidth(level) * GetMipHeight(level))
+		virtual int GetMipLevels() const { return 1; }
+		virtual const u32* GetTexelsRGBAMip(int level, int slot = 0) const { return level == 0 ? GetTexelsRGBA(slot) : nullptr; }
+		virtual const u32* GetTexelsRGBAColumnMajorMip(int level, int slot = 0) const { return level == 0 ? GetTexelsRGBAColumnMajor(slot) : nullptr; }
+		GLuint GetMipWidth(int level) const { return (GetWidth() >> level) > 0 ? (GetWidth() >> level) : 1; }
+		GLuint GetMipHeight(int level) const { return (GetHeight() >> level) > 0 ? (GetHeight() >> level) : 1; }
+
+		// Runs of texels with non-zero alpha down each level 0 column (rows as in GetTexelsRGBA), so the transparent parts of a column can be skipped without reading them
+		// Only valid if HasOpaqueSpans(): other textures should treat every column as a single opaque run
+		virtual bool HasOpaqueSpans() const { return false; }
+		virtual const TexelSpan* GetOpaqueSpans(int /*slot*/, int /*column*/, int& outCount) const { outCount = 0; return nullptr; }
 	};
 
 }
\ No newline at end of file
@@ -41,13 +41,9 @@ void FlowstateGame::StateEnter()
 	audio.InitSoundsFromFolder("../ASSETS/SFX/");				// Load SFX from folder
 	audio.GlobalPlayStream("../ASSETS/MUSIC/Ambience1.mp3");	// Test file streaming
 
-	// Load world
-	LevelFileManager::LoadLevel("Main.level", m_gameState.mapData);
+	// Load world and textures
+	m_gameState.levelStreamer.LoadLevel("Main.level", m_gameState.mapData, m_textures);
 	Raycaster::Init(m_gameState.mapData);
-
-	// Load textures
-	m_textures[GlobalTextureBatches::BATCH_TILESET_1].InitialiseFromDirectory(m_gameState.mapData.tileDirectory.path().string().c_str());
-	m_textures[GlobalTextureBatches::BATCH_SPRITESET_1].InitialiseFromDirectory(m_gameState.mapData.spriteDirectory.path().string().c_str());
 	for (int i = 0; i < GlobalTextureBatches::BATCH_TOTALS; i++)
 	{
 		Spear::Renderer::Get().CreateSpriteBatch(m_textures[i], 1000);
@@ -154,13 +150,9 @@ int FlowstateGame::StateUpdate(float deltaTime)
 		// Clear loaded textures
 		Spear::ServiceLocator::GetScreenRenderer().ReleaseAll();
 
-		// Load world
-		LevelFileManager::LoadLevel(pendingLevel.levelName.c_str(), m_gameState.mapData);
+		// Load world and textures (already streamed in by the level's OLevelLink if the player approached it, leaving only GameObjects to spawn and GPU uploads)
+		m_gameState.levelStreamer.LoadLevel(pendingLevel.levelName, m_gameState.mapData, m_textures);
 		Raycaster::Init(m_gameState.mapData);
-
-		// Load textures
-		m_textures[GlobalTextureBatches::BATCH_TILESET_1].InitialiseFromDirectory(m_gameState.mapData.tileDirectory.path().string().c_str());
-		m_textures[GlobalTextureBatches::BATCH_SPRITESET_1].InitialiseFromDirectory(m_gameState.mapData.spriteDirectory.path().string().c_str());
 		for (int i = 0; i < GlobalTextureBatches::BATCH_TOTALS; i++)
 		{
 			Spear::Renderer::Get().CreateSpriteBatch(m_textures[i], 1000);
@@ -212,6 +204,10 @@ void FlowstateGame::StateExit()
 {
 	GameObject::GlobalDestroy();
 
+	// Drop the level's tiles and anything streamed in (and with them any mapping of binary level files) so the editor is free to rewrite them
+	m_gameState.levelStreamer.Flush();
+	m_gameState.mapData.Allocate(1, 1);
+
 	Spear::AudioManager::Get().StopAllAudio();
 
 	Spear::ServiceLocator::GetScreenRenderer().ReleaseAll();
@@ -1,6 +1,7 @@
 #pragma once
 #include "Player.h"
 #include "Raycaster/Raycaster.h"
+#include "LevelStreamer.h"
 
 struct LevelTransition
 {
@@ -23,6 +24,7 @@ struct GameState
 
 	Player* player{nullptr};
 	MapData mapData;
+	LevelStreamer levelStreamer;
 
 	LevelTransition levelTransition;
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+#include "Core/Core.h"
+#include <cmath>
+
+// Scalar types for GridDDA: how lengths along a ray are stored and accumulated
+struct DDAFloat
+{
+	using Length = float;
+	static Length FromFloat(float value) { return value; }
+	static float ToFloat(Length value) { return value; }
+};
+
+// 16.16 fixed point: every step adds exactly the same integer length, so a ray's error stays that of its rounded step sizes however far it travels
+// Lengths saturate at MAX_LENGTH (about 16384 tiles, far beyond any map or farClip) so adding a saturated step to a saturated length still fits in s32
+struct DDAFixed
+{
+	using Length = s32;
+	static constexpr int FRACTION_BITS{ 16 };
+	static constexpr Length MAX_LENGTH{ (1 << 30) - 1 };
+
+	static Length FromFloat(float value)
+	{
+		// NaN (zero distance to an edge times the infinite step of an axis the ray never moves along) saturates too, so that axis is never stepped
+		const float scaled = value * (1 << FRACTION_BITS);
+		return scaled < static_cast<float>(MAX_LENGTH) ? static_cast<Length>(scaled + 0.5f) : MAX_LENGTH;
+	}
+	static float ToFloat(Length value) { return static_cast<float>(value) * (1.f / (1 << FRACTION_BITS)); }
+};
+
+// Digital differential analysis: walks a ray through the unit tiles of the map grid one tile edge at a time
+// Every ray walk over MapData (walls, the 2D view, MapData::LineSearchDDA, LevelVisibility) steps through here, Scalar picks float or fixed point lengths
+template <typename Scalar>
+struct GridDDA
+{
+	using Length = typename Scalar::Length;
+
+	Vector2i mapCheck;		// tile the ray is currently in
+	Vector2i step;			// direction to the next tile along each axis (-1 or 1)
+	Length distance{ 0 };	// length of ray travelled to enter mapCheck
+
+	// direction must be normalised
+	void Begin(const Vector2f& start, const Vector2f& direction)
+	{
+		mapCheck = start.ToInt(); // truncation will 'snap' position to tile
+		Restart(start, direction);
+	}
+
+	// Carries on from start (inside or on the edge of mapCheck) in a new direction, ie. after reflecting off a mirror. distance begins again from 0.
+	void Restart(const Vector2f& start, const Vector2f& direction)
+	{
+		// length required to travel 1 X/Y unit in ray direction (for a normalised direction this is sqrt(1 + (y/x)^2) without the sqrt)
+		const float unitStepX = 1.f / std::abs(direction.x);
+		const float unitStepY = 1.f / std::abs(direction.y);
+		m_unitStepX = Scalar::FromFloat(unitStepX);
+		m_unitStepY = Scalar::FromFloat(unitStepY);
+
+		// length of ray needed to reach the first edge along each axis. Example: start.x of 7.33 heading left is 33% of a unit step from the left edge
+		if (direction.x < 0)
+		{
+			step.x = -1;
+			m_rayLengthX = Scalar::FromFloat((start.x - static_cast<float>(mapCheck.x)) * unitStepX);
+		}
+		else
+		{
+			step.x = 1;
+			m_rayLengthX = Scalar::FromFloat((static_cast<float>(mapCheck.x + 1) - start.x) * unitStepX);
+		}
+		if (direction.y < 0)
+		{
+			step.y = -1;
+			m_rayLengthY = Scalar::FromFloat((start.y - static_cast<float>(mapCheck.y)) * unitStepY);
+		}
+		else
+		{
+			step.y = 1;
+			m_rayLengthY = Scalar::FromFloat((static_cast<float>(mapCheck.y + 1) - start.y) * unitStepY);
+		}
+		distance = 0;
+	}
+
+	// Moves into the next tile along the ray. Returns true if it stepped along X (crossing a vertical tile edge), false if along Y.
+	bool Step()
+	{
+		if (m_rayLengthX < m_rayLengthY)
+		{
+			mapCheck.x += step.x;
+			distance = m_rayLengthX;
+			m_rayLengthX += m_unitStepX;
+			return true;
+		}
+		mapCheck.y += step.y;
+		distance = m_rayLengthY;
+		m_rayLengthY += m_unitStepY;
+		return false;
+	}
+
+	float Distance() const { return Scalar::ToFloat(distance); }
+
+	// For comparing against distance inside loops without converting it back to float every step
+	static Length ToLength(float value) { return Scalar::FromFloat(value); }
+
+private:
+	Length m_unitStepX;
+	Length m_unitStepY;
+	Length m_rayLengthX; // total length of ray: via x units, via y units
+	Length m_rayLengthY;
+};
@@ -1,5 +1,6 @@
 #include "LevelData.h"
 #include <Collision/CollisionComponent2D.h>
+#include <algorithm>
 
 const int MapData::TotalNodes() const
 {
@@ -15,49 +16,165 @@ const GridNode* MapData::GetNode(int x, int y) const
 {
 	if (x >= 0 && x < gridWidth && y >= 0 && y < gridHeight)
 	{
-		return &pNodes[x + (y * gridWidth)];
+		return &pNodes[NodeIndex(x, y)];
 	}
 	return nullptr;
 }
 
-Vector2i MapData::GetExitTileForConjoinedPortal(Vector2i entryTile, bool bScanY) const
+const u8* MapData::GetTileFlags(Vector2i index) const
 {
-	// If multiple MirrorPortalConjoined are touching, combine them into a single inverted mirror so the image isn't split up
-	int portalLength = 0;
-	int entryTilePosition = 0;
-	Vector2i nextConjoinedPortalStep = bScanY ? Vector2i(0, 1) : Vector2i(1, 0);
-								
-	// Discover how big this conjoined portal is, and where the tile our ray has hit lies within it
-	Vector2i mapCheck = entryTile;
-	mapCheck -= nextConjoinedPortalStep;
-	while (const GridNode* portalNode = GetNode(mapCheck))
-	{
-		if (portalNode->specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
-		{
-			entryTilePosition++;
-			mapCheck -= nextConjoinedPortalStep;
-		}
-		else break;
+	if (index.x >= 0 && index.x < gridWidth && index.y >= 0 && index.y < gridHeight)
+	{
+		return &pTileFlags[NodeIndex(index.x, index.y)];
 	}
-	portalLength += entryTilePosition;
-	mapCheck = entryTile;
-	mapCheck += nextConjoinedPortalStep;
-	while (const GridNode* portalNode = GetNode(mapCheck))
+	return nullptr;
+}
+
+void MapData::Allocate(int width, int height)
+{
+	ASSERT(width > 0 && width <= MAP_WIDTH_MAX_SUPPORTED && height > 0 && height <= MAP_HEIGHT_MAX_SUPPORTED);
+	gridWidth = width;
+	gridHeight = height;
+	chunksX = (width + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT;
+	chunksY = (height + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT;
+
+	// Every chunk starts out sharing the empty chunk in slot 0
+	chunkSlots.assign(chunksX * chunksY, 0);
+	chunkNodes.assign(MAP_CHUNK_NODES, GridNode());
+	chunkTileFlags.assign(MAP_CHUNK_NODES, u8(TILE_EMPTY));
+	residentChunks = 1;
+	mappedLevel.Close();
+
+	pChunkSlots = chunkSlots.data();
+	pNodes = chunkNodes.data();
+	pTileFlags = chunkTileFlags.data();
+	portalExits.assign(MAP_CHUNK_NODES * 2, 0);
+}
+
+void MapData::AttachChunks(int width, int height, int chunkCount, const int* slots, GridNode* nodes, u8* tileFlags)
+{
+	ASSERT(width > 0 && width <= MAP_WIDTH_MAX_SUPPORTED && height > 0 && height <= MAP_HEIGHT_MAX_SUPPORTED && chunkCount > 0);
+	gridWidth = width;
+	gridHeight = height;
+	chunksX = (width + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT;
+	chunksY = (height + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT;
+	residentChunks = chunkCount;
+
+	chunkSlots.clear();
+	chunkNodes.clear();
+	chunkTileFlags.clear();
+
+	pChunkSlots = slots;
+	pNodes = nodes;
+	pTileFlags = tileFlags;
+
+	// Exits aren't stored alongside the tile flags, resolve them now so lookups are ready as soon as the map is
+	RebuildPortalExits();
+}
+
+GridNode& MapData::EditNode(int x, int y)
+{
+	ASSERT(x >= 0 && x < gridWidth && y >= 0 && y < gridHeight);
+	if (chunkNodes.empty())
 	{
-		if (portalNode->specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
+		// Arena is attached from elsewhere, take a copy of our own before growing it
+		chunkSlots.assign(pChunkSlots, pChunkSlots + (chunksX * chunksY));
+		chunkNodes.assign(pNodes, pNodes + ResidentNodes());
+		chunkTileFlags.assign(pTileFlags, pTileFlags + ResidentNodes());
+		pChunkSlots = chunkSlots.data();
+		pNodes = chunkNodes.data();
+		pTileFlags = chunkTileFlags.data();
+	}
+
+	int& slot = chunkSlots[(x >> MAP_CHUNK_SHIFT) + ((y >> MAP_CHUNK_SHIFT) * chunksX)];
+	if (slot == 0)
+	{
+		slot = residentChunks++;
+		chunkNodes.resize(chunkNodes.size() + MAP_CHUNK_NODES);
+		chunkTileFlags.resize(chunkTileFlags.size() + MAP_CHUNK_NODES, u8(TILE_EMPTY));
+		portalExits.resize(chunkTileFlags.size() * 2, 0);
+		pNodes = chunkNodes.data();
+		pTileFlags = chunkTileFlags.data();
+	}
+	return pNodes[NodeIndex(x, y)];
+}
+
+void MapData::RebuildTileFlags()
+{
+	for (int i = 0; i < ResidentNodes(); i++)
+	{
+		pTileFlags[i] = pNodes[i].CalculateTileFlags();
+	}
+	RebuildPortalExits();
+}
+
+void MapData::RebuildPortalExits()
+{
+	portalExits.assign(ResidentNodes() * 2, 0);
+
+	// Only resident chunks can hold portals (the shared empty chunk is slot 0). Resolve each run once, from its first tile.
+	for (int chunkY = 0; chunkY < chunksY; chunkY++)
+	{
+		for (int chunkX = 0; chunkX < chunksX; chunkX++)
 		{
-			portalLength++;
-			mapCheck += nextConjoinedPortalStep;
+			if (pChunkSlots[chunkX + (chunkY * chunksX)] == 0)
+			{
+				continue;
+			}
+
+			const int xEnd = std::min((chunkX + 1) * MAP_CHUNK_SIZE, gridWidth);
+			const int yEnd = std::min((chunkY + 1) * MAP_CHUNK_SIZE, gridHeight);
+			for (int y = chunkY * MAP_CHUNK_SIZE; y < yEnd; y++)
+			{
+				for (int x = chunkX * MAP_CHUNK_SIZE; x < xEnd; x++)
+				{
+					if (!(pTileFlags[NodeIndex(x, y)] & TILE_PORTAL_CONJOINED))
+					{
+						continue;
+					}
+					if (x == 0 || !(pTileFlags[NodeIndex(x - 1, y)] & TILE_PORTAL_CONJOINED))
+					{
+						ResolvePortalExits(x, y, false);
+					}
+					if (y == 0 || !(pTileFlags[NodeIndex(x, y - 1)] & TILE_PORTAL_CONJOINED))
+					{
+						ResolvePortalExits(x, y, true);
+					}
+				}
+			}
 		}
-		else break;
 	}
-	
-	// portalLength tells us how many portals are touching which we should consider a single mirror
-	// entryTilePosition tells us the index into those portals of the entryTile, we use this to invert the exit: if we entered at position 0/5, we would exit at position 5/5. 1/5 -> 4/5, etc.
-	int portalOutPosition = portalLength - entryTilePosition;
-	mapCheck = entryTile;
-	bScanY ? mapCheck.y = (mapCheck.y - entryTilePosition) + portalOutPosition : mapCheck.x = (mapCheck.x - entryTilePosition) + portalOutPosition;
-	return mapCheck;
+}
+
+void MapData::ResolvePortalExits(int x, int y, bool bScanY)
+{
+	// If multiple MirrorPortalConjoined are touching, combine them into a single inverted mirror so the image isn't split up
+	auto IsConjoined = [this](int tileX, int tileY)
+	{
+		const u8* portalFlags = GetTileFlags(Vector2i(tileX, tileY));
+		return portalFlags && (*portalFlags & TILE_PORTAL_CONJOINED);
+	};
+	const int stepX = bScanY ? 0 : 1;
+	const int stepY = bScanY ? 1 : 0;
+
+	// Discover how big this conjoined portal is
+	while (IsConjoined(x - stepX, y - stepY))
+	{
+		x -= stepX;
+		y -= stepY;
+	}
+	int portalLength = 1;
+	while (IsConjoined(x + (stepX * portalLength), y + (stepY * portalLength)))
+	{
+		portalLength++;
+	}
+
+	// Invert the exit along the run: if we entered at position 0/5, we would exit at position 5/5. 1/5 -> 4/5, etc.
+	for (int position = 0; position < portalLength; position++)
+	{
+		const Vector2i tile(x + (stepX * position), y + (stepY * position));
+		portalExits[(NodeIndex(tile.x, tile.y) * 2) + (bScanY ? 1 : 0)] = static_cast<s16>((portalLength - 1) - (2 * position));
+	}
 }
 
 Vector2f MapData::PreCheckedMovement(const Vector2f& start, const Vector2f& trajectory, CollisionComponent2D* collisionComp, float& outRotationOffset) const
@@ -83,24 +200,33 @@ Vector2f MapData::PreCheckedMovement(const Vector2f& start, const Vector2f& traj
 	bool bCrossedPortal;
 	do
 	{
+		// Broadphase: if every trace stays within a tile of curPosition, they can't leave its visibility region's border, so skip traces for flags that region doesn't contain
+		u8 nearbyFlags = TILE_COLLISION | TILE_ANY_PORTAL;
+		if (std::abs(traceTrajectory.x) + std::abs(traceTrajectory.y) + AABBHalfX.x + AABBHalfY.y < 1.f)
+		{
+			nearbyFlags = visibility.GetLocalTileFlags(visibility.GetRegionIndex(curPosition.ToInt()));
+		}
+
 		// Find the position our AABB is able to reach.
 		Vector2f trajectoryX = Vector2f(traceTrajectory.x + (Sign(traceTrajectory.x) * AABBHalfX.x), 0.f);
-		if (!LineSearchDDA(curPosition + AABBHalfY, curPosition + AABBHalfY + trajectoryX, collisionPredicate)
-		&& !LineSearchDDA(curPosition - AABBHalfY, curPosition - AABBHalfY + trajectoryX, collisionPredicate))
+		if (!(nearbyFlags & TILE_COLLISION)
+		|| (!LineSearchDDA(curPosition + AABBHalfY, curPosition + AABBHalfY + trajectoryX, TILE_COLLISION, collisionPredicate)
+		&& !LineSearchDDA(curPosition - AABBHalfY, curPosition - AABBHalfY + trajectoryX, TILE_COLLISION, collisionPredicate)))
 		{
 			nextPosition.x += traceTrajectory.x;
 		}
 		
 		Vector2f trajectoryY = Vector2f(0.f, traceTrajectory.y + (Sign(traceTrajectory.y) * AABBHalfY.y));
-		if (!LineSearchDDA(curPosition + AABBHalfX, curPosition + AABBHalfX + trajectoryY, collisionPredicate)
-		&& !LineSearchDDA(curPosition - AABBHalfX, curPosition - AABBHalfX + trajectoryY, collisionPredicate))
+		if (!(nearbyFlags & TILE_COLLISION)
+		|| (!LineSearchDDA(curPosition + AABBHalfX, curPosition + AABBHalfX + trajectoryY, TILE_COLLISION, collisionPredicate)
+		&& !LineSearchDDA(curPosition - AABBHalfX, curPosition - AABBHalfX + trajectoryY, TILE_COLLISION, collisionPredicate)))
 		{
 			nextPosition.y += traceTrajectory.y;
 		}
 	
 		// Trace center-of-AABB until destination to check if it crossed a portal threshold.
 		bCrossedPortal = false;
-		if (LineSearchDDA(curPosition, nextPosition, portalPredicate, &search))
+		if ((nearbyFlags & TILE_ANY_PORTAL) && LineSearchDDA(curPosition, nextPosition, TILE_ANY_PORTAL, portalPredicate, &search))
 		{
 			bCrossedPortal = true;
 			
@@ -147,6 +273,46 @@ void GridNode::Reset()
 	collisionMask = 0;
 }
 
+bool GridNode::IsEmpty() const
+{
+	static const GridNode emptyNode;
+	return texIdRoof[0] == emptyNode.texIdRoof[0]
+		&& texIdRoof[1] == emptyNode.texIdRoof[1]
+		&& texIdWall == emptyNode.texIdWall
+		&& texIdFloor[0] == emptyNode.texIdFloor[0]
+		&& texIdFloor[1] == emptyNode.texIdFloor[1]
+		&& drawFlags == emptyNode.drawFlags
+		&& extendUp == emptyNode.extendUp
+		&& extendDown == emptyNode.extendDown
+		&& collisionMask == emptyNode.collisionMask
+		&& specialFlag == emptyNode.specialFlag;
+}
+
+u8 GridNode::CalculateTileFlags() const
+{
+	u8 flags = TILE_EMPTY;
+	if (texIdWall != TEX_NONE || (extendUp && texIdRoof[0] != TEX_NONE) || (extendDown && texIdFloor[0] != TEX_NONE))
+	{
+		flags |= TILE_WALL;
+	}
+	if (texIdWall != TEX_NONE)
+	{
+		flags |= TILE_WALL_TEXTURE;
+	}
+	switch (specialFlag)
+	{
+	case SPECIAL_MIRROR: flags |= TILE_MIRROR; break;
+	case SPECIAL_MIRROR_PORTAL: flags |= TILE_PORTAL; break;
+	case SPECIAL_MIRROR_PORTAL_CONJOINED: flags |= TILE_PORTAL_CONJOINED; break;
+	default: break;
+	}
+	if (collisionMask)
+	{
+		flags |= TILE_COLLISION;
+	}
+	return flags;
+}
+
 bool GridNode::CompareNodeByTexture(const GridNode& other)
 {
 	return texIdWall == other.texIdWall
@@ -158,6 +324,22 @@ bool GridNode::CompareNodeByTexture(const GridNode& other)
 
 void EditorMapData::SetSize(int width, int height)
 {
-	gridWidth = std::max(3, width); 
-	gridHeight = std::max(3, height);
+	gridWidth = std::clamp(width, 3, MAP_WIDTH_MAX_SUPPORTED);
+	gridHeight = std::clamp(height, 3, MAP_HEIGHT_MAX_SUPPORTED);
+	if (gridWidth <= storageWidth && gridHeight <= storageHeight)
+	{
+		return;
+	}
+
+	// Grow storage, keeping existing nodes at their coordinates
+	const int newStorageWidth = std::max(gridWidth, storageWidth);
+	const int newStorageHeight = std::max(gridHeight, storageHeight);
+	std::vector<GridNode> newNodes(newStorageWidth * newStorageHeight);
+	for (int y = 0; y < storageHeight; y++)
+	{
+		std::copy(gridNodes.begin() + (y * storageWidth), gridNodes.begin() + ((y + 1) * storageWidth), newNodes.begin() + (y * newStorageWidth));
+	}
+	gridNodes = std::move(newNodes);
+	storageWidth = newStorageWidth;
+	storageHeight = newStorageHeight;
 }
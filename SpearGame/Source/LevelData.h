@@ -1,9 +1,20 @@
 #pragma once
 #include "Core/Core.h"
+#include "Core/MappedFile.h"
+#include "GridDDA.h"
+#include "LevelVisibility.h"
 #include <filesystem>
+#include <vector>
 
-constexpr int MAP_WIDTH_MAX_SUPPORTED{ 40 };
-constexpr int MAP_HEIGHT_MAX_SUPPORTED{ 40 };
+constexpr int MAP_WIDTH_MAX_SUPPORTED{ 1024 };
+constexpr int MAP_HEIGHT_MAX_SUPPORTED{ 1024 };
+
+// CAUTION - CHANGES MADE TO THESE MUST BE REFLECTED IN RAYCASTER COMPUTE SHADER FILES
+// MapData stores tiles in square chunks, only allocating chunks which contain something
+constexpr int MAP_CHUNK_SHIFT{ 4 };
+constexpr int MAP_CHUNK_SIZE{ 1 << MAP_CHUNK_SHIFT }; // chunk width/height in tiles
+constexpr int MAP_CHUNK_MASK{ MAP_CHUNK_SIZE - 1 };
+constexpr int MAP_CHUNK_NODES{ MAP_CHUNK_SIZE * MAP_CHUNK_SIZE };
 
 class CollisionComponent2D;
 
@@ -36,6 +47,22 @@ enum eSpecialMapFlags : u8
 	SPECIAL_TOTAL
 };
 
+enum eTileFlags : u8
+{
+	// CAUTION - CHANGES MADE TO THESE FLAGS MUST BE REFLECTED IN RAYCASTER COMPUTE SHADER FILES
+	TILE_EMPTY = 0,
+
+	TILE_WALL = 1 << 0,					// tile has visible wall geometry (wall texture, or extended roof/floor)
+	TILE_WALL_TEXTURE = 1 << 1,			// tile has texIdWall assigned
+	TILE_MIRROR = 1 << 2,
+	TILE_PORTAL = 1 << 3,
+	TILE_PORTAL_CONJOINED = 1 << 4,
+	TILE_COLLISION = 1 << 5,			// tile has a non-zero collisionMask
+
+	TILE_ANY_PORTAL = TILE_PORTAL | TILE_PORTAL_CONJOINED,
+	TILE_ANY_MIRROR = TILE_MIRROR | TILE_ANY_PORTAL,
+};
+
 enum ePlaneHeight : u8
 {
 	PLANE_HEIGHT_OUTER,
@@ -60,6 +87,12 @@ struct GridNode
 
 	void Reset();
 
+	// Returns true if node matches a default constructed GridNode (nothing to draw or collide with)
+	bool IsEmpty() const;
+
+	// Summarises this node as eTileFlags for MapData::pTileFlags
+	u8 CalculateTileFlags() const;
+
 	// Returns true if textures assigned to each node match
 	bool CompareNodeByTexture(const GridNode& other);
 };
@@ -83,13 +116,16 @@ struct MapDataBase
 
 struct EditorMapData : public MapDataBase
 {
-	EditorMapData(const char* name) : MapDataBase(name) {}
+	EditorMapData(const char* name) : MapDataBase(name) { SetSize(gridWidth, gridHeight); }
 
+	// Storage only ever grows, so tiles cut off by shrinking the map reappear if it's enlarged again
 	void SetSize(int width, int height);
-	GridNode& GetNode(int x, int y) { ASSERT(x < gridWidth && y < gridHeight && x >= 0 && y >= 0); return gridNodes[x + (y * MAP_WIDTH_MAX_SUPPORTED)]; }
+	GridNode& GetNode(int x, int y) { ASSERT(x < gridWidth && y < gridHeight && x >= 0 && y >= 0); return gridNodes[x + (y * storageWidth)]; }
 	GridNode& GetNode(const Vector2i& pos) { return GetNode(pos.x, pos.y); }
 
-	GridNode gridNodes[MAP_WIDTH_MAX_SUPPORTED * MAP_HEIGHT_MAX_SUPPORTED];
+	std::vector<GridNode> gridNodes;
+	int storageWidth{ 0 };
+	int storageHeight{ 0 };
 };
 
 
@@ -104,19 +140,110 @@ struct LineSearchData
 
 struct MapData : public MapDataBase
 {
+	// Tiles in the grid (gridWidth * gridHeight)
 	const int TotalNodes() const;
+
+	// Nodes actually stored in pNodes/pTileFlags: the shared empty chunk plus every resident chunk
+	int ResidentNodes() const { return residentChunks * MAP_CHUNK_NODES; }
+
 	const GridNode* GetNode(Vector2i index) const;
 	const GridNode* GetNode(int x, int y) const;
-	Vector2i GetExitTileForConjoinedPortal(Vector2i entryTile, bool bScanY) const;
+	const u8* GetTileFlags(Vector2i index) const;
+	Vector2i GetExitTileForConjoinedPortal(Vector2i entryTile, bool bScanY) const
+	{
+		const int offset = portalExits[(NodeIndex(entryTile.x, entryTile.y) * 2) + (bScanY ? 1 : 0)];
+		return bScanY ? Vector2i(entryTile.x, entryTile.y + offset) : Vector2i(entryTile.x + offset, entryTile.y);
+	}
+
+	// Index into pNodes/pTileFlags for a tile inside the grid
+	int NodeIndex(int x, int y) const
+	{
+		return (pChunkSlots[(x >> MAP_CHUNK_SHIFT) + ((y >> MAP_CHUNK_SHIFT) * chunksX)] * MAP_CHUNK_NODES) + (x & MAP_CHUNK_MASK) + ((y & MAP_CHUNK_MASK) << MAP_CHUNK_SHIFT);
+	}
+
+	// Caches the chunk a DDA is currently walking through, so steps which stay inside it skip the chunk table
+	struct ChunkCursor
+	{
+		int NodeIndex(const MapData& map, int x, int y)
+		{
+			const int cx = x >> MAP_CHUNK_SHIFT;
+			const int cy = y >> MAP_CHUNK_SHIFT;
+			if (cx != chunkX || cy != chunkY)
+			{
+				chunkX = cx;
+				chunkY = cy;
+				chunkBase = map.pChunkSlots[cx + (cy * map.chunksX)] * MAP_CHUNK_NODES;
+			}
+			return chunkBase + (x & MAP_CHUNK_MASK) + ((y & MAP_CHUNK_MASK) << MAP_CHUNK_SHIFT);
+		}
+
+		int chunkX{ -1 };
+		int chunkY{ -1 };
+		int chunkBase{ 0 };
+	};
 
 	Vector2f PreCheckedMovement(const Vector2f& start, const Vector2f& trajectory, CollisionComponent2D* collisionComp, float& outRotationOffset) const;
 	Vector2f PreCheckedMovement(const Vector2f& start, const Vector2f& traceTrajectory, const Vector2f& AABB, u8 collisionMask, float& outRotationOffset) const;
+
+	// Resizes the grid with every tile empty, releasing all resident chunks
+	void Allocate(int width, int height);
+
+	// Returns a writable node, first giving its chunk storage of its own if it still shares the empty chunk
+	// May move pNodes/pTileFlags. Call RebuildTileFlags once finished writing.
+	GridNode& EditNode(int x, int y);
+
+	// Uses a chunk arena stored elsewhere in place (eg. within mappedLevel), laid out exactly as Allocate/EditNode would leave it
+	// Storage must outlive the map, or until the next Allocate. EditNode copies it into the map's own storage first.
+	void AttachChunks(int width, int height, int chunkCount, const int* slots, GridNode* nodes, u8* tileFlags);
+	
+	// Regenerates pTileFlags (and the conjoined portal exits resolved from them) from pNodes. Must be called whenever pNodes is modified.
+	void RebuildTileFlags();
+
+	// Resolves portalExits for every conjoined portal from pTileFlags (called by RebuildTileFlags and AttachChunks)
+	void RebuildPortalExits();
+
+	// Resolves portalExits for the run of touching conjoined portals which tile (x, y) is part of, along one axis
+	void ResolvePortalExits(int x, int y, bool bScanY);
+
+	// Chunk arena: chunkSlots maps each chunk (row-major, chunksX per row) to its slot in chunkNodes/chunkTileFlags
+	// Slot 0 is a shared, always empty chunk used by every chunk with nothing in it, and must never be written
+	// Vectors are left empty while the arena is attached from elsewhere (see AttachChunks)
+	int chunksX{ 0 };
+	int chunksY{ 0 };
+	int residentChunks{ 0 }; // including the empty chunk
+	std::vector<int> chunkSlots;
+	std::vector<GridNode> chunkNodes;
+	std::vector<u8> chunkTileFlags;
 	
+	// Views of the chunk arena for hot loops, indexed by NodeIndex (NOT x + y * gridWidth)
+	const int* pChunkSlots{nullptr};
 	GridNode* pNodes{nullptr};
+
+	// Compact 1-byte-per-tile eTileFlags plane, indexed identically to pNodes
+	// DDA loops test this first so the full GridNode is only fetched for tiles which might actually be hit
+	u8* pTileFlags{nullptr};
+
+	// Exit of every conjoined portal tile as an offset from it along the scanned axis, indexed by (NodeIndex * 2) + bScanY
+	// Resolved from pTileFlags whenever they change, so GetExitTileForConjoinedPortal never has to walk the portal's neighbours
+	std::vector<s16> portalExits;
+
+	// Binary level the chunk arena is attached from, if it was loaded from one (see LevelFileManager::LoadLevel)
+	Spear::MappedFile mappedLevel;
+
+	// Where LevelFileManager::SpawnLevelObjects reads this level's GameObjects from
+	std::string objectsFilePath;
+	u64 objectsOffset{ 0 };
+	bool bObjectsInBinaryLevel{ false };
+
+	// Region potentially-visible-set, traced from pTileFlags a region at a time as the camera needs them (see LevelVisibility::PrefetchRegionsAround)
+	// Declared last so it's destroyed first, waiting for any background traces before the tiles they read go
+	LevelVisibility visibility;
 	
 	// Returns true if tile is encountered for which predicate returns true while performing DDA traversal. Returns false if end is reached with no encounter.
-	template <typename Predicate>
-	bool LineSearchDDA(const Vector2f& start, const Vector2f& end, Predicate predicate, LineSearchData* outSearchData = nullptr) const
+	// Only tiles whose eTileFlags overlap candidateFlags are passed to predicate, all other tiles are skipped without reading their GridNode.
+	// Scalar picks the GridDDA length type (DDAFloat or DDAFixed).
+	template <typename Scalar = DDAFloat, typename Predicate>
+	bool LineSearchDDA(const Vector2f& start, const Vector2f& end, u8 candidateFlags, Predicate predicate, LineSearchData* outSearchData = nullptr) const
 	{
 		const Vector2f trajectory = end - start;
 		const float distanceLimit{ trajectory.Length() };
@@ -126,77 +253,43 @@ struct MapData : public MapDataBase
 		}
 		
 		const Vector2f direction = Normalize(trajectory);
-		const Vector2f stepSize{sqrt(1 + (direction.y / direction.x) * (direction.y / direction.x)),	// length required to travel 1 X unit in Ray Direction
-							sqrt(1 + (direction.x / direction.y) * (direction.x / direction.y)) };	// length required to travel 1 Y unit in Ray Direction
+		GridDDA<Scalar> dda;
+		dda.Begin(start, direction);
+		const typename Scalar::Length ddaDistanceLimit = dda.ToLength(distanceLimit);
 
-		Vector2i mapCheck = start.ToInt(); // truncation will 'snap' position to tile
-		Vector2f testProgression; // tracks accumulating length of 'test' ray: via x units, via y units
-
-		// 1. Calculate initial direction/distance values
-		Vector2i step;
-		if (direction.x < 0)
-		{
-			step.x = -1;
-			testProgression.x = (start.x - static_cast<float>(mapCheck.x)) * stepSize.x;
-		}
-		else
-		{
-			step.x = 1;
-			testProgression.x = (static_cast<float>(mapCheck.x + 1) - start.x) * stepSize.x;
-
-		}
-		if (direction.y < 0)
-		{
-			step.y = -1;
-			testProgression.y = (start.y - static_cast<float>(mapCheck.y)) * stepSize.y;
-		}
-		else
-		{
-			step.y = 1;
-			testProgression.y = (static_cast<float>(mapCheck.y + 1) - start.y) * stepSize.y;
-		}
-
-		// 2. Search step-by-step for a collision
+		// Search step-by-step for a collision
+		ChunkCursor cursor;
 		while (true)
 		{
-			bool bVerticalHit;
-			float distance{ 0.f };
-			if (testProgression.x < testProgression.y)
-			{
-				// X distance is currently shortest, increase X
-				mapCheck.x += step.x;
-				distance = testProgression.x;
-				testProgression.x += stepSize.x; // increase ray by 1 X unit
-				bVerticalHit = false;
-			}
-			else
-			{
-				// Y distance is currently shortest, increase Y
-				mapCheck.y += step.y;
-				distance = testProgression.y;
-				testProgression.y += stepSize.y; // increase ray by 1 Y unit
-				bVerticalHit = true;
-			}
+			const bool bVerticalHit = !dda.Step();
 
 			// If we've reached our distance limit without finding a collision, then ray does not collide. This also means outPercentComplete is always less than 1.f if we return a hit.
-			if (distance >= distanceLimit)
+			if (dda.distance >= ddaDistanceLimit)
 			{
 				return false;
 			}
 
 			// Check position is within range of array
-			if (const GridNode* node = GetNode(mapCheck))
-			{				
+			const Vector2i& mapCheck = dda.mapCheck;
+			if (mapCheck.x >= 0 && mapCheck.x < gridWidth && mapCheck.y >= 0 && mapCheck.y < gridHeight)
+			{
+				const int nodeIndex = cursor.NodeIndex(*this, mapCheck.x, mapCheck.y);
+				if (!(pTileFlags[nodeIndex] & candidateFlags))
+				{
+					continue;
+				}
+
 				// Compare node using predicate function supplied by caller
+				const GridNode* node = &pNodes[nodeIndex];
 				if (predicate(*node))
 				{
 					if (outSearchData)
 					{						
 						outSearchData->bVerticalHit = bVerticalHit;
-						outSearchData->hitPos = start + (direction * distance);
+						outSearchData->hitPos = start + (direction * dda.Distance());
 						outSearchData->tile = mapCheck;
 						outSearchData->node = node;
-						outSearchData->percentComplete = distance / distanceLimit;
+						outSearchData->percentComplete = dda.Distance() / distanceLimit;
 					}
 					return true;
 				}
@@ -2,10 +2,12 @@
 #include "GameObject/GameObject.h"
 #include "Collision/CollisionSystem.h"
 #include <GameObject/OBoxCollider.h>
+#include "Raycaster/Raycaster.h"
+#include "Raycaster/RaycasterConfig.h"
+#include <algorithm>
 
 std::string GetFilePath(const char* levelName) {return std::string("../Assets/MAPS/") + std::string(levelName); };
-
-char LevelFileManager::m_reservedMapMemory[MAP_RESERVED_BYTES];
+std::filesystem::path GetBinaryFilePath(const std::string& levelPath) {return std::filesystem::path(levelPath).replace_extension(".levelbin"); };
 
 void LevelFileManager::EditorSaveLevel(const EditorMapData& rMapData)
 {
@@ -23,7 +25,7 @@ void LevelFileManager::EditorSaveLevel(const EditorMapData& rMapData)
 	{
 		for (int y = 0; y < rMapData.gridHeight; y++)
 		{
-			const GridNode& node = rMapData.gridNodes[(y * MAP_WIDTH_MAX_SUPPORTED) + x];
+			const GridNode& node = rMapData.gridNodes[(y * rMapData.storageWidth) + x];
 			Serialize(node, file);
 		}
 	}
@@ -47,6 +49,13 @@ void LevelFileManager::EditorSaveLevel(const EditorMapData& rMapData)
 
 	// 'Other' settings
 	file << rMapData.darkness << std::endl;
+	file.close();
+
+	// Keep the binary counterpart in step, otherwise LoadLevel would keep using the stale one
+	if (!WriteBinaryLevel(rMapData, GetFilePath(rMapData.mapName.c_str()) + ".level"))
+	{
+		LOG("Failed to write binary level for " << rMapData.mapName);
+	}
 }
 
 void LevelFileManager::EditorLoadLevel(const char* levelName, EditorMapData& rMapData)
@@ -57,8 +66,7 @@ void LevelFileManager::EditorLoadLevel(const char* levelName, EditorMapData& rMa
 	std::string width, height;
 	std::getline(file, width);
 	std::getline(file, height);
-	rMapData.gridWidth = std::stoi(width);
-	rMapData.gridHeight = std::stoi(height);
+	rMapData.SetSize(std::stoi(width), std::stoi(height));
 
 	// Read PlayerStart
 	Deserialize(rMapData.playerStart, file);
@@ -68,7 +76,7 @@ void LevelFileManager::EditorLoadLevel(const char* levelName, EditorMapData& rMa
 	{
 		for (int y = 0; y < rMapData.gridHeight; y++)
 		{
-			GridNode& node = rMapData.gridNodes[(y * MAP_WIDTH_MAX_SUPPORTED) + x];
+			GridNode& node = rMapData.GetNode(x, y);
 			Deserialize(node, file);
 		}
 	}
@@ -100,37 +108,192 @@ void LevelFileManager::EditorLoadLevel(const char* levelName, EditorMapData& rMa
 	rMapData.darkness = std::stoi(temp);
 }
 
-void LevelFileManager::LoadLevel(const char* levelName, MapData& rMapData)
+bool LevelFileManager::ConvertLevelToBinary(const char* levelName)
+{
+	EditorMapData mapData(levelName);
+	EditorLoadLevel(levelName, mapData);
+	const bool bWritten = WriteBinaryLevel(mapData, GetFilePath(levelName));
+	GameObject::GlobalDestroy();
+	return bWritten;
+}
+
+bool LevelFileManager::WriteBinaryLevel(const EditorMapData& rMapData, const std::string& levelPath)
+{
+	// Lay the grid out in chunks exactly as LoadLevel would have built them
+	MapData chunked;
+	chunked.Allocate(rMapData.gridWidth, rMapData.gridHeight);
+	for (int x = 0; x < rMapData.gridWidth; x++)
+	{
+		for (int y = 0; y < rMapData.gridHeight; y++)
+		{
+			const GridNode& node = rMapData.gridNodes[(y * rMapData.storageWidth) + x];
+			if (!node.IsEmpty())
+			{
+				chunked.EditNode(x, y) = node;
+			}
+		}
+	}
+	chunked.RebuildTileFlags();
+
+	std::string strings;
+	auto AddString = [&strings](const std::string& string)
+	{
+		const u32 offset = static_cast<u32>(strings.size());
+		strings.append(string);
+		strings.push_back('\0');
+		return offset;
+	};
+
+	BinaryLevelHeader header{};
+	header.magic = BINARY_LEVEL_MAGIC;
+	header.version = BINARY_LEVEL_VERSION;
+	header.gridNodeSize = sizeof(GridNode);
+	header.gridWidth = chunked.gridWidth;
+	header.gridHeight = chunked.gridHeight;
+	header.residentChunks = chunked.residentChunks;
+	header.playerStartX = rMapData.playerStart.x;
+	header.playerStartY = rMapData.playerStart.y;
+	for (int i = 0; i < PLANE_HEIGHTS_TOTAL; i++)
+	{
+		header.planeHeights[i] = rMapData.planeHeights[i];
+	}
+	header.darkness = rMapData.darkness;
+	header.mapNameString = AddString(rMapData.mapName);
+	header.tileDirectoryString = AddString(rMapData.tileDirectory.path().string());
+	header.spriteDirectoryString = AddString(rMapData.spriteDirectory.path().string());
+
+	std::ofstream file(GetBinaryFilePath(levelPath), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	auto WriteBlock = [&file](const void* data, u64 size)
+	{
+		static const char padding[BINARY_LEVEL_ALIGNMENT]{};
+		const u64 offset = static_cast<u64>(file.tellp());
+		const u64 alignedOffset = (offset + BINARY_LEVEL_ALIGNMENT - 1) & ~(BINARY_LEVEL_ALIGNMENT - 1);
+		file.write(padding, alignedOffset - offset);
+		file.write(static_cast<const char*>(data), size);
+		return alignedOffset;
+	};
+
+	// Header is rewritten once block offsets are known
+	Serialize(header, file);
+	header.chunkSlotsOffset = WriteBlock(chunked.pChunkSlots, chunked.chunksX * chunked.chunksY * sizeof(int));
+	header.chunkNodesOffset = WriteBlock(chunked.pNodes, chunked.ResidentNodes() * sizeof(GridNode));
+	header.tileFlagsOffset = WriteBlock(chunked.pTileFlags, chunked.ResidentNodes() * sizeof(u8));
+	header.objectsOffset = WriteBlock(nullptr, 0);
+	GameObject::GlobalSerialize(file);
+	header.objectsSize = static_cast<u64>(file.tellp()) - header.objectsOffset;
+	header.stringsOffset = WriteBlock(strings.data(), strings.size());
+	header.stringsSize = strings.size();
+
+	file.seekp(0);
+	Serialize(header, file);
+	return file.good();
+}
+
+bool LevelFileManager::LoadBinaryLevel(const char* levelName, MapData& rMapData)
 {
-	// Wipe any and all reserved memory to 0
-	std::fill(std::begin(m_reservedMapMemory), std::end(m_reservedMapMemory), '\0');
+	// Binary level is only trusted if the text level hasn't been saved since (or no longer exists)
+	const std::string levelPath = GetFilePath(levelName);
+	const std::filesystem::path binaryPath = GetBinaryFilePath(levelPath);
+	std::error_code error;
+	const std::filesystem::file_time_type binaryTime = std::filesystem::last_write_time(binaryPath, error);
+	if (error)
+	{
+		return false;
+	}
+	const std::filesystem::file_time_type textTime = std::filesystem::last_write_time(levelPath, error);
+	if (!error && textTime > binaryTime)
+	{
+		return false;
+	}
+
+	Spear::MappedFile& mapped = rMapData.mappedLevel;
+	if (!mapped.Open(binaryPath.string().c_str()) || mapped.Size() < sizeof(BinaryLevelHeader))
+	{
+		mapped.Close();
+		return false;
+	}
+
+	// Validate everything used in place before pointing the map at it
+	const BinaryLevelHeader& header = *reinterpret_cast<const BinaryLevelHeader*>(mapped.Data());
+	const u64 chunkCount = static_cast<u64>((header.gridWidth + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT) * ((header.gridHeight + MAP_CHUNK_MASK) >> MAP_CHUNK_SHIFT);
+	auto IsValidBlock = [&mapped](u64 offset, u64 size)
+	{
+		return (offset % BINARY_LEVEL_ALIGNMENT) == 0 && offset <= mapped.Size() && size <= mapped.Size() - offset;
+	};
+	const bool bValid = header.magic == BINARY_LEVEL_MAGIC && header.version == BINARY_LEVEL_VERSION && header.gridNodeSize == sizeof(GridNode)
+		&& header.gridWidth > 0 && header.gridWidth <= MAP_WIDTH_MAX_SUPPORTED && header.gridHeight > 0 && header.gridHeight <= MAP_HEIGHT_MAX_SUPPORTED
+		&& header.residentChunks > 0 && static_cast<u64>(header.residentChunks) <= chunkCount + 1
+		&& IsValidBlock(header.chunkSlotsOffset, chunkCount * sizeof(int))
+		&& IsValidBlock(header.chunkNodesOffset, static_cast<u64>(header.residentChunks) * MAP_CHUNK_NODES * sizeof(GridNode))
+		&& IsValidBlock(header.tileFlagsOffset, static_cast<u64>(header.residentChunks) * MAP_CHUNK_NODES)
+		&& IsValidBlock(header.objectsOffset, header.objectsSize)
+		&& IsValidBlock(header.stringsOffset, header.stringsSize)
+		&& header.stringsSize > 0 && mapped.Data()[header.stringsOffset + header.stringsSize - 1] == '\0'
+		&& header.mapNameString < header.stringsSize && header.tileDirectoryString < header.stringsSize && header.spriteDirectoryString < header.stringsSize;
+	const int* chunkSlots = reinterpret_cast<const int*>(mapped.Data() + header.chunkSlotsOffset);
+	if (!bValid || std::any_of(chunkSlots, chunkSlots + chunkCount, [&header](int slot) { return slot < 0 || slot >= header.residentChunks; }))
+	{
+		mapped.Close();
+		return false;
+	}
+
+	// Grid is used straight from the mapping
+	rMapData.AttachChunks(header.gridWidth, header.gridHeight, header.residentChunks, chunkSlots,
+		reinterpret_cast<GridNode*>(mapped.Data() + header.chunkNodesOffset), mapped.Data() + header.tileFlagsOffset);
+
+	const char* strings = reinterpret_cast<const char*>(mapped.Data() + header.stringsOffset);
+	rMapData.mapName = strings + header.mapNameString;
+	rMapData.tileDirectory = std::filesystem::directory_entry(strings + header.tileDirectoryString);
+	rMapData.spriteDirectory = std::filesystem::directory_entry(strings + header.spriteDirectoryString);
+	rMapData.playerStart = Vector2i(header.playerStartX, header.playerStartY);
+	for (int i = 0; i < PLANE_HEIGHTS_TOTAL; i++)
+	{
+		rMapData.planeHeights[i] = header.planeHeights[i];
+	}
+	rMapData.darkness = header.darkness;
 
+	// GameObjects are read back through a stream by SpawnLevelObjects
+	rMapData.objectsFilePath = binaryPath.string();
+	rMapData.objectsOffset = header.objectsOffset;
+	rMapData.bObjectsInBinaryLevel = true;
+	return true;
+}
+
+void LevelFileManager::LoadTextLevel(const char* levelName, MapData& rMapData)
+{
 	// Read width/height header
 	std::ifstream file(GetFilePath(levelName));
 	std::string fWidth, fHeight;
 	std::getline(file, fWidth);
 	std::getline(file, fHeight);
-	rMapData.gridWidth = std::stoi(fWidth);
-	rMapData.gridHeight = std::stoi(fHeight);
-	ASSERT(rMapData.gridWidth > 0 && rMapData.gridWidth <= MAP_WIDTH_MAX_SUPPORTED && rMapData.gridHeight > 0 && rMapData.gridHeight <= MAP_HEIGHT_MAX_SUPPORTED);
 
-	Deserialize(rMapData.playerStart, file);
+	// Size the map with every chunk empty, chunks are then only allocated as tiles with content are read into them
+	rMapData.Allocate(std::stoi(fWidth), std::stoi(fHeight));
 
-	// Allocate rMapData.pNodes to use appropriate size in reserved memory
-	// TODO: Ensure pNodes has an appropriate 'delete' call
-	rMapData.pNodes = new (m_reservedMapMemory) GridNode[rMapData.gridWidth * rMapData.gridHeight];
+	Deserialize(rMapData.playerStart, file);
 
 	// Read grid
-	std::string texFloor, texWall, texRoof, extendUp, extendDown, collMask;
+	GridNode node;
 	for (int x = 0; x < rMapData.gridWidth; x++)
 	{
 		for (int y = 0; y < rMapData.gridHeight; y++)
 		{
-			GridNode& node = rMapData.pNodes[(y * rMapData.gridWidth) + x];
 			Deserialize(node, file);
+			if (!node.IsEmpty())
+			{
+				rMapData.EditNode(x, y) = node;
+			}
 		}
 	}
 
+	// Build compact tile flags alongside the grid
+	rMapData.RebuildTileFlags();
+
 	// Read map name
 	std::getline(file, rMapData.mapName);
 
@@ -142,42 +305,95 @@ void LevelFileManager::LoadLevel(const char* levelName, MapData& rMapData)
 		rMapData.planeHeights[i] = std::stoi(planeHeight);
 	}
 
+	// GameObjects follow, and are read back by SpawnLevelObjects
+	rMapData.objectsFilePath = GetFilePath(levelName);
+	rMapData.objectsOffset = static_cast<u64>(file.tellg());
+	rMapData.bObjectsInBinaryLevel = false;
+
+	// Tileset/Spriteset and 'Other' settings come after the GameObjects, but EditorSaveLevel always writes them as the final three lines, so read those without parsing the GameObjects
+	std::string footer[3];
+	std::string line;
+	while (std::getline(file, line))
+	{
+		footer[0] = std::move(footer[1]);
+		footer[1] = std::move(footer[2]);
+		footer[2] = std::move(line);
+	}
+	rMapData.tileDirectory = std::filesystem::directory_entry(footer[0]);
+	rMapData.spriteDirectory = std::filesystem::directory_entry(footer[1]);
+	rMapData.darkness = std::stoi(footer[2]);
+}
+
+LevelVisibility::BuildSettings LevelFileManager::GetVisibilitySettings()
+{
+	// Visibility set is built using the raycaster's current limits
+	const RaycasterConfig rayConfig = Raycaster::GetConfigCopy();
+	LevelVisibility::BuildSettings visibilitySettings;
+	visibilitySettings.viewDistance = rayConfig.farClip;
+	visibilitySettings.wallEncounterLimit = rayConfig.rayEncounterLimit;
+	return visibilitySettings;
+}
+
+void LevelFileManager::LoadLevel(const char* levelName, MapData& rMapData, bool bAllowBinary)
+{
+	LoadLevelTiles(levelName, rMapData, GetVisibilitySettings(), bAllowBinary);
+	SpawnLevelObjects(rMapData);
+}
+
+void LevelFileManager::LoadLevelTiles(const char* levelName, MapData& rMapData, const LevelVisibility::BuildSettings& visibilitySettings, bool bAllowBinary)
+{
+	// Nothing may still be tracing the tiles about to be replaced
+	rMapData.visibility.Unload();
+
+	if (!bAllowBinary || !LoadBinaryLevel(levelName, rMapData))
+	{
+		LoadTextLevel(levelName, rMapData);
+	}
+
+	// Lay out the visibility set, reading whichever regions have been traced before from its cache alongside the level file, then trace those around the spawn (streamed levels do this on a worker)
+	rMapData.visibility.Initialise(rMapData, visibilitySettings, std::filesystem::path(GetFilePath(levelName)).replace_extension(".pvs").string());
+	rMapData.visibility.PrepareRegionsAround(rMapData, rMapData.playerStart);
+}
+
+void LevelFileManager::SpawnLevelObjects(const MapData& rMapData)
+{
 	// Initialise Collision QuadTree to appropriate size for level
 	Collision::CollisionSystem2D::Get().ResizeQuadTree(Vector2f::ZeroVector, Vector2f(rMapData.gridWidth, rMapData.gridHeight));
 
 	// Load GameObjects
-	GameObject::GlobalDeserialize(file);
+	std::ifstream objects(rMapData.objectsFilePath, rMapData.bObjectsInBinaryLevel ? std::ios::in | std::ios::binary : std::ios::in);
+	objects.seekg(rMapData.objectsOffset);
+	GameObject::GlobalDeserialize(objects);
 
-	// Generate collisions for tilemap
+	// Generate collisions for tilemap, skipping chunks with nothing in them
 	// TODO: Detect and combine edges into single appropriately-sized AABBs
-	for (int x = 0; x < rMapData.gridWidth; x++)
+	for (int chunkY = 0; chunkY < rMapData.chunksY; chunkY++)
 	{
-		for (int y = 0; y < rMapData.gridHeight; y++)
+		for (int chunkX = 0; chunkX < rMapData.chunksX; chunkX++)
 		{
-			if (const GridNode* mapNode = rMapData.GetNode({ x, y }))
+			if (rMapData.pChunkSlots[chunkX + (chunkY * rMapData.chunksX)] == 0)
+			{
+				continue;
+			}
+
+			const int xEnd = std::min((chunkX + 1) * MAP_CHUNK_SIZE, rMapData.gridWidth);
+			const int yEnd = std::min((chunkY + 1) * MAP_CHUNK_SIZE, rMapData.gridHeight);
+			for (int x = chunkX * MAP_CHUNK_SIZE; x < xEnd; x++)
 			{
-				if (mapNode->collisionMask)
+				for (int y = chunkY * MAP_CHUNK_SIZE; y < yEnd; y++)
 				{
-					OBoxCollider* coll = GameObject::Create<OBoxCollider>(Vector3f(x + 0.5f, y + 0.5f, 0));
+					const int nodeIndex = rMapData.NodeIndex(x, y);
+					if (rMapData.pTileFlags[nodeIndex] & TILE_COLLISION)
+					{
+						OBoxCollider* coll = GameObject::Create<OBoxCollider>(Vector3f(x + 0.5f, y + 0.5f, 0));
 
-					// Since player performs PreCheckedMovement against tiles, collision system does not need to test tiles against the player, hence removing the flag
-					coll->ApplySetup(Collision::World, mapNode->collisionMask & ~Collision::Player, Collision::PROFILE_None, true);
+						// Since player performs PreCheckedMovement against tiles, collision system does not need to test tiles against the player, hence removing the flag
+						coll->ApplySetup(Collision::World, rMapData.pNodes[nodeIndex].collisionMask & ~Collision::Player, Collision::PROFILE_None, true);
 
-					coll->SetHalfExtent({.5f, .5f});
+						coll->SetHalfExtent({.5f, .5f});
+					}
 				}
 			}
 		}
 	}
-
-	// Read Tileset/Spriteset
-	std::string temp;
-	std::getline(file, temp);
-	std::getline(file, temp);
-	rMapData.tileDirectory = std::filesystem::directory_entry(temp);
-	std::getline(file, temp);
-	rMapData.spriteDirectory = std::filesystem::directory_entry(temp);
-
-	// Read 'Other' settings
-	std::getline(file, temp);
-	rMapData.darkness = std::stoi(temp);
-}
\ No newline at end of file
+}
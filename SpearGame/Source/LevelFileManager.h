@@ -12,16 +12,56 @@ public:
 	static void EditorLoadLevel(const char* levelName, EditorMapData& rMapData);
 
 	// For loading a level from scratch, with default GameObject states and generating collision objects for tiles
-	static void LoadLevel(const char* levelName, MapData& rMapData);
+	// Uses the level's binary counterpart (mapped and used in place) when one exists which is at least as new as the text level
+	static void LoadLevel(const char* levelName, MapData& rMapData, bool bAllowBinary = true);
+
+	// LoadLevel split in two, so the bulk of loading can happen on a worker thread ahead of a level transition (see LevelStreamer)
+	// LoadLevelTiles reads everything but GameObjects and touches no global state. SpawnLevelObjects creates the GameObjects and tile colliders (main thread only).
+	static void LoadLevelTiles(const char* levelName, MapData& rMapData, const LevelVisibility::BuildSettings& visibilitySettings, bool bAllowBinary = true);
+	static void SpawnLevelObjects(const MapData& rMapData);
+	static LevelVisibility::BuildSettings GetVisibilitySettings();
+
+	// Writes the binary counterpart of a text level. Spawns the level's GameObjects in order to serialize them, so must only be called with no level loaded.
+	static bool ConvertLevelToBinary(const char* levelName);
 
 	// TODO: For loading a savefile, file should contain map name, load tiles but skip loading objects/generating collision objects, then deserialise GameObjects from savefile instead of from level
 	// static void LoadSavedGame(const char* saveName, MapData& rMapData);
 
 private:
-	// editor map data includes large gaps in array to allow for easy map-resizing
-	// at game time, contiguously allocate maps into this reserved memory instead
-	static const int MAP_RESERVED_BYTES{ (MAP_WIDTH_MAX_SUPPORTED * MAP_HEIGHT_MAX_SUPPORTED) * sizeof(GridNode) };
-	static char m_reservedMapMemory[MAP_RESERVED_BYTES];
+	// Binary level layout: header, then chunk slot table, chunk arena GridNodes and tile flags laid out exactly as MapData uses them, then the GameObject table and a string table
+	// Every block starts on a BINARY_LEVEL_ALIGNMENT boundary so the arena can be used straight from the mapped file
+	struct BinaryLevelHeader
+	{
+		u32 magic;
+		u32 version;
+		u32 gridNodeSize;			// sizeof(GridNode) when written, rejects files from builds with a different GridNode
+		int gridWidth;
+		int gridHeight;
+		int residentChunks;			// including the shared empty chunk
+		int playerStartX;
+		int playerStartY;
+		float planeHeights[PLANE_HEIGHTS_TOTAL];
+		float darkness;
+		u32 mapNameString;			// offsets of null-terminated strings within the string table
+		u32 tileDirectoryString;
+		u32 spriteDirectoryString;
+		u64 chunkSlotsOffset;
+		u64 chunkNodesOffset;
+		u64 tileFlagsOffset;
+		u64 objectsOffset;			// GameObject::GlobalSerialize output, read back through a stream
+		u64 objectsSize;
+		u64 stringsOffset;
+		u64 stringsSize;
+	};
+	static constexpr u32 BINARY_LEVEL_MAGIC{ 0x564C5053 }; // 'SPLV'
+	static constexpr u32 BINARY_LEVEL_VERSION{ 1 };
+	static constexpr u64 BINARY_LEVEL_ALIGNMENT{ 64 };
+
+	static bool WriteBinaryLevel(const EditorMapData& rMapData, const std::string& levelPath);
+	static bool LoadBinaryLevel(const char* levelName, MapData& rMapData);
+	static void LoadTextLevel(const char* levelName, MapData& rMapData);
+
+	static_assert(MAP_CHUNK_NODES % 4 == 0, "Tile flags are uploaded to compute shaders as packed uints");
 
 	template <typename T>
 	static void Serialize(const T& data, std::ofstream& os)
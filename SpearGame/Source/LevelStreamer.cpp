@@ -0,0 +1,87 @@
+#include "LevelStreamer.h"
+#include "LevelFileManager.h"
+#include "Core/ServiceLocator.h"
+#include <algorithm>
+
+LevelStreamer::~LevelStreamer()
+{
+	Flush();
+}
+
+void LevelStreamer::Prefetch(const std::string& levelName)
+{
+	for (const std::unique_ptr<StreamedLevel>& level : m_levels)
+	{
+		if (level->levelName == levelName)
+		{
+			return;
+		}
+	}
+
+	m_levels.push_back(std::make_unique<StreamedLevel>());
+	StreamedLevel* pLevel = m_levels.back().get();
+	pLevel->levelName = levelName;
+
+	// Raycaster config is read here rather than on the worker, as it may be changed on the main thread at any time
+	const LevelVisibility::BuildSettings visibilitySettings = LevelFileManager::GetVisibilitySettings();
+	u64 residentContentHashes[GlobalTextureBatches::BATCH_TOTALS];
+	std::copy(std::begin(m_residentContentHashes), std::end(m_residentContentHashes), residentContentHashes);
+	Spear::ServiceLocator::GetThreadManager().DispatchBackgroundTask([pLevel, visibilitySettings, residentContentHashes](u32)
+	{
+		StreamLevel(*pLevel, visibilitySettings, residentContentHashes);
+		return 0;
+	}, &pLevel->task);
+}
+
+void LevelStreamer::StreamLevel(StreamedLevel& level, const LevelVisibility::BuildSettings& visibilitySettings, const u64* residentContentHashes)
+{
+	LevelFileManager::LoadLevelTiles(level.levelName.c_str(), level.mapData, visibilitySettings);
+	Spear::TextureArray::DecodeDirectory(level.mapData.tileDirectory.path().string().c_str(), level.textures[GlobalTextureBatches::BATCH_TILESET_1], residentContentHashes[GlobalTextureBatches::BATCH_TILESET_1]);
+	Spear::TextureArray::DecodeDirectory(level.mapData.spriteDirectory.path().string().c_str(), level.textures[GlobalTextureBatches::BATCH_SPRITESET_1], residentContentHashes[GlobalTextureBatches::BATCH_SPRITESET_1]);
+}
+
+void LevelStreamer::LoadLevel(const std::string& levelName, MapData& rMapData, Spear::TextureArray* pTextures)
+{
+	auto streamed = std::find_if(m_levels.begin(), m_levels.end(), [&levelName](const std::unique_ptr<StreamedLevel>& level) { return level->levelName == levelName; });
+	std::unique_ptr<StreamedLevel> level;
+	if (streamed != m_levels.end())
+	{
+		level = std::move(*streamed);
+		m_levels.erase(streamed);
+		level->task.WaitForTaskComplete();
+	}
+	else
+	{
+		u64 residentContentHashes[GlobalTextureBatches::BATCH_TOTALS];
+		for (int i = 0; i < GlobalTextureBatches::BATCH_TOTALS; i++)
+		{
+			residentContentHashes[i] = pTextures[i].Exists() ? pTextures[i].GetContentHash() : 0;
+		}
+
+		level = std::make_unique<StreamedLevel>();
+		level->levelName = levelName;
+		StreamLevel(*level, LevelFileManager::GetVisibilitySettings(), residentContentHashes);
+	}
+
+	// The outgoing level's visibility may still be tracing its tiles in the background, and MapData moves the tiles before it reaches visibility
+	rMapData.visibility.Unload();
+	rMapData = std::move(level->mapData);
+	LevelFileManager::SpawnLevelObjects(rMapData);
+	for (int i = 0; i < GlobalTextureBatches::BATCH_TOTALS; i++)
+	{
+		pTextures[i].InitialiseFromDecoded(std::move(level->textures[i]));
+		m_residentContentHashes[i] = pTextures[i].GetContentHash();
+	}
+
+	// Other levels streamed for the previous level's links are unlikely to be wanted from this one, drop those no longer in flight
+	std::erase_if(m_levels, [](const std::unique_ptr<StreamedLevel>& other) { return other->task.IsTaskComplete(); });
+}
+
+void LevelStreamer::Flush()
+{
+	for (const std::unique_ptr<StreamedLevel>& level : m_levels)
+	{
+		level->task.WaitForTaskComplete();
+	}
+	m_levels.clear();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "LevelData.h"
+#include "GlobalTextureBatches.h"
+#include "Core/ThreadManager.h"
+#include "Graphics/TextureArray.h"
+#include <memory>
+
+// Streams levels in ahead of level transitions: tiles, visibility set and texture decoding all happen on a worker thread,
+// leaving only GameObject spawning and GPU uploads for the transition itself
+class LevelStreamer
+{
+public:
+	NO_COPY(LevelStreamer);
+	LevelStreamer() = default;
+	~LevelStreamer();
+
+	// Starts streaming levelName in the background, unless it is already streamed or streaming
+	void Prefetch(const std::string& levelName);
+
+	// Makes levelName the current level: replaces rMapData, spawns its GameObjects and initialises pTextures (one per GlobalTextureBatches)
+	// Uses the streamed level if there is one, waiting for it if still in flight, otherwise loads synchronously
+	void LoadLevel(const std::string& levelName, MapData& rMapData, Spear::TextureArray* pTextures);
+
+	// Waits for any streaming still in flight, then discards everything streamed
+	void Flush();
+
+private:
+	struct StreamedLevel
+	{
+		std::string levelName;
+		MapData mapData;
+		Spear::DecodedTextureArray textures[GlobalTextureBatches::BATCH_TOTALS];
+		Spear::TaskHandle task;
+	};
+
+	// residentContentHashes (one per GlobalTextureBatches) lets texture directories already on the GPU skip decoding
+	static void StreamLevel(StreamedLevel& level, const LevelVisibility::BuildSettings& visibilitySettings, const u64* residentContentHashes);
+
+	std::vector<std::unique_ptr<StreamedLevel>> m_levels;
+	u64 m_residentContentHashes[GlobalTextureBatches::BATCH_TOTALS]{};	// of the textures given to the last LoadLevel
+};
@@ -0,0 +1,532 @@
+#include "LevelVisibility.h"
+#include "LevelData.h"
+#include "Core/ServiceLocator.h"
+#include "Core/ThreadManager.h"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+
+constexpr u32 VISIBILITY_CACHE_MAGIC{ 0x53565053 }; // 'SPVS'
+constexpr u32 VISIBILITY_CACHE_VERSION{ 3 };
+
+// Rays traced from each origin sample, and spacing of origin samples along region edges (in tiles)
+// Gaps left between samples are covered by also marking neighbouring regions for tiles on a region's edge
+constexpr int VISIBILITY_TRACE_DIRECTIONS{ 256 };
+constexpr float VISIBILITY_ORIGIN_SPACING{ 1.f };
+constexpr float VISIBILITY_ORIGIN_INSET{ 0.01f };
+
+// Cache is this header followed by a record per traced region (in the order they were added): the region, its visible region count, then its visible regions
+struct VisibilityCacheHeader
+{
+	u32 magic{ VISIBILITY_CACHE_MAGIC };
+	u32 version{ VISIBILITY_CACHE_VERSION };
+	int regionSize{ LevelVisibility::REGION_SIZE };
+	float viewDistance{ 0.f };
+	int wallEncounterLimit{ 0 };
+	u64 tileFlagsHash{ 0 };
+};
+
+static const Vector2f* GetTraceDirections()
+{
+	static const std::vector<Vector2f> traceDirections = []()
+	{
+		std::vector<Vector2f> directions(VISIBILITY_TRACE_DIRECTIONS);
+		for (int i = 0; i < VISIBILITY_TRACE_DIRECTIONS; i++)
+		{
+			// half-step offset keeps every direction off the axes
+			const float angle = (static_cast<float>(i) + 0.5f) * (2.f * PI / VISIBILITY_TRACE_DIRECTIONS);
+			directions[i] = Vector2f(cos(angle), sin(angle));
+		}
+		return directions;
+	}();
+	return traceDirections.data();
+}
+
+// Marks the region containing tile, plus the neighbouring region(s) if the tile lies on the edge of its region
+static void MarkVisibleTile(int tileX, int tileY, int regionsX, int regionsY, std::vector<u8>& visible)
+{
+	constexpr int S = LevelVisibility::REGION_SIZE;
+	const int regionX = tileX / S;
+	const int regionY = tileY / S;
+	const int xLower = std::max(0, regionX - ((tileX % S) == 0));
+	const int xUpper = std::min(regionsX - 1, regionX + ((tileX % S) == S - 1));
+	const int yLower = std::max(0, regionY - ((tileY % S) == 0));
+	const int yUpper = std::min(regionsY - 1, regionY + ((tileY % S) == S - 1));
+	for (int y = yLower; y <= yUpper; y++)
+	{
+		for (int x = xLower; x <= xUpper; x++)
+		{
+			visible[x + (y * regionsX)] = 1;
+		}
+	}
+}
+
+// Walks a ray through the grid following the same rules as Raycaster::RaycastWallColumn, marking every tile it passes through
+static void TraceVisibility(const MapData& map, const LevelVisibility::BuildSettings& settings, const Vector2f& rayStart, const Vector2f& rayDir, int regionsX, int regionsY, std::vector<u8>& visible)
+{
+	// Always float: the set is cached on disk, so it mustn't depend on which DDA the renderer happens to be using
+	GridDDA<DDAFloat> dda;
+	dda.Begin(rayStart, rayDir);
+	Vector2i& mapCheck = dda.mapCheck;
+	Vector2i& step = dda.step;
+
+	MapData::ChunkCursor cursor;
+	int rayEncounters{ 0 };
+	while (rayEncounters < settings.wallEncounterLimit && dda.distance < settings.viewDistance)
+	{
+		const bool side = dda.Step();
+
+		if (mapCheck.x < 0 || mapCheck.x >= map.gridWidth || mapCheck.y < 0 || mapCheck.y >= map.gridHeight)
+		{
+			break;
+		}
+		MarkVisibleTile(mapCheck.x, mapCheck.y, regionsX, regionsY, visible);
+
+		const u8 tileFlags = map.pTileFlags[cursor.NodeIndex(map, mapCheck.x, mapCheck.y)];
+		if (tileFlags & TILE_ANY_MIRROR)
+		{
+			if (tileFlags & TILE_ANY_PORTAL)
+			{
+				step *= -1;
+				if (tileFlags & TILE_PORTAL_CONJOINED)
+				{
+					mapCheck = map.GetExitTileForConjoinedPortal(mapCheck, side);
+				}
+			}
+			else
+			{
+				side ? step.x *= -1 : step.y *= -1;
+			}
+			side ? mapCheck.x += step.x : mapCheck.y += step.y;
+
+			if (mapCheck.x >= 0 && mapCheck.x < map.gridWidth && mapCheck.y >= 0 && mapCheck.y < map.gridHeight)
+			{
+				MarkVisibleTile(mapCheck.x, mapCheck.y, regionsX, regionsY, visible);
+			}
+		}
+		if (tileFlags & TILE_WALL)
+		{
+			rayEncounters++;
+		}
+	}
+}
+
+LevelVisibility::LevelVisibility(LevelVisibility&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+LevelVisibility& LevelVisibility::operator=(LevelVisibility&& other) noexcept
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+
+	// Background traces point at the set (and map) they were dispatched for, so neither can move while they run
+	Unload();
+	other.WaitForPrefetches();
+	m_settings = other.m_settings;
+	m_cachePath = std::move(other.m_cachePath);
+	m_tileFlagsHash = other.m_tileFlagsHash;
+	m_regionsX = other.m_regionsX;
+	m_regionsY = other.m_regionsY;
+	m_regionCount = other.m_regionCount;
+	m_regionStates = std::move(other.m_regionStates);
+	m_visibleRegions = std::move(other.m_visibleRegions);
+	m_regionCached = std::move(other.m_regionCached);
+	m_regionTileFlags = std::move(other.m_regionTileFlags);
+	m_visibleTileFlags = std::move(other.m_visibleTileFlags);
+	m_localTileFlags = std::move(other.m_localTileFlags);
+	other.Reset();
+	return *this;
+}
+
+LevelVisibility::~LevelVisibility()
+{
+	Unload();
+}
+
+void LevelVisibility::Initialise(const MapData& map, const BuildSettings& settings, const std::string& cachePath)
+{
+	Unload();
+	m_settings = settings;
+	m_cachePath = cachePath;
+	m_tileFlagsHash = HashTileFlags(map);
+	m_regionsX = (map.gridWidth + REGION_SIZE - 1) / REGION_SIZE;
+	m_regionsY = (map.gridHeight + REGION_SIZE - 1) / REGION_SIZE;
+	m_regionCount = m_regionsX * m_regionsY;
+	m_regionStates = std::make_unique<std::atomic<u8>[]>(m_regionCount);
+	m_visibleRegions.resize(m_regionCount);
+	m_regionCached.assign(m_regionCount, u8(0));
+	m_visibleTileFlags.assign(m_regionCount, u8(0xFF));
+
+	// Summarise tile flags per region, then over each region's local border (visible sets are summarised as each region is traced)
+	m_regionTileFlags.assign(m_regionCount, u8(0));
+	for (int y = 0; y < map.gridHeight; y++)
+	{
+		for (int x = 0; x < map.gridWidth; x++)
+		{
+			m_regionTileFlags[(x / REGION_SIZE) + ((y / REGION_SIZE) * m_regionsX)] |= map.pTileFlags[map.NodeIndex(x, y)];
+		}
+	}
+
+	m_localTileFlags.resize(m_regionCount);
+	for (int region = 0; region < m_regionCount; region++)
+	{
+		const int x0 = std::max(0, (region % m_regionsX) * REGION_SIZE - 1);
+		const int y0 = std::max(0, (region / m_regionsX) * REGION_SIZE - 1);
+		const int x1 = std::min(map.gridWidth, (region % m_regionsX) * REGION_SIZE + REGION_SIZE + 1);
+		const int y1 = std::min(map.gridHeight, (region / m_regionsX) * REGION_SIZE + REGION_SIZE + 1);
+		u8 localFlags = TILE_EMPTY;
+		for (int y = y0; y < y1; y++)
+		{
+			for (int x = x0; x < x1; x++)
+			{
+				localFlags |= map.pTileFlags[map.NodeIndex(x, y)];
+			}
+		}
+		m_localTileFlags[region] = localFlags;
+	}
+
+	if (!ReadCache())
+	{
+		// Discard anything read before the cache turned out to be unusable
+		for (int region = 0; region < m_regionCount; region++)
+		{
+			m_regionStates[region].store(REGION_UNTRACED, std::memory_order_relaxed);
+		}
+		m_regionCached.assign(m_regionCount, u8(0));
+		m_visibleTileFlags.assign(m_regionCount, u8(0xFF));
+		WriteCacheHeader();
+	}
+}
+
+template <typename Function>
+void LevelVisibility::ForEachRegionAround(const Vector2i& tile, Function function) const
+{
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			const int region = GetRegionIndex(tile + Vector2i(x * REGION_SIZE, y * REGION_SIZE));
+			if (region >= 0)
+			{
+				function(region);
+			}
+		}
+	}
+}
+
+void LevelVisibility::PrepareRegionsAround(const MapData& map, const Vector2i& tile)
+{
+	ForEachRegionAround(tile, [&](int region)
+	{
+		if (ClaimRegion(region))
+		{
+			TraceRegion(map, region);
+		}
+	});
+}
+
+void LevelVisibility::PrefetchRegionsAround(const MapData& map, const Vector2i& tile)
+{
+	std::erase_if(m_prefetchTasks, [](const std::unique_ptr<Spear::TaskHandle>& task) { return task->IsTaskComplete(); });
+
+	const MapData* pMap = &map;
+	ForEachRegionAround(tile, [&](int region)
+	{
+		if (!ClaimRegion(region))
+		{
+			return;
+		}
+
+		m_prefetchTasks.push_back(std::make_unique<Spear::TaskHandle>());
+		Spear::ServiceLocator::GetThreadManager().DispatchBackgroundTask([this, pMap, region](u32)
+		{
+			TraceRegion(*pMap, region);
+			return 0;
+		}, m_prefetchTasks.back().get());
+	});
+}
+
+bool LevelVisibility::ClaimRegion(int region)
+{
+	u8 expected = REGION_UNTRACED;
+	return m_regionStates[region].compare_exchange_strong(expected, REGION_TRACING, std::memory_order_relaxed);
+}
+
+void LevelVisibility::TraceRegion(const MapData& map, int region)
+{
+	const int x0 = (region % m_regionsX) * REGION_SIZE;
+	const int y0 = (region / m_regionsX) * REGION_SIZE;
+	const int x1 = std::min(x0 + REGION_SIZE, map.gridWidth);
+	const int y1 = std::min(y0 + REGION_SIZE, map.gridHeight);
+
+	// Any path from inside the region to a tile outside it crosses the region's edge with no more distance or walls left to travel, so tracing from the edge covers it...
+	std::vector<Vector2f> origins;
+	for (float t = 0.f; t <= static_cast<float>(x1 - x0); t += VISIBILITY_ORIGIN_SPACING)
+	{
+		const float x = std::clamp(x0 + t, x0 + VISIBILITY_ORIGIN_INSET, x1 - VISIBILITY_ORIGIN_INSET);
+		origins.emplace_back(x, y0 + VISIBILITY_ORIGIN_INSET);
+		origins.emplace_back(x, y1 - VISIBILITY_ORIGIN_INSET);
+	}
+	for (float t = 0.f; t <= static_cast<float>(y1 - y0); t += VISIBILITY_ORIGIN_SPACING)
+	{
+		const float y = std::clamp(y0 + t, y0 + VISIBILITY_ORIGIN_INSET, y1 - VISIBILITY_ORIGIN_INSET);
+		origins.emplace_back(x0 + VISIBILITY_ORIGIN_INSET, y);
+		origins.emplace_back(x1 - VISIBILITY_ORIGIN_INSET, y);
+	}
+
+	// ...unless a mirror/portal inside the region redirects it first (conjoined portals may even exit beyond the edge), so also trace from every tile of those regions
+	if (m_regionTileFlags[region] & TILE_ANY_MIRROR)
+	{
+		for (int y = y0; y < y1; y++)
+		{
+			for (int x = x0; x < x1; x++)
+			{
+				origins.emplace_back(x + 0.5f, y + 0.5f);
+			}
+		}
+	}
+
+	// Origins are traced in parallel, each chunk marking its own copy of the visible regions before merging them
+	const Vector2f* pTraceDirections = GetTraceDirections();
+	std::vector<u8> visible(m_regionCount, u8(0));
+	visible[region] = 1;
+	std::mutex visibleMutex;
+	auto TraceOriginsTask = [&](int originLowerBound, int originUpperBound)
+	{
+		std::vector<u8> originVisible(m_regionCount, u8(0));
+		for (int origin = originLowerBound; origin < originUpperBound; origin++)
+		{
+			for (int direction = 0; direction < VISIBILITY_TRACE_DIRECTIONS; direction++)
+			{
+				TraceVisibility(map, m_settings, origins[origin], pTraceDirections[direction], m_regionsX, m_regionsY, originVisible);
+			}
+		}
+
+		std::scoped_lock<std::mutex> lock(visibleMutex);
+		for (int other = 0; other < m_regionCount; other++)
+		{
+			visible[other] |= originVisible[other];
+		}
+	};
+	Spear::ServiceLocator::GetThreadManager().ParallelFor(0, static_cast<int>(origins.size()), Spear::ThreadManager::AUTO_GRAIN, TraceOriginsTask);
+
+	std::vector<u32> visibleRegions;
+	for (int other = 0; other < m_regionCount; other++)
+	{
+		if (visible[other])
+		{
+			visibleRegions.push_back(other);
+		}
+	}
+	SetRegionVisible(region, std::move(visibleRegions));
+}
+
+void LevelVisibility::SetRegionVisible(int region, std::vector<u32>&& visibleRegions)
+{
+	u8 visibleFlags = TILE_EMPTY;
+	for (const u32 other : visibleRegions)
+	{
+		visibleFlags |= m_regionTileFlags[other];
+	}
+	m_visibleTileFlags[region] = visibleFlags;
+	m_visibleRegions[region] = std::move(visibleRegions);
+	m_regionStates[region].store(REGION_READY, std::memory_order_release);
+}
+
+void LevelVisibility::WaitForPrefetches()
+{
+	for (const std::unique_ptr<Spear::TaskHandle>& task : m_prefetchTasks)
+	{
+		task->WaitForTaskComplete();
+	}
+	m_prefetchTasks.clear();
+}
+
+void LevelVisibility::Unload()
+{
+	WaitForPrefetches();
+	AppendUncachedRegions();
+	Reset();
+}
+
+void LevelVisibility::Reset()
+{
+	m_cachePath.clear();
+	m_tileFlagsHash = 0;
+	m_regionsX = 0;
+	m_regionsY = 0;
+	m_regionCount = 0;
+	m_regionStates.reset();
+	m_visibleRegions.clear();
+	m_regionCached.clear();
+	m_regionTileFlags.clear();
+	m_visibleTileFlags.clear();
+	m_localTileFlags.clear();
+}
+
+bool LevelVisibility::IsValidFor(float viewDistance, int wallEncounterLimit) const
+{
+	return IsBuilt() && viewDistance <= m_settings.viewDistance && wallEncounterLimit <= m_settings.wallEncounterLimit;
+}
+
+int LevelVisibility::GetRegionIndex(const Vector2i& tile) const
+{
+	if (tile.x < 0 || tile.y < 0)
+	{
+		return -1;
+	}
+	const int regionX = tile.x / REGION_SIZE;
+	const int regionY = tile.y / REGION_SIZE;
+	if (regionX >= m_regionsX || regionY >= m_regionsY)
+	{
+		return -1;
+	}
+	return regionX + (regionY * m_regionsX);
+}
+
+bool LevelVisibility::IsRegionVisible(int fromRegion, int toRegion) const
+{
+	if (fromRegion < 0 || fromRegion >= m_regionCount || toRegion < 0 || toRegion >= m_regionCount || !IsRegionReady(fromRegion))
+	{
+		return true;
+	}
+	const std::vector<u32>& visibleRegions = m_visibleRegions[fromRegion];
+	return std::binary_search(visibleRegions.begin(), visibleRegions.end(), static_cast<u32>(toRegion));
+}
+
+u8 LevelVisibility::GetVisibleTileFlags(int region) const
+{
+	if (region < 0 || region >= m_regionCount || !IsRegionReady(region))
+	{
+		return 0xFF;
+	}
+	return m_visibleTileFlags[region];
+}
+
+u8 LevelVisibility::GetLocalTileFlags(int region) const
+{
+	if (region < 0 || region >= m_regionCount)
+	{
+		return 0xFF;
+	}
+	return m_localTileFlags[region];
+}
+
+u64 LevelVisibility::HashTileFlags(const MapData& map)
+{
+	// FNV-1a over the grid size and tile flags, which are all the traces depend on (so also validates the cache's region layout)
+	constexpr u64 fnvOffsetBasis{ 14695981039346656037ull };
+	constexpr u64 fnvPrime{ 1099511628211ull };
+
+	u64 hash = fnvOffsetBasis;
+	auto HashBytes = [&hash](const void* pData, size_t bytes)
+	{
+		const u8* pBytes = static_cast<const u8*>(pData);
+		for (size_t i = 0; i < bytes; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= fnvPrime;
+		}
+	};
+	HashBytes(&map.gridWidth, sizeof(map.gridWidth));
+	HashBytes(&map.gridHeight, sizeof(map.gridHeight));
+	for (int y = 0; y < map.gridHeight; y++)
+	{
+		for (int x = 0; x < map.gridWidth; x++)
+		{
+			HashBytes(&map.pTileFlags[map.NodeIndex(x, y)], sizeof(u8));
+		}
+	}
+	return hash;
+}
+
+bool LevelVisibility::ReadCache()
+{
+	std::ifstream file(m_cachePath, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	VisibilityCacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file
+		|| header.magic != VISIBILITY_CACHE_MAGIC
+		|| header.version != VISIBILITY_CACHE_VERSION
+		|| header.regionSize != REGION_SIZE
+		|| header.tileFlagsHash != m_tileFlagsHash
+		|| header.viewDistance != m_settings.viewDistance
+		|| header.wallEncounterLimit != m_settings.wallEncounterLimit)
+	{
+		return false;
+	}
+
+	u32 record[2]; // region, visible region count
+	while (file.read(reinterpret_cast<char*>(record), sizeof(record)))
+	{
+		if (record[0] >= static_cast<u32>(m_regionCount) || record[1] > static_cast<u32>(m_regionCount))
+		{
+			LOG("Level visibility cache is corrupt, restarting it: " + m_cachePath);
+			return false;
+		}
+
+		std::vector<u32> visibleRegions(record[1]);
+		file.read(reinterpret_cast<char*>(visibleRegions.data()), visibleRegions.size() * sizeof(u32));
+		if (!file)
+		{
+			LOG("Level visibility cache is truncated, restarting it: " + m_cachePath);
+			return false;
+		}
+		SetRegionVisible(record[0], std::move(visibleRegions));
+		m_regionCached[record[0]] = 1;
+	}
+	return true;
+}
+
+void LevelVisibility::WriteCacheHeader() const
+{
+	std::ofstream file(m_cachePath, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		LOG("Unable to write level visibility cache: " + m_cachePath);
+		return;
+	}
+
+	VisibilityCacheHeader header;
+	header.viewDistance = m_settings.viewDistance;
+	header.wallEncounterLimit = m_settings.wallEncounterLimit;
+	header.tileFlagsHash = m_tileFlagsHash;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void LevelVisibility::AppendUncachedRegions()
+{
+	// Batched here rather than as each region is traced, so the file is never touched mid-frame
+	std::ofstream file;
+	for (int region = 0; region < m_regionCount; region++)
+	{
+		if (m_regionCached[region] || !IsRegionReady(region))
+		{
+			continue;
+		}
+
+		if (!file.is_open())
+		{
+			file.open(m_cachePath, std::ios::binary | std::ios::app);
+			if (!file)
+			{
+				return;
+			}
+		}
+
+		const std::vector<u32>& visibleRegions = m_visibleRegions[region];
+		const u32 record[2]{ static_cast<u32>(region), static_cast<u32>(visibleRegions.size()) };
+		file.write(reinterpret_cast<const char*>(record), sizeof(record));
+		file.write(reinterpret_cast<const char*>(visibleRegions.data()), visibleRegions.size() * sizeof(u32));
+		m_regionCached[region] = 1;
+	}
+}
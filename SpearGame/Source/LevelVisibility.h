@@ -0,0 +1,99 @@
+#pragma once
+#include "Core/Core.h"
+#include "Core/ThreadManager.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct MapData;
+
+// Potentially-visible-set between square regions of tiles, built by tracing rays through the tile grid using the raycaster's own rules (mirrors, portals, wall encounter limit, far clip)
+// Lets per-frame work (sprites, collision traces) skip whole regions rather than growing with map area
+// Each region's set is only traced once it's needed (see PrepareRegionsAround/PrefetchRegionsAround), so load time doesn't grow with map area either. Traced regions are added to a cache beside the level when it's unloaded.
+class LevelVisibility
+{
+public:
+	NO_COPY(LevelVisibility);
+	LevelVisibility() = default;
+	LevelVisibility(LevelVisibility&& other) noexcept;
+	LevelVisibility& operator=(LevelVisibility&& other) noexcept;
+	~LevelVisibility();
+
+	static constexpr int REGION_SIZE{ 8 }; // width/height of a region in tiles
+
+	// Trace limits the set was built with. Only conservative for raycasters which see no further (see IsValidFor)
+	struct BuildSettings
+	{
+		float viewDistance{ 50.f };
+		int wallEncounterLimit{ 24 };
+	};
+
+	// Lays out the regions for this map's tiles and reads any regions already traced from cachePath (if it was written for these tiles with the same settings, otherwise it's restarted)
+	void Initialise(const MapData& map, const BuildSettings& settings, const std::string& cachePath);
+
+	// Traces the sets of the region containing tile and its neighbours which haven't been yet, tracing their rays in parallel and returning once they're done (eg. around the spawn at load)
+	// Regions already being traced by PrefetchRegionsAround are left to it
+	void PrepareRegionsAround(const MapData& map, const Vector2i& tile);
+
+	// As PrepareRegionsAround but traced by background tasks, so the calling frame never waits: regions report everything as visible until theirs is done. Call from one thread only.
+	void PrefetchRegionsAround(const MapData& map, const Vector2i& tile);
+
+	// Waits for any background traces, appends every region traced since the cache was read to it, then empties the set. Also done when destroyed or replaced.
+	void Unload();
+
+	bool IsBuilt() const { return m_regionCount > 0; }
+
+	// Returns true if the set still covers everything a raycaster using these limits can reach
+	bool IsValidFor(float viewDistance, int wallEncounterLimit) const;
+
+	// Returns -1 for tiles outside the grid
+	int GetRegionIndex(const Vector2i& tile) const;
+
+	// Returns true if anything in toRegion may be seen from anywhere in fromRegion. Unbuilt sets, invalid regions and fromRegions not yet traced report everything as visible.
+	bool IsRegionVisible(int fromRegion, int toRegion) const;
+
+	// eTileFlags of every tile in every region visible from region (all flags if unbuilt or not yet traced)
+	u8 GetVisibleTileFlags(int region) const;
+
+	// eTileFlags of every tile within region plus a one tile border around it (all flags if unbuilt), for traces which cannot leave that border
+	u8 GetLocalTileFlags(int region) const;
+
+private:
+	enum eRegionState : u8
+	{
+		REGION_UNTRACED,
+		REGION_TRACING,	// claimed by whichever thread is tracing it
+		REGION_READY,	// published with release ordering once its set is written, so readers acquiring it see the set
+	};
+
+	template <typename Function>
+	void ForEachRegionAround(const Vector2i& tile, Function function) const;
+	bool ClaimRegion(int region);
+	void TraceRegion(const MapData& map, int region);
+	bool IsRegionReady(int region) const { return m_regionStates[region].load(std::memory_order_acquire) == REGION_READY; }
+	void SetRegionVisible(int region, std::vector<u32>&& visibleRegions);
+	void WaitForPrefetches();
+	void Reset();
+	bool ReadCache();
+	void WriteCacheHeader() const;
+	void AppendUncachedRegions();
+	static u64 HashTileFlags(const MapData& map);
+
+	BuildSettings m_settings;
+	std::string m_cachePath;
+	u64 m_tileFlagsHash{ 0 };
+	int m_regionsX{ 0 };
+	int m_regionsY{ 0 };
+	int m_regionCount{ 0 };
+
+	// Visible regions of each traced region, sorted ascending. Each region's set and visible tile flags are only read once its state is REGION_READY.
+	std::unique_ptr<std::atomic<u8>[]> m_regionStates;
+	std::vector<std::vector<u32>> m_visibleRegions;
+	std::vector<u8> m_regionCached; // already in the cache file (only touched by the thread which owns the set)
+	std::vector<std::unique_ptr<Spear::TaskHandle>> m_prefetchTasks;
+
+	std::vector<u8> m_regionTileFlags;
+	std::vector<u8> m_visibleTileFlags;
+	std::vector<u8> m_localTileFlags;
+};
@@ -10,11 +10,40 @@ OLevelLink::OLevelLink()
 	m_collisionComp->ApplySetup(Collision::World, Collision::PROFILE_None, Collision::PROFILE_Characters, true);
 }
 
+void OLevelLink::OnCreated()
+{
+	SetTickEnabled(true);
+}
+
+void OLevelLink::OnTick(float /*deltaTime*/)
+{
+	if (m_bPrefetched || !m_linkedLevel.IsValid())
+	{
+		return;
+	}
+
+	GameState* pGameState = GameState::GetSafe();
+	if (pGameState && pGameState->player)
+	{
+		const Vector2f toPlayer = pGameState->player->GetPosition().XY() - GetPosition().XY();
+		if ((toPlayer.x * toPlayer.x) + (toPlayer.y * toPlayer.y) < PREFETCH_DISTANCE * PREFETCH_DISTANCE)
+		{
+			pGameState->levelStreamer.Prefetch(GetLinkedLevelName());
+			m_bPrefetched = true;
+		}
+	}
+}
+
+std::string OLevelLink::GetLinkedLevelName() const
+{
+	return m_linkedLevel.GetFilePath().path().filename().string();
+}
+
 void OLevelLink::OnOverlapBegin(CollisionComponent2D* other)
 {
 	// Since we can only overlap against Player channel, the player must have entered our space - request level transition
 	if(m_linkedLevel.IsValid())
 	{
-		GameState::Get().QueueLevelTransition(m_linkedLevel.GetFilePath().path().filename().string().c_str(), m_linkId, m_seamless ? other->GetOwner().GetPosition().XY() - GetPosition().XY() : Vector2f::ZeroVector);
+		GameState::Get().QueueLevelTransition(GetLinkedLevelName().c_str(), m_linkId, m_seamless ? other->GetOwner().GetPosition().XY() - GetPosition().XY() : Vector2f::ZeroVector);
 	}
 }
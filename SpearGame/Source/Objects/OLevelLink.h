@@ -11,12 +11,20 @@ class OLevelLink : public GameObject
 public:
 	OLevelLink();
 
+	virtual void OnCreated() override;
+	virtual void OnTick(float deltaTime) override;
 	virtual void OnOverlapBegin(CollisionComponent2D* other) override;
 
 	int GetLinkId() const {return m_linkId;}
 
 private:
+	std::string GetLinkedLevelName() const;
+
+	// Linked level starts streaming in once the player comes within this many tiles, so the transition itself doesn't need to load anything from disk
+	static constexpr float PREFETCH_DISTANCE{ 8.f };
+
 	CollisionComponentRadial* m_collisionComp{ nullptr };
+	bool m_bPrefetched{ false };
 
 	Spear::AssetProperty m_linkedLevel{"../Assets/MAPS/", ".level"};
 	int m_linkId{0};
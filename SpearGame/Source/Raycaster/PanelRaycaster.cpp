@@ -11,6 +11,13 @@ void PanelRaycaster::MakePanel()
 	{
 		ImGui::SliderInt("Internal Resolution (X)", &rayConfig.xResolution, 10, 4000);
 		ImGui::SliderInt("Internal Resolution (Y)", &rayConfig.yResolution, 10, 4000);
+		ImGui::Checkbox("Dynamic Resolution", &rayConfig.dynamicResolution);
+		if (rayConfig.dynamicResolution)
+		{
+			ImGui::SliderFloat("Target Frame Time (ms)", &rayConfig.dynamicResolutionTargetMs, 1.f, 50.f);
+			ImGui::SliderFloat("Minimum Resolution Scale", &rayConfig.dynamicResolutionMinScale, 0.25f, 1.f);
+			ImGui::Text("Rendering at %dx%d (scale %.2f)", Raycaster::GetResolution().x, Raycaster::GetResolution().y, Raycaster::m_dynamicResolution.scale);
+		}
 		ImGui::SliderFloat("Far Clip", &rayConfig.farClip, 1.f, 200.f);
 		ImGui::SliderFloat("Field Of View", &rayConfig.fieldOfView, 35.f, 120.f);
 		ImGui::SliderInt("Ray Encounter Limit", &rayConfig.rayEncounterLimit, 1, 50);
@@ -26,7 +33,14 @@ void PanelRaycaster::MakePanel()
 		ImGui::Checkbox("Software Rendering", &Raycaster::m_bSoftwareRendering);
 		if(Raycaster::m_bSoftwareRendering)
 		{
-			ImGui::SliderInt("Threads (Software Renderer)", &Raycaster::m_softwareRenderingThreads, 1, 32);
+			if (ImGui::Checkbox("SIMD Floor/Ceiling", &Raycaster::m_bSimdPlanes))
+			{
+				Raycaster::m_planesKernel = RaycastPlanesKernel::SelectPixels(Raycaster::m_bSimdPlanes);
+			}
+			ImGui::Checkbox("Column Rendering", &Raycaster::m_bColumnRendering);
+			ImGui::Checkbox("Mipmapped Textures", &Raycaster::m_bMipmapping);
+			ImGui::Checkbox("Half-Rate Floor/Ceiling", &Raycaster::m_bHalfRatePlanes);
+			ImGui::Checkbox("Fixed-Point DDA", &Raycaster::m_bFixedPointDDA);
 		}
 	}
 	ImGui::PopItemWidth();
@@ -0,0 +1,203 @@
+#include "RaycastPlanesKernel.h"
+#include "Core/CpuFeatures.h"
+
+#if !defined(SPEAR_DISABLE_SIMD) && (defined(_M_X64) || defined(__x86_64__))
+#include <immintrin.h>
+#define SPEAR_PLANES_AVX2
+#if defined(_MSC_VER)
+#define SPEAR_TARGET_AVX2
+#else
+#define SPEAR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Kernels address GridNode as an array of ints so texture ids can be gathered directly
+static_assert(sizeof(GridNode) % sizeof(int) == 0);
+static constexpr int GRIDNODE_STRIDE{ sizeof(GridNode) / sizeof(int) };
+
+#ifdef SPEAR_PLANES_AVX2
+// Depth is carried through the AVX2 kernel as 8 x 32-bit lanes, whatever its storage format
+SPEAR_TARGET_AVX2 static __m256i BroadcastDepth(Spear::BackgroundDepth depth)
+{
+#ifdef SPEAR_DEPTH16
+	return _mm256_set1_epi32(depth);
+#else
+	return _mm256_castps_si256(_mm256_set1_ps(depth));
+#endif
+}
+
+SPEAR_TARGET_AVX2 static void StoreDepth(Spear::BackgroundDepth* pOut, __m256i depth)
+{
+#ifdef SPEAR_DEPTH16
+	// Narrow to 16-bit (packus works per 128-bit half, so gather both halves' results into the low 128 bits)
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(depth, depth), 0b1000);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm256_castsi256_si128(packed));
+#else
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(pOut), depth);
+#endif
+}
+#endif
+
+RaycastPlanesKernel::RowFunction RaycastPlanesKernel::Select(bool bAllowSimd)
+{
+#ifdef SPEAR_PLANES_AVX2
+	if (bAllowSimd && Spear::CpuFeatures::HasAVX2())
+	{
+		return &DrawRowAVX2;
+	}
+#endif
+	return &DrawRowScalar;
+}
+
+RaycastPlanesKernel::PixelsFunction RaycastPlanesKernel::SelectPixels(bool bAllowSimd)
+{
+#ifdef SPEAR_PLANES_AVX2
+	if (bAllowSimd && Spear::CpuFeatures::HasAVX2())
+	{
+		return &DrawPixelsAVX2;
+	}
+#endif
+	return &DrawPixelsScalar;
+}
+
+void RaycastPlanesKernel::DrawRowScalar(const PlaneRowParams& params)
+{
+	DrawPixelsScalar(params, 0, params.pixelCount);
+}
+
+void RaycastPlanesKernel::DrawPixelsScalar(const PlaneRowParams& params, int xStart, int xEnd)
+{
+	const int* pNodeInts = reinterpret_cast<const int*>(params.pNodes);
+	const int layerTexels[2]{ params.texWidth[0] * params.texHeight[0], params.texWidth[1] * params.texHeight[1] };
+
+	for (int x = xStart; x < xEnd; x++)
+	{
+		params.pOutRGBA[x] = 0;
+		params.pOutDepth[x] = params.clearDepth;
+		for (int layer = 0; layer < 2; layer++)
+		{
+			// Sample point calculated from pixel index (not accumulated) so every kernel produces the same result
+			const float sampleX = params.rayEnd[layer].x + params.rayStep[layer].x * static_cast<float>(x);
+			const float sampleY = params.rayEnd[layer].y + params.rayStep[layer].y * static_cast<float>(x);
+			const int mapCellX = static_cast<int>(sampleX);
+			const int mapCellY = static_cast<int>(sampleY);
+			if (mapCellX < 0 || mapCellX >= params.gridWidth || mapCellY < 0 || mapCellY >= params.gridHeight)
+			{
+				continue;
+			}
+
+			const int nodeIndex = (params.pChunkSlots[(mapCellX >> MAP_CHUNK_SHIFT) + ((mapCellY >> MAP_CHUNK_SHIFT) * params.chunksX)] * MAP_CHUNK_NODES) + (mapCellX & MAP_CHUNK_MASK) + ((mapCellY & MAP_CHUNK_MASK) << MAP_CHUNK_SHIFT);
+			const int texId = pNodeInts[(nodeIndex * GRIDNODE_STRIDE) + params.texIdOffset[layer]];
+			if (texId == eLevelTextures::TEX_NONE)
+			{
+				continue;
+			}
+
+			int texX = static_cast<int>((sampleX - static_cast<float>(mapCellX)) * static_cast<float>(params.texWidth[layer]));
+			int texY = static_cast<int>((sampleY - static_cast<float>(mapCellY)) * static_cast<float>(params.texHeight[layer]));
+			if (texX < 0)
+				texX += params.texWidth[layer];
+			if (texY < 0)
+				texY += params.texHeight[layer];
+
+			ASSERT(texX < params.texWidth[layer]);
+			ASSERT(texY < params.texHeight[layer]);
+			params.pOutRGBA[x] = params.pTexels[layer][(texId * layerTexels[layer]) + texX + (texY * params.texWidth[layer])];
+			params.pOutDepth[x] = params.rayDepth[layer];
+
+			// We're drawing the floors nearest-first, so no need to calculate pixels BEHIND this
+			break;
+		}
+	}
+}
+
+void RaycastPlanesKernel::DrawRowAVX2(const PlaneRowParams& params)
+{
+	DrawPixelsAVX2(params, 0, params.pixelCount);
+}
+
+#ifdef SPEAR_PLANES_AVX2
+SPEAR_TARGET_AVX2 void RaycastPlanesKernel::DrawPixelsAVX2(const PlaneRowParams& params, int xStart, int xEnd)
+{
+	const int* pNodeInts = reinterpret_cast<const int*>(params.pNodes);
+
+	const __m256 laneOffsets = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+	const __m256i gridWidth = _mm256_set1_epi32(params.gridWidth);
+	const __m256i chunksX = _mm256_set1_epi32(params.chunksX);
+	const __m256i chunkMask = _mm256_set1_epi32(MAP_CHUNK_MASK);
+	const __m256i gridHeight = _mm256_set1_epi32(params.gridHeight);
+	const __m256i minusOne = _mm256_set1_epi32(-1);
+	const __m256i nodeStride = _mm256_set1_epi32(GRIDNODE_STRIDE);
+	const __m256i texNone = _mm256_set1_epi32(eLevelTextures::TEX_NONE);
+
+	const int vectorEnd = xStart + ((xEnd - xStart) & ~7);
+	for (int x = xStart; x < vectorEnd; x += 8)
+	{
+		const __m256 pixelIndex = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+		__m256i colour = _mm256_setzero_si256();
+		__m256i depth = BroadcastDepth(params.clearDepth);
+		__m256i pending = minusOne; // lanes which have not yet found a texture
+
+		for (int layer = 0; layer < 2; layer++)
+		{
+			const __m256 sampleX = _mm256_add_ps(_mm256_set1_ps(params.rayEnd[layer].x), _mm256_mul_ps(_mm256_set1_ps(params.rayStep[layer].x), pixelIndex));
+			const __m256 sampleY = _mm256_add_ps(_mm256_set1_ps(params.rayEnd[layer].y), _mm256_mul_ps(_mm256_set1_ps(params.rayStep[layer].y), pixelIndex));
+			const __m256i mapCellX = _mm256_cvttps_epi32(sampleX);
+			const __m256i mapCellY = _mm256_cvttps_epi32(sampleY);
+
+			// Bounds check against grid, then gather texture ids for in-bounds lanes only
+			__m256i lanes = _mm256_and_si256(pending, _mm256_and_si256(_mm256_cmpgt_epi32(mapCellX, minusOne), _mm256_cmpgt_epi32(gridWidth, mapCellX)));
+			lanes = _mm256_and_si256(lanes, _mm256_and_si256(_mm256_cmpgt_epi32(mapCellY, minusOne), _mm256_cmpgt_epi32(gridHeight, mapCellY)));
+
+			// Look up each lane's chunk slot, then index within the chunk
+			const __m256i chunkIndex = _mm256_add_epi32(_mm256_srli_epi32(mapCellX, MAP_CHUNK_SHIFT), _mm256_mullo_epi32(_mm256_srli_epi32(mapCellY, MAP_CHUNK_SHIFT), chunksX));
+			const __m256i chunkSlot = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), params.pChunkSlots, chunkIndex, lanes, 4);
+			const __m256i chunkOffset = _mm256_add_epi32(_mm256_and_si256(mapCellX, chunkMask), _mm256_slli_epi32(_mm256_and_si256(mapCellY, chunkMask), MAP_CHUNK_SHIFT));
+			const __m256i nodeIndex = _mm256_add_epi32(_mm256_slli_epi32(chunkSlot, 2 * MAP_CHUNK_SHIFT), chunkOffset);
+			const __m256i texIdIndex = _mm256_add_epi32(_mm256_mullo_epi32(nodeIndex, nodeStride), _mm256_set1_epi32(params.texIdOffset[layer]));
+			const __m256i texId = _mm256_mask_i32gather_epi32(texNone, pNodeInts, texIdIndex, lanes, 4);
+			const __m256i hit = _mm256_andnot_si256(_mm256_cmpeq_epi32(texId, texNone), lanes);
+			if (_mm256_testz_si256(hit, hit))
+			{
+				continue;
+			}
+
+			// Each layer samples its own mip level
+			const int* pTexels = reinterpret_cast<const int*>(params.pTexels[layer]);
+			const __m256i texWidth = _mm256_set1_epi32(params.texWidth[layer]);
+			const __m256i texHeight = _mm256_set1_epi32(params.texHeight[layer]);
+			const __m256 texWidthF = _mm256_set1_ps(static_cast<float>(params.texWidth[layer]));
+			const __m256 texHeightF = _mm256_set1_ps(static_cast<float>(params.texHeight[layer]));
+			const __m256i layerTexels = _mm256_set1_epi32(params.texWidth[layer] * params.texHeight[layer]);
+
+			__m256i texX = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(sampleX, _mm256_cvtepi32_ps(mapCellX)), texWidthF));
+			__m256i texY = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(sampleY, _mm256_cvtepi32_ps(mapCellY)), texHeightF));
+			texX = _mm256_add_epi32(texX, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), texX), texWidth));
+			texY = _mm256_add_epi32(texY, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), texY), texHeight));
+
+			const __m256i texelIndex = _mm256_add_epi32(_mm256_mullo_epi32(texId, layerTexels), _mm256_add_epi32(texX, _mm256_mullo_epi32(texY, texWidth)));
+			const __m256i texel = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), pTexels, texelIndex, hit, 4);
+
+			colour = _mm256_or_si256(colour, texel);
+			depth = _mm256_blendv_epi8(depth, BroadcastDepth(params.rayDepth[layer]), hit);
+			pending = _mm256_andnot_si256(hit, pending);
+
+			if (_mm256_testz_si256(pending, pending))
+			{
+				break;
+			}
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(params.pOutRGBA + x), colour);
+		StoreDepth(params.pOutDepth + x, depth);
+	}
+
+	DrawPixelsScalar(params, vectorEnd, xEnd);
+}
+#else
+void RaycastPlanesKernel::DrawPixelsAVX2(const PlaneRowParams& params, int xStart, int xEnd)
+{
+	// Not available in this build, Select/SelectPixels never return this
+	DrawPixelsScalar(params, xStart, xEnd);
+}
+#endif
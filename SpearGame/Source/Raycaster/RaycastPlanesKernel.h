@@ -0,0 +1,48 @@
+#pragma once
+#include "LevelData.h"
+#include "Graphics/ScreenRenderer.h"
+
+// Inputs for drawing one screen row of floor/ceiling, where each layer's sample point is an affine walk across the row
+struct PlaneRowParams
+{
+	const GridNode* pNodes{ nullptr };	// chunked, see MapData::NodeIndex
+	const int* pChunkSlots{ nullptr };
+	int chunksX{ 0 };
+	int gridWidth{ 0 };
+	int gridHeight{ 0 };
+	int texIdOffset[2]{};				// offset (in ints) of the texture id to sample within GridNode, per layer
+
+	const u32* pTexels[2]{};			// every layer of the mip level of the map's texture array chosen for each layer's distance (see TextureBase::GetTexelsRGBAMip)
+	int texWidth[2]{};
+	int texHeight[2]{};
+
+	Vector2f rayEnd[2];					// sample point for the first pixel in the row, per layer
+	Vector2f rayStep[2];				// sample point offset between adjacent pixels, per layer
+	Spear::BackgroundDepth rayDepth[2]{};
+	Spear::BackgroundDepth clearDepth{};	// written (with a colour of 0) to pixels where no layer has a texture
+
+	GLuint* pOutRGBA{ nullptr };		// first pixel of the row
+	Spear::BackgroundDepth* pOutDepth{ nullptr };
+	int pixelCount{ 0 };
+};
+
+// Floor/ceiling row kernels for maps without portals. Nearest layer wins, identical output from every variant.
+// Every pixel in the row is written, so the output row does not need clearing beforehand.
+class RaycastPlanesKernel
+{
+	NO_CONSTRUCT(RaycastPlanesKernel);
+
+public:
+	using RowFunction = void(*)(const PlaneRowParams&);
+	using PixelsFunction = void(*)(const PlaneRowParams&, int xStart, int xEnd); // draws pixels [xStart, xEnd) of the row
+
+	// Return the widest kernel supported by this build and CPU, or the scalar kernel if SIMD is not allowed
+	static RowFunction Select(bool bAllowSimd);
+	static PixelsFunction SelectPixels(bool bAllowSimd);
+
+	static void DrawRowScalar(const PlaneRowParams& params);
+	static void DrawRowAVX2(const PlaneRowParams& params); // 8 pixels per iteration, CPU must support AVX2
+
+	static void DrawPixelsScalar(const PlaneRowParams& params, int xStart, int xEnd);
+	static void DrawPixelsAVX2(const PlaneRowParams& params, int xStart, int xEnd);
+};
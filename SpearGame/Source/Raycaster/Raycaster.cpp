@@ -8,28 +8,61 @@
 
 #include "Raycaster.h"
 #include "RaycasterConfig.h"
+#include "RaycastPlanesKernel.h"
 #include "LevelFileManager.h"
 #include "GlobalTextureBatches.h"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 PanelRaycaster Raycaster::debugPanel;
 
 GLuint* Raycaster::m_bgTexRGBA{nullptr};
-GLfloat* Raycaster::m_bgTexDepth{nullptr};
+Spear::BackgroundDepth* Raycaster::m_bgTexDepth{nullptr};
+GLuint* Raycaster::m_localTexRGBA{nullptr};
+Spear::BackgroundDepth* Raycaster::m_localTexDepth{nullptr};
 MapData* Raycaster::m_map{ nullptr };
 RaycasterConfig Raycaster::m_rayConfig;
-RaycastSprite Raycaster::m_sprites[Raycaster::RAYCAST_SPRITE_LIMIT];
+Vector2i Raycaster::m_maxResolution{ RaycasterConfig().xResolution, RaycasterConfig().yResolution };
+Raycaster::DynamicResolutionState Raycaster::m_dynamicResolution;
+std::vector<RaycastSprite> Raycaster::m_sprites;
 int Raycaster::m_spriteCount{0};
 Raycaster::RaycastFrameData Raycaster::m_frame;
-Raycaster::RaycastSpriteData Raycaster::m_frameSprites[RAYCAST_SPRITE_LIMIT];
+std::vector<Raycaster::RaycastSpriteData> Raycaster::m_frameSprites;
+std::vector<Raycaster::SpriteCloneCandidate> Raycaster::m_spriteCloneCandidates;
 int Raycaster::m_numSpritesToRender{0};
+int Raycaster::m_spriteTilesX{0};
+int Raycaster::m_spriteTilesY{0};
+std::vector<int> Raycaster::m_spriteBinStarts;
+std::vector<int> Raycaster::m_spriteBinSprites;
 
 Raycaster::RaycastComputeShader Raycaster::m_computeShader;
 bool Raycaster::m_bSoftwareRendering{true};
-int Raycaster::m_softwareRenderingThreads{30};
+bool Raycaster::m_bSimdPlanes{true};
+RaycastPlanesKernel::PixelsFunction Raycaster::m_planesKernel{RaycastPlanesKernel::SelectPixels(true)};
+bool Raycaster::m_bColumnRendering{false};
+bool Raycaster::m_bMipmapping{true};
+bool Raycaster::m_bHalfRatePlanes{false};
+bool Raycaster::m_bFixedPointDDA{false};
+Raycaster::PlaneHistory Raycaster::m_planeHistory;
+PlaneRowParams* Raycaster::m_planeRows{nullptr};
 
 bool Raycaster::m_bPortalRenderingEnabled{true};
+u8 Raycaster::m_mapWallFeatures{0};
 Raycaster::PortalTraces* Raycaster::m_portalTraces{nullptr};
+Raycaster::PortalSearch* Raycaster::m_portalSearches{nullptr};
+Raycaster::PortalTraceView Raycaster::m_portalTraceView;
+bool Raycaster::m_bPortalTracesValid{false};
+std::vector<Raycaster::PortalWindow> Raycaster::m_portalWindows;
+Vector2f Raycaster::m_mirrorBoundsMin;
+Vector2f Raycaster::m_mirrorBoundsMax;
+std::vector<u8> Raycaster::m_mirrorHalo;
+Vector2i Raycaster::m_mirrorHaloMin;
+Vector2i Raycaster::m_mirrorHaloSize;
+
+Raycaster::RaycastFrameStats Raycaster::m_frameStats;
+u64 Raycaster::m_phaseStartTimestamps[PHASE_TOTAL]{};
+bool Raycaster::m_bOutputChecksumEnabled{false};
 
 Vector2f Raycaster::PortalTraces::GetPointAtTraceDistance(float distance) const
 {
@@ -52,84 +85,228 @@ Vector2f Raycaster::PortalTraces::GetPointAtTraceDistance(float distance) const
 constexpr float FOV_MIN{ 35.f };
 constexpr float FOV_MAX{ 120.f };
 
+// Half-rate planes render every row instead once the camera moves further than this between frames
+constexpr float PLANE_REPROJECT_MAX_MOVE{ 0.5f };	// tiles
+constexpr float PLANE_REPROJECT_MAX_TURN{ 0.1f };	// radians
+constexpr float PLANE_REPROJECT_MAX_PITCH{ 0.1f };	// fraction of yResolution
+constexpr float PLANE_REPROJECT_MIN_DEPTH{ 0.01f };	// points nearer than this to the previous camera are sampled instead
+
+// Portal traces are reused while the view moves/turns less than this (well under a texel anywhere on screen)
+constexpr float PORTAL_TRACE_REUSE_MOVE{ 1.f / 1024.f };	// tiles
+constexpr float PORTAL_TRACE_REUSE_TURN{ 1e-5f };		// change in (unit) fov edge vectors
+constexpr float PORTAL_TRACE_REFRESH_MOVE{ 0.5f };		// tiles a column's traces may drift from where they were last searched and still be re-solved (must stay under 1, see IsPortalTraceClear)
+constexpr int PORTAL_TRACE_REFRESH_BACKOFF{ 15 };		// most frames a column goes without trying to refresh its traces
+constexpr float MIRROR_BOUNDS_MARGIN{ 0.01f };			// tiles
+
+// Sprites seen through mirrors/portals
+constexpr float PORTAL_WINDOW_UNFOLD_TOLERANCE{ 0.01f };	// tiles, neighbouring columns unfolding closer than this share a window
+constexpr int SPRITE_PORTAL_CLONE_LIMIT{ 256 };			// per frame
+
+// Dynamic resolution controller
+constexpr float DYNAMIC_RESOLUTION_SCALE_FLOOR{ 0.25f };	// lowest dynamicResolutionMinScale accepted
+constexpr float DYNAMIC_RESOLUTION_SMOOTHING{ 0.1f };		// weight of the newest frame in the frame time average
+constexpr int DYNAMIC_RESOLUTION_SETTLE_FRAMES{ 15 };		// frames to wait after a change before judging the new resolution
+constexpr float DYNAMIC_RESOLUTION_MAX_STEP{ 0.1f };		// largest change in scale per adjustment
+constexpr float DYNAMIC_RESOLUTION_AIM{ 0.85f };			// fraction of the target aimed for, so small spikes don't immediately exceed it
+constexpr float DYNAMIC_RESOLUTION_RAISE_BELOW{ 0.7f };	// only scale up once frames are this far under the target (stops oscillating around it)
+constexpr int DYNAMIC_RESOLUTION_WIDTH_STEP{ 8 };			// scaled widths snap down to a multiple of this (the AVX2 plane kernel's width, so rows have no scalar tail)
+
+// Screen tiles sprites are binned into. Sprite columns are drawn top to bottom, so tiles are wider than they are tall to keep each column's run long.
+constexpr int SPRITE_TILE_WIDTH{ 64 };
+constexpr int SPRITE_TILE_HEIGHT{ 32 };
+
 void Raycaster::RecreateBackgroundArrays(int width, int height)
 {
-	delete[] m_bgTexRGBA;
-	m_bgTexRGBA = new GLuint[width * height];
-	std::fill(m_bgTexRGBA, m_bgTexRGBA + (width * height), GLuint(0));
-
-	delete[] m_bgTexDepth;
-	m_bgTexDepth = new GLfloat[width * height];
-	std::fill(m_bgTexDepth, m_bgTexDepth + (width * height), GLfloat(m_rayConfig.farClip));
+	delete[] m_localTexRGBA;
+	m_localTexRGBA = new GLuint[width * height];
+	std::fill(m_localTexRGBA, m_localTexRGBA + (width * height), GLuint(0));
+	m_bgTexRGBA = m_localTexRGBA;
+
+	delete[] m_localTexDepth;
+	m_localTexDepth = new Spear::BackgroundDepth[width * height];
+	std::fill(m_localTexDepth, m_localTexDepth + (width * height), Spear::ToBackgroundDepth(m_rayConfig.farClip));
+	m_bgTexDepth = m_localTexDepth;
 	
 	delete[] m_portalTraces;
 	m_portalTraces = new PortalTraces[width];
+	delete[] m_portalSearches;
+	m_portalSearches = new PortalSearch[width];
+	m_bPortalTracesValid = false;
+
+	delete[] m_planeRows;
+	m_planeRows = new PlaneRowParams[height];
+
+	for (int i = 0; i < 2; i++)
+	{
+		delete[] m_planeHistory.pRGBA[i];
+		m_planeHistory.pRGBA[i] = new GLuint[width * height];
+		delete[] m_planeHistory.pLayerIds[i];
+		m_planeHistory.pLayerIds[i] = new u8[width * height];
+	}
+	m_planeHistory.bValid = false;
 }
 
 void Raycaster::ClearRaycasterArrays()
 {
-	std::fill(m_bgTexRGBA, m_bgTexRGBA + (m_rayConfig.xResolution * m_rayConfig.yResolution), GLuint(0));
-	std::fill(m_bgTexDepth, m_bgTexDepth + (m_rayConfig.xResolution * m_rayConfig.yResolution), GLfloat(m_rayConfig.farClip));
+	// Several MB at high resolutions, so split across threads
+	auto ClearRowsTask = [](int yLowerBound, int yUpperBound)
+	{
+		ClearRows(yLowerBound, yUpperBound);
+	};
+	Spear::ServiceLocator::GetThreadManager().ParallelFor(0, m_rayConfig.yResolution, Spear::ThreadManager::AUTO_GRAIN, ClearRowsTask);
+}
+
+void Raycaster::ClearRows(int yLowerBound, int yUpperBound)
+{
+	const int first = yLowerBound * m_rayConfig.xResolution;
+	const int last = yUpperBound * m_rayConfig.xResolution;
+	std::fill(m_bgTexRGBA + first, m_bgTexRGBA + last, GLuint(0));
+	std::fill(m_bgTexDepth + first, m_bgTexDepth + last, Spear::ToBackgroundDepth(m_rayConfig.farClip));
 }
 
-int Raycaster::XResolutionPerThread()
+int Raycaster::TileFlagsBufferSize()
 {
-	return m_rayConfig.xResolution / m_softwareRenderingThreads;
+	// Shaders read tile flags as an array of uints (4 tiles each), so round up to a whole number of uints
+	return ((m_map->ResidentNodes() + 3) / 4) * 4;
 }
 
-int Raycaster::YResolutionPerThread()
+void Raycaster::UploadMapToGPU()
 {
-	return m_rayConfig.yResolution / m_softwareRenderingThreads;
+	// Only resident chunks (plus the shared empty chunk) are uploaded, shaders find them through the chunk slot table
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.gridnodesSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_map->ResidentNodes() * sizeof(GridNode), m_map->pNodes, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.tileFlagsSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, TileFlagsBufferSize(), m_map->pTileFlags, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.chunkSlotsSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_map->chunksX * m_map->chunksY * sizeof(int), m_map->pChunkSlots, GL_STATIC_DRAW);
 }
 
 void Raycaster::Init(MapData& map)
 {
 	if (m_bgTexRGBA == nullptr)
 	{
-		RecreateBackgroundArrays(m_rayConfig.xResolution, m_rayConfig.yResolution);
+		RecreateBackgroundArrays(m_maxResolution.x, m_maxResolution.y);
 	}
 	m_map = &map;
+	m_planeHistory.bValid = false;
+	m_bPortalTracesValid = false;
 	
+	// Leave out whichever optional features the map never uses from the renderer (see SelectWallColumn)
 	m_bPortalRenderingEnabled = false;
-	for (int i = 0; i < m_map->TotalNodes(); i++)
+	m_mapWallFeatures = 0;
+	for (int i = 0; i < m_map->ResidentNodes(); i++)
 	{
-		const int specialFlag = m_map->pNodes[i].specialFlag;
-		if (specialFlag == SPECIAL_MIRROR || specialFlag == SPECIAL_MIRROR_PORTAL || specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
+		if (m_map->pTileFlags[i] & TILE_ANY_MIRROR)
 		{
 			m_bPortalRenderingEnabled = true;
-			break;
+		}
+		if (m_map->pNodes[i].drawFlags != DRAW_DEFAULT)
+		{
+			m_mapWallFeatures |= WALL_DRAW_FLAGS;
+		}
+		if (m_map->pNodes[i].extendUp > 0 || m_map->pNodes[i].extendDown > 0)
+		{
+			m_mapWallFeatures |= WALL_MULTI_STOREY;
 		}
 	}
+	BuildMirrorBounds();
 
-	ApplyConfig(m_rayConfig);
+	ApplyConfig(GetConfigCopy());
 
 	if (m_computeShader.isInitialised)
 	{
-		// Resize the GPU buffer for GridNodes using new map's size
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.gridnodesSSBO);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, m_map->TotalNodes() * sizeof(GridNode), m_map->pNodes, GL_STATIC_DRAW);
+		UploadMapToGPU();
 	}
 
+	Spear::Renderer::Get().ReserveBackgroundResolution(m_maxResolution.x, m_maxResolution.y);
 	Spear::Renderer::Get().SetBackgroundTextureDataRGBA(m_bgTexRGBA, m_bgTexDepth, m_rayConfig.xResolution, m_rayConfig.yResolution, true);
 }
 
 RaycasterConfig Raycaster::GetConfigCopy()
 {
-	return m_rayConfig;
+	// Report the configured resolution rather than whatever dynamic resolution is currently rendering at
+	RaycasterConfig config = m_rayConfig;
+	config.xResolution = m_maxResolution.x;
+	config.yResolution = m_maxResolution.y;
+	return config;
 }
 
 void Raycaster::ApplyConfig(const RaycasterConfig& config)
 { 
-	if (config.xResolution != m_rayConfig.xResolution || config.yResolution != m_rayConfig.yResolution)
+	// Buffers are only ever sized for the configured resolution, so dynamic resolution never reallocates
+	if (config.xResolution != m_maxResolution.x || config.yResolution != m_maxResolution.y)
 	{
 		RecreateBackgroundArrays(config.xResolution, config.yResolution);
+		m_maxResolution = Vector2i(config.xResolution, config.yResolution);
+		Spear::Renderer::Get().ReserveBackgroundResolution(m_maxResolution.x, m_maxResolution.y);
 	}
 
+	const Vector2i resolution = GetResolution();
 	m_rayConfig = config;
+	m_rayConfig.xResolution = resolution.x;
+	m_rayConfig.yResolution = resolution.y;
 	m_rayConfig.fieldOfView = std::clamp(m_rayConfig.fieldOfView, FOV_MIN, FOV_MAX);
+	m_rayConfig.dynamicResolutionMinScale = std::clamp(m_rayConfig.dynamicResolutionMinScale, DYNAMIC_RESOLUTION_SCALE_FLOOR, 1.f);
+	if (!m_rayConfig.dynamicResolution)
+	{
+		m_dynamicResolution = DynamicResolutionState();
+	}
+	m_dynamicResolution.scale = std::clamp(m_dynamicResolution.scale, m_rayConfig.dynamicResolutionMinScale, 1.f);
+	ApplyResolutionScale();
 	ApplyFovModifier(0.f);
 }
 
+void Raycaster::ApplyResolutionScale()
+{
+	const int scaledWidth = static_cast<int>(std::lround(m_maxResolution.x * m_dynamicResolution.scale));
+	const int width = std::clamp(scaledWidth - (scaledWidth % DYNAMIC_RESOLUTION_WIDTH_STEP), std::min(DYNAMIC_RESOLUTION_WIDTH_STEP, m_maxResolution.x), m_maxResolution.x);
+	const int height = std::clamp(static_cast<int>(std::lround(m_maxResolution.y * m_dynamicResolution.scale)), 1, m_maxResolution.y);
+	if (width != m_rayConfig.xResolution || height != m_rayConfig.yResolution)
+	{
+		// Rows/columns no longer line up with last frame's
+		m_planeHistory.bValid = false;
+	}
+	m_rayConfig.xResolution = width;
+	m_rayConfig.yResolution = height;
+}
+
+void Raycaster::UpdateDynamicResolution(float frameMs)
+{
+	if (!m_rayConfig.dynamicResolution)
+	{
+		return;
+	}
+
+	DynamicResolutionState& state = m_dynamicResolution;
+	state.averageFrameMs = state.averageFrameMs > 0.f ? state.averageFrameMs + ((frameMs - state.averageFrameMs) * DYNAMIC_RESOLUTION_SMOOTHING) : frameMs;
+	if (++state.framesSinceChange < DYNAMIC_RESOLUTION_SETTLE_FRAMES)
+	{
+		return;
+	}
+
+	const float targetMs = m_rayConfig.dynamicResolutionTargetMs;
+	if (state.averageFrameMs <= targetMs && state.averageFrameMs >= targetMs * DYNAMIC_RESOLUTION_RAISE_BELOW)
+	{
+		return;
+	}
+
+	// Cost is dominated by per-pixel work, which goes with the square of the scale
+	const float idealScale = state.scale * sqrt((targetMs * DYNAMIC_RESOLUTION_AIM) / std::max(state.averageFrameMs, 0.01f));
+	const float scale = std::clamp(std::clamp(idealScale, state.scale - DYNAMIC_RESOLUTION_MAX_STEP, state.scale + DYNAMIC_RESOLUTION_MAX_STEP), m_rayConfig.dynamicResolutionMinScale, 1.f);
+	if (scale == state.scale)
+	{
+		return;
+	}
+
+	// Predict the new average rather than waiting for it to drift there
+	state.averageFrameMs *= (scale * scale) / (state.scale * state.scale);
+	state.scale = scale;
+	state.framesSinceChange = 0;
+	ApplyResolutionScale();
+}
+
 void Raycaster::ApplyFovModifier(float fovModifier)
 {
 	// Calculate new fov
@@ -192,9 +369,76 @@ MapData* Raycaster::GetMap()
 	return m_map;
 }
 
+const Raycaster::RaycastFrameStats& Raycaster::GetLastFrameStats()
+{
+	return m_frameStats;
+}
+
+void Raycaster::SetOutputChecksumEnabled(bool bEnabled)
+{
+	m_bOutputChecksumEnabled = bEnabled;
+}
+
+void Raycaster::SetColumnRenderingEnabled(bool bEnabled)
+{
+	m_bColumnRendering = bEnabled;
+}
+
+void Raycaster::SetMipmappingEnabled(bool bEnabled)
+{
+	m_bMipmapping = bEnabled;
+}
+
+void Raycaster::SetHalfRatePlanesEnabled(bool bEnabled)
+{
+	m_bHalfRatePlanes = bEnabled;
+}
+
+void Raycaster::SetFixedPointDDAEnabled(bool bEnabled)
+{
+	m_bFixedPointDDA = bEnabled;
+}
+
+void Raycaster::StartPhase(eRaycastPhase phase)
+{
+	START_PROFILE(PHASE_NAMES[phase])
+	m_phaseStartTimestamps[phase] = SDL_GetPerformanceCounter();
+}
+
+void Raycaster::EndPhase(eRaycastPhase phase)
+{
+	m_frameStats.phaseMs[phase] = 1000.f * (static_cast<float>(SDL_GetPerformanceCounter() - m_phaseStartTimestamps[phase]) / SDL_GetPerformanceFrequency());
+	END_PROFILE(PHASE_NAMES[phase])
+}
+
+u64 Raycaster::CalculateOutputChecksum()
+{
+	// FNV-1a over colour then depth, so any change to the final image (or its depth) changes the result
+	constexpr u64 fnvOffsetBasis{ 14695981039346656037ull };
+	constexpr u64 fnvPrime{ 1099511628211ull };
+	const int pixelCount = m_rayConfig.xResolution * m_rayConfig.yResolution;
+
+	u64 hash = fnvOffsetBasis;
+	auto HashBytes = [&hash](const void* pData, size_t bytes)
+	{
+		const u8* pBytes = static_cast<const u8*>(pData);
+		for (size_t i = 0; i < bytes; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= fnvPrime;
+		}
+	};
+	HashBytes(m_bgTexRGBA, pixelCount * sizeof(GLuint));
+	HashBytes(m_bgTexDepth, pixelCount * sizeof(Spear::BackgroundDepth));
+	return hash;
+}
+
 RaycastSprite& Raycaster::MakeSprite()
 {
-	ASSERT(m_spriteCount < RAYCAST_SPRITE_LIMIT);
+	if (m_spriteCount == static_cast<int>(m_sprites.size()))
+	{
+		m_sprites.emplace_back();
+	}
 	return m_sprites[m_spriteCount++];
 }
 
@@ -231,12 +475,17 @@ void Raycaster::Draw2DGrid(const Vector2f& pos, const float angle)
 	// Draw tiles
 	constexpr float tiledepthOpacities[3] = {1.f, 0.7f, 0.5f};	
 	const float tileScaleFactor = 1.f / (Spear::Renderer::Get().GetBatchTextures(GlobalTextureBatches::BATCH_TILESET_1)->GetWidth() / 64.f);
-	for (int x = 0; x < m_map->gridWidth; x++)
+	// Only submit tiles which overlap the window, so large maps don't flood the sprite batch
+	const Vector2f windowSize = Spear::Core::GetWindowSize().ToFloat();
+	const int xFirst = std::max(0, static_cast<int>(std::floor(-camOffset.x / m_rayConfig.scale2D)) - 1);
+	const int yFirst = std::max(0, static_cast<int>(std::floor(-camOffset.y / m_rayConfig.scale2D)) - 1);
+	const int xLast = std::min(m_map->gridWidth, static_cast<int>(std::ceil((windowSize.x - camOffset.x) / m_rayConfig.scale2D)) + 1);
+	const int yLast = std::min(m_map->gridHeight, static_cast<int>(std::ceil((windowSize.y - camOffset.y) / m_rayConfig.scale2D)) + 1);
+	for (int x = xFirst; x < xLast; x++)
 	{
-		for (int y = 0; y < m_map->gridHeight; y++)
+		for (int y = yFirst; y < yLast; y++)
 		{
-			const int nodeIndex = x + (y * m_map->gridWidth);
-			GridNode& node = m_map->pNodes[nodeIndex];
+			const GridNode& node = m_map->pNodes[m_map->NodeIndex(x, y)];
 
 			int texId = node.texIdWall;
 			int tileDepth = 0;
@@ -292,184 +541,134 @@ void Raycaster::Draw2DGrid(const Vector2f& pos, const float angle)
 	
 	// Using DDA (digital differential analysis) to quickly calculate intersections
 	int maxRays{ 500 };
-	Spear::Renderer::LineData line;
-	line.depth = depthPlayer;
 	for(int x = 0; x < maxRays; x++)
 	{
-		Vector2f rayStart = pos;
-		Vector2f rayEnd{ fovLeftExtent - (raySpacingDir * raySpacing * (x * m_rayConfig.xResolution / maxRays)) };
-		Vector2f rayDir = Normalize(rayEnd - rayStart);
-
-		Vector2f rayUnitStepSize{ sqrt(1 + (rayDir.y / rayDir.x) * (rayDir.y / rayDir.x)),		// length required to travel 1 X unit in Ray Direction
-									sqrt(1 + (rayDir.x / rayDir.y) * (rayDir.x / rayDir.y)) };	// length required to travel 1 Y unit in Ray Direction
-
-		Vector2i mapCheck = rayStart.ToInt(); // truncation will 'snap' position to tile
-		Vector2f rayLength1D; // total length of ray: via x units, via y units
-		Vector2i step;
-
-		// ====================================
-		// PREPARE INITIAL RAY LENGTH/DIRECTION
-		// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
-		if (rayDir.x < 0)
+		const Vector2f rayEnd{ fovLeftExtent - (raySpacingDir * raySpacing * (x * m_rayConfig.xResolution / maxRays)) };
+		const Vector2f rayDir = Normalize(rayEnd - pos);
+		if (m_bFixedPointDDA)
 		{
-			// going left
-			step.x = -1;
-
-			// calculate ray length needed to reach left edge. Example: rayStart position of (7.33) - 7 leaves us with: 0.33 (ie. we are 33% across this tile)
-			// 0.33 * rayUnitStepsize = length of the ray to travel 1 unit in X scaled to the actual distance from edge
-			rayLength1D.x = (rayStart.x - static_cast<float>(mapCheck.x)) * rayUnitStepSize.x; 
-			
-		}
-		else
-		{
-			// going right
-			step.x = 1;
-
-			// calculate length to reach right edge. Example: 8 - position (7.33) = 0.66, multiplied by length of 1 x unit in ray direction
-			rayLength1D.x = (static_cast<float>(mapCheck.x + 1) - rayStart.x) * rayUnitStepSize.x;
-		}
-		if (rayDir.y < 0)
-		{
-			step.y = -1;
-			rayLength1D.y = (rayStart.y - static_cast<float>(mapCheck.y)) * rayUnitStepSize.y;
+			Draw2DRay<DDAFixed>(pos, rayDir, camOffset, depthPlayer);
 		}
 		else
 		{
-			step.y = 1;
-			rayLength1D.y = (static_cast<float>(mapCheck.y + 1) - rayStart.y) * rayUnitStepSize.y;
+			Draw2DRay<DDAFloat>(pos, rayDir, camOffset, depthPlayer);
 		}
+	}
+	END_PROFILE("2D Raycasting");
+}
 
-		// ====================================
-		// DETERMINE RAY LENGTH
-		// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
-		bool tileFound{false};
-		bool bHitSide{false};
-		float distance{0.f};
-		float totalDistance{0.f};
-		int portalEncounters{0};
-		while (totalDistance < m_rayConfig.farClip && portalEncounters < RAYCAST_PORTAL_LIMIT)
-		{
-			if (rayLength1D.x < rayLength1D.y)
-			{
-				// X distance is currently shortest, increase X
-				mapCheck.x += step.x;
-				distance = rayLength1D.x;
-				rayLength1D.x += rayUnitStepSize.x; // increase ray by 1 X unit
-				bHitSide = true;
-			}
-			else
+template <typename Scalar>
+void Raycaster::Draw2DRay(const Vector2f& pos, Vector2f rayDir, const Vector2f& camOffset, float lineDepth)
+{
+	Spear::Renderer& rend = Spear::ServiceLocator::GetScreenRenderer();
+	Spear::Renderer::LineData line;
+	line.depth = lineDepth;
+	Vector2f rayStart = pos;
+	Vector2f rayEnd;
+
+	GridDDA<Scalar> dda;
+	dda.Begin(rayStart, rayDir);
+	Vector2i& mapCheck = dda.mapCheck;
+
+	// ====================================
+	// DETERMINE RAY LENGTH
+	// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
+	bool tileFound{false};
+	float totalDistance{0.f};
+	int portalEncounters{0};
+	MapData::ChunkCursor cursor;
+	while (totalDistance < m_rayConfig.farClip && portalEncounters < RAYCAST_PORTAL_LIMIT)
+	{
+		const bool bHitSide = dda.Step();
+
+		// Check position is within range of array
+		if(mapCheck.x >= 0 && mapCheck.x < m_map->gridWidth && mapCheck.y >= 0 && mapCheck.y < m_map->gridHeight)
+		{	
+			// if tile is assigned a tex value it EXISTS
+			const int nodeIndex = cursor.NodeIndex(*m_map, mapCheck.x, mapCheck.y);
+			if (m_map->pTileFlags[nodeIndex] & (TILE_WALL_TEXTURE | TILE_ANY_MIRROR))
 			{
-				// Y distance is currently shortest, increase Y
-				mapCheck.y += step.y;
-				distance = rayLength1D.y;
-				rayLength1D.y += rayUnitStepSize.y; // increase ray by 1 Y unit
-				bHitSide = false;
-			}
-
-			// Check position is within range of array
-			if(mapCheck.x >= 0 && mapCheck.x < m_map->gridWidth && mapCheck.y >= 0 && mapCheck.y < m_map->gridHeight)
-			{	
-				// if tile is assigned a tex value it EXISTS
-				const GridNode& node = m_map->pNodes[mapCheck.x + (mapCheck.y * m_map->gridWidth)];
-				if (node.texIdWall != TEX_NONE || node.specialFlag != SPECIAL_NONE)
+				const GridNode& node = m_map->pNodes[nodeIndex];
+				tileFound = true;
+				
+				rayEnd = rayStart + rayDir * dda.Distance();
+				switch (portalEncounters)
 				{
-					tileFound = true;
-					
-					rayEnd = rayStart + rayDir * distance;
-					switch (portalEncounters)
-					{
-					case 0: line.colour = Colour4f::Red(); break;
-					case 1: line.colour = Colour4f::Cyan(); break;
-					case 2: line.colour = Colour4f::Green(); break;
-					case 3: line.colour = Colour4f::Yellow(); break;
-					default: line.colour = Colour4f::Black(); break;
-					}
-					line.start = (rayStart * m_rayConfig.scale2D) + camOffset;
-					line.end = (rayEnd * m_rayConfig.scale2D) + camOffset;
-					rend.AddLine(line);
-					
-					// If tile is not a mirror/portal, we are done
-					if (node.specialFlag == SPECIAL_NONE)
-					{
-						break;
-					}
-					
-					// Reprocess our info so we can begin tracing the exit-ray from the portal/mirror
-					portalEncounters++;
-					totalDistance += distance;
-					distance = 0.f;
-					rayStart = rayEnd;
-					rayLength1D = Vector2f::ZeroVector;
+				case 0: line.colour = Colour4f::Red(); break;
+				case 1: line.colour = Colour4f::Cyan(); break;
+				case 2: line.colour = Colour4f::Green(); break;
+				case 3: line.colour = Colour4f::Yellow(); break;
+				default: line.colour = Colour4f::Black(); break;
+				}
+				line.start = (rayStart * m_rayConfig.scale2D) + camOffset;
+				line.end = (rayEnd * m_rayConfig.scale2D) + camOffset;
+				rend.AddLine(line);
+				
+				// If tile is not a mirror/portal, we are done
+				if (node.specialFlag == SPECIAL_NONE)
+				{
+					break;
+				}
+				
+				// Reprocess our info so we can begin tracing the exit-ray from the portal/mirror
+				portalEncounters++;
+				totalDistance += dda.Distance();
+				rayStart = rayEnd;
+				
+				// flip ray direction and depenetrate mirror
+				if (node.specialFlag != SPECIAL_MIRROR) // if not a standard mirror, this must be a portal mirror with an inverted image
+				{
+					rayDir *= -1;
 					
-					// flip ray direction and depenetrate mirror
-					if (node.specialFlag != SPECIAL_MIRROR) // if not a standard mirror, this must be a portal mirror with an inverted image
+					if (node.specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
 					{
-						step *= -1;
-						rayDir *= -1;
-						
-						if (node.specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
-						{
-							// If multiple MirrorPortalConjoined are touching, do some extra processing to treat them as a single inverted mirror, otherwise the image gets split up
-							Vector2i hitTile = mapCheck;
-							mapCheck = m_map->GetExitTileForConjoinedPortal(mapCheck, bHitSide);
-							rayStart += (mapCheck - hitTile).ToFloat(); // offset our hit position by the distance to the mirror's exit-tile
-							
-						}
+						// If multiple MirrorPortalConjoined are touching, do some extra processing to treat them as a single inverted mirror, otherwise the image gets split up
+						Vector2i hitTile = mapCheck;
+						mapCheck = m_map->GetExitTileForConjoinedPortal(mapCheck, bHitSide);
+						rayStart += (mapCheck - hitTile).ToFloat(); // offset our hit position by the distance to the mirror's exit-tile
 						
-						if (!bHitSide)
-						{
-							int truncX = static_cast<int>(rayStart.x);
-							rayStart.x = truncX + (1 - (rayStart.x - truncX));
-						}
-						else
-						{
-							int truncY = static_cast<int>(rayStart.y);
-							rayStart.y = truncY + (1 - (rayStart.y - truncY));
-						}
-					}
-					else // standard mirror, no special behaviour
-					{
-						bHitSide ? step.x *= -1 : step.y *= -1;
-						bHitSide ? rayDir.x *= -1 : rayDir.y *= -1;
 					}
 					
-					if (rayDir.x < 0)
-					{
-						rayLength1D.x = (rayStart.x - static_cast<float>(mapCheck.x)) * rayUnitStepSize.x; 
-					}
-					else
-					{
-						rayLength1D.x = (static_cast<float>(mapCheck.x + 1) - rayStart.x) * rayUnitStepSize.x;
-					}
-					if (rayDir.y < 0)
+					if (!bHitSide)
 					{
-						rayLength1D.y = (rayStart.y - static_cast<float>(mapCheck.y)) * rayUnitStepSize.y;
+						int truncX = static_cast<int>(rayStart.x);
+						rayStart.x = truncX + (1 - (rayStart.x - truncX));
 					}
 					else
 					{
-						rayLength1D.y = (static_cast<float>(mapCheck.y + 1) - rayStart.y) * rayUnitStepSize.y;
+						int truncY = static_cast<int>(rayStart.y);
+						rayStart.y = truncY + (1 - (rayStart.y - truncY));
 					}
 				}
-			}
-			else
-			{
-				break;
+				else // standard mirror, no special behaviour
+				{
+					bHitSide ? rayDir.x *= -1 : rayDir.y *= -1;
+				}
+				
+				// exit-ray continues from the mirror's tile
+				dda.Restart(rayStart, rayDir);
 			}
 		}
-		if (!tileFound)
+		else
 		{
-			rayEnd = rayStart + rayDir * distance;
-			line.colour = Colour4f::White();
-			line.start = (pos * m_rayConfig.scale2D) + camOffset;
-			line.end = (rayEnd * m_rayConfig.scale2D) + camOffset;
-			rend.AddLine(line);
+			break;
 		}
 	}
-	END_PROFILE("2D Raycasting");
+	if (!tileFound)
+	{
+		rayEnd = rayStart + rayDir * dda.Distance();
+		line.colour = Colour4f::White();
+		line.start = (pos * m_rayConfig.scale2D) + camOffset;
+		line.end = (rayEnd * m_rayConfig.scale2D) + camOffset;
+		rend.AddLine(line);
+	}
 }
 
 void Raycaster::Draw3DGrid(const Vector2f& inPos, float inPitch, const float angle)
 {
+	const u64 frameStart = SDL_GetPerformanceCounter();
+	m_frameStats = RaycastFrameStats();
+
 	// Calculate const data for this frame
 	{
 		// Calculate 'real' pitch (in_pitch is just a percentage from -1 to +1)
@@ -500,15 +699,15 @@ void Raycaster::Draw3DGrid(const Vector2f& inPos, float inPitch, const float ang
 	// Run a pre-pass on portals so floor/ceiling raycasts don't have to run a trace on every pixel
 	if (m_bPortalRenderingEnabled)
 	{
-		START_PROFILE("Preprocess Portals")
+		StartPhase(PHASE_PREPROCESS_PORTALS);
 		PreProcessPortals();
-		END_PROFILE("Preprocess Portals")
+		EndPhase(PHASE_PREPROCESS_PORTALS);
 	}
 	
 	// Format sprite data into screen coordinates
-	START_PROFILE("Preprocess Sprites")
+	StartPhase(PHASE_PREPROCESS_SPRITES);
 	PreProcessSprites();
-	END_PROFILE("Preprocess Sprites")
+	EndPhase(PHASE_PREPROCESS_SPRITES);
 
 	if (m_bSoftwareRendering)
 	{
@@ -516,22 +715,160 @@ void Raycaster::Draw3DGrid(const Vector2f& inPos, float inPitch, const float ang
 	}
 	else
 	{
+		m_planeHistory.bValid = false;
 		Draw3DGridCompute(inPos, inPitch, angle);
 	}
+
+	// Judged on the raycaster's own time rather than the whole frame's, which the engine pads out to its target FPS
+	// (GPU work isn't visible here, so the compute path will settle at full resolution). Changes apply from the next frame.
+	UpdateDynamicResolution(1000.f * (static_cast<float>(SDL_GetPerformanceCounter() - frameStart) / SDL_GetPerformanceFrequency()));
+}
+
+void Raycaster::BuildMirrorBounds()
+{
+	m_mirrorBoundsMin = Vector2f(static_cast<float>(m_map->gridWidth), static_cast<float>(m_map->gridHeight));
+	m_mirrorBoundsMax = Vector2f(0.f, 0.f);
+	std::vector<Vector2i> mirrorTiles;
+
+	// Only resident chunks can hold anything (the shared empty chunk is slot 0)
+	for (int chunkY = 0; chunkY < m_map->chunksY; chunkY++)
+	{
+		for (int chunkX = 0; chunkX < m_map->chunksX; chunkX++)
+		{
+			if (m_map->pChunkSlots[chunkX + (chunkY * m_map->chunksX)] == 0)
+			{
+				continue;
+			}
+
+			const int xEnd = std::min((chunkX + 1) * MAP_CHUNK_SIZE, m_map->gridWidth);
+			const int yEnd = std::min((chunkY + 1) * MAP_CHUNK_SIZE, m_map->gridHeight);
+			for (int y = chunkY * MAP_CHUNK_SIZE; y < yEnd; y++)
+			{
+				for (int x = chunkX * MAP_CHUNK_SIZE; x < xEnd; x++)
+				{
+					if (!(m_map->pTileFlags[m_map->NodeIndex(x, y)] & TILE_ANY_MIRROR))
+					{
+						continue;
+					}
+
+					m_mirrorBoundsMin = Vector2f(std::min(m_mirrorBoundsMin.x, static_cast<float>(x)), std::min(m_mirrorBoundsMin.y, static_cast<float>(y)));
+					m_mirrorBoundsMax = Vector2f(std::max(m_mirrorBoundsMax.x, static_cast<float>(x + 1)), std::max(m_mirrorBoundsMax.y, static_cast<float>(y + 1)));
+					mirrorTiles.push_back(Vector2i(x, y));
+				}
+			}
+		}
+	}
+
+	// Mark every tile touching a mirror tile, over the bounds and the tile around them (nothing outside can be)
+	m_mirrorHalo.clear();
+	m_mirrorHaloMin = Vector2i(static_cast<int>(m_mirrorBoundsMin.x) - 1, static_cast<int>(m_mirrorBoundsMin.y) - 1);
+	m_mirrorHaloSize = mirrorTiles.empty() ? Vector2i(0, 0) : Vector2i(static_cast<int>(m_mirrorBoundsMax.x) + 2, static_cast<int>(m_mirrorBoundsMax.y) + 2) - m_mirrorHaloMin;
+	m_mirrorHalo.resize(m_mirrorHaloSize.x * m_mirrorHaloSize.y, 0);
+	for (const Vector2i& tile : mirrorTiles)
+	{
+		for (int y = tile.y - 1; y <= tile.y + 1; y++)
+		{
+			for (int x = tile.x - 1; x <= tile.x + 1; x++)
+			{
+				m_mirrorHalo[(x - m_mirrorHaloMin.x) + ((y - m_mirrorHaloMin.y) * m_mirrorHaloSize.x)] = 1;
+			}
+		}
+	}
+
+	// Slightly generous so rays grazing the edge of the bounds still get searched
+	m_mirrorBoundsMin -= Vector2f(MIRROR_BOUNDS_MARGIN, MIRROR_BOUNDS_MARGIN);
+	m_mirrorBoundsMax += Vector2f(MIRROR_BOUNDS_MARGIN, MIRROR_BOUNDS_MARGIN);
+}
+
+bool Raycaster::IsNearMirror(int x, int y)
+{
+	x -= m_mirrorHaloMin.x;
+	y -= m_mirrorHaloMin.y;
+	return x >= 0 && x < m_mirrorHaloSize.x && y >= 0 && y < m_mirrorHaloSize.y && m_mirrorHalo[x + (y * m_mirrorHaloSize.x)];
+}
+
+bool Raycaster::CanReachMirrors(const Vector2f& start, const Vector2f& end)
+{
+	Vector2f clippedStart;
+	Vector2f clippedEnd;
+	return ClipToMirrorBounds(start, end, clippedStart, clippedEnd);
+}
+
+bool Raycaster::ClipToMirrorBounds(const Vector2f& start, const Vector2f& end, Vector2f& outStart, Vector2f& outEnd)
+{
+	// Slab test of the segment against the bounds of every mirror tile: a DDA can only find tiles the segment passes through
+	float tMin = 0.f;
+	float tMax = 1.f;
+	const Vector2f trajectory = end - start;
+	const float starts[2]{ start.x, start.y };
+	const float trajectories[2]{ trajectory.x, trajectory.y };
+	const float boundsMin[2]{ m_mirrorBoundsMin.x, m_mirrorBoundsMin.y };
+	const float boundsMax[2]{ m_mirrorBoundsMax.x, m_mirrorBoundsMax.y };
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (trajectories[axis] == 0.f)
+		{
+			if (starts[axis] < boundsMin[axis] || starts[axis] > boundsMax[axis])
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const float invTrajectory = 1.f / trajectories[axis];
+		float t0 = (boundsMin[axis] - starts[axis]) * invTrajectory;
+		float t1 = (boundsMax[axis] - starts[axis]) * invTrajectory;
+		if (t0 > t1)
+		{
+			std::swap(t0, t1);
+		}
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if (tMin > tMax)
+		{
+			return false;
+		}
+	}
+	outStart = start + (trajectory * tMin);
+	outEnd = start + (trajectory * tMax);
+	return true;
 }
 
 void Raycaster::PreProcessPortals()
 {	
-	auto PreProcessPortalsTask = [](int taskId)
+	// Forward distance from the camera to hit the floor for the current row
+	const float defaultDistance = m_frame.viewHeight;
+	const float rowDistance = defaultDistance * m_frame.planeHeights.y;
+
+	// Portals never move, so traces can be kept for as long as the rays they were traced along stay put
+	PortalTraceView view;
+	view.pMap = m_map;
+	view.viewPos = m_frame.viewPos;
+	view.fovMinAngle = m_frame.fovMinAngle;
+	view.fovMaxAngle = m_frame.fovMaxAngle;
+	view.traceLength = rowDistance;
+	view.xResolution = m_rayConfig.xResolution;
+	if (m_bPortalTracesValid
+		&& view.pMap == m_portalTraceView.pMap
+		&& view.traceLength == m_portalTraceView.traceLength
+		&& view.xResolution == m_portalTraceView.xResolution
+		&& (view.viewPos - m_portalTraceView.viewPos).Length() < PORTAL_TRACE_REUSE_MOVE
+		&& (view.fovMinAngle - m_portalTraceView.fovMinAngle).Length() < PORTAL_TRACE_REUSE_TURN
+		&& (view.fovMaxAngle - m_portalTraceView.fovMaxAngle).Length() < PORTAL_TRACE_REUSE_TURN)
 	{
-		int xLowerBound = XResolutionPerThread() * taskId;
-		int xUpperBound = taskId == m_softwareRenderingThreads - 1 ? m_rayConfig.xResolution : xLowerBound + XResolutionPerThread(); // avoid skipping pixels under non-perfect division*/
-		
-		// Forward distance from the camera to hit the floor for the current row
-		float rowDistance;
-		const float defaultDistance = m_frame.viewHeight;
-		rowDistance = defaultDistance * m_frame.planeHeights.y;
+		return;
+	}
 
+	// While only the view has changed, each column re-solves its traces against the faces it last searched onto (and searches again if they can't be trusted)
+	const bool bRefresh = m_bPortalTracesValid
+		&& view.pMap == m_portalTraceView.pMap
+		&& view.traceLength == m_portalTraceView.traceLength
+		&& view.xResolution == m_portalTraceView.xResolution;
+	m_portalTraceView = view;
+	m_bPortalTracesValid = true;
+
+	auto PreProcessPortalsTask = [rowDistance, bRefresh](int xLowerBound, int xUpperBound)
+	{
 		// Vector representing position offset equivalent to 1 pixel right (imagine topdown 2D view, this 'jumps' horizontally by 1 ray)
 		Vector2f rayStep;
 		const Vector2f rayPixelWidth = (m_frame.fovMaxAngle - m_frame.fovMinAngle) / m_rayConfig.xResolution;
@@ -546,722 +883,1547 @@ void Raycaster::PreProcessPortals()
 		// Begin tracing portal paths for each pixel column (we can do it like this because we're treating portals as infinite height blocks which lets us skip a ton of work)
 		for (int screenX = xLowerBound; screenX < xUpperBound; screenX++) // for the chunk of X pixels allocated to this thread
 		{
-			auto portalPredicate = [](const GridNode& node) {return node.specialFlag == SPECIAL_MIRROR || node.specialFlag == SPECIAL_MIRROR_PORTAL || node.specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED;};
-			Vector2f ddaStart = m_frame.viewPos;
-			Vector2f ddaEnd = rayEnd;
-			Vector2f ddaTrajectory = rayEnd - ddaStart;
-			LineSearchData search;
-			
-			// Clear the initial trace - we don't need to clear the deeper traces since they will only be visited if we end up overwriting them as part of this search loop anyway
-			m_portalTraces[screenX].traces[0].rayStart = ddaStart;
-			m_portalTraces[screenX].traces[0].rayTrajectory = ddaTrajectory;
-			m_portalTraces[screenX].traces[0].accumulatedLength = ddaTrajectory.Length();
-			m_portalTraces[screenX].finalTrace = 0;
-			
-			int portalEncounters = 0;
-			while (m_map->LineSearchDDA(ddaStart, ddaEnd, portalPredicate, &search))
-            {
-                float percentRemaining = 1.f - search.percentComplete;
-				
-				// Reign in the already-stored trajectory values based on how far along the ray we were when we collided with a portal
-				m_portalTraces[screenX].traces[portalEncounters].rayTrajectory *= search.percentComplete;
-				m_portalTraces[screenX].traces[portalEncounters].accumulatedLength = m_portalTraces[screenX].traces[portalEncounters].rayTrajectory.Length();
-				if (portalEncounters > 0)
-				{
-					m_portalTraces[screenX].traces[portalEncounters].accumulatedLength += m_portalTraces[screenX].traces[portalEncounters - 1].accumulatedLength;
-				}
-				
-				m_portalTraces[screenX].finalTrace++;
-				
-				// Figure out trajectory for the next trace
-                ddaStart = search.hitPos;
-                ddaTrajectory *= percentRemaining;
-                if (search.node->specialFlag == SPECIAL_MIRROR)
-                {
-                    search.bVerticalHit ? ddaTrajectory.y *= -1 : ddaTrajectory.x *= -1;
-                }
-                else
-                {
-                    // if not default mirror, it's an inverted mirror
-                    ddaTrajectory *= -1;
-                    
-                    if (search.node->specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
-                    {
-                        // If multiple MirrorPortalConjoined are touching, do some extra processing to treat them as a single inverted mirror, otherwise the image gets split up                                    
-                        const Vector2i exitTile = m_map->GetExitTileForConjoinedPortal(search.tile, !search.bVerticalHit);
-                        ddaStart += (exitTile - search.tile).ToFloat();
-                    }
-                    
-                    // invert the mirror so rays entering along left side exit along right side and vice versa
-                    if (search.bVerticalHit)
-                    {
-                        int truncX = static_cast<int>(ddaStart.x);
-                        ddaStart.x = truncX + (1 - (ddaStart.x - truncX));
-                    }
-                    else
-                    {
-                        int truncY = static_cast<int>(ddaStart.y);
-                        ddaStart.y = truncY + (1 - (ddaStart.y - truncY));
-                    }
-                }
-                ddaEnd = ddaStart + ddaTrajectory;
-				
-				// Prep the next PortalTrace
-				portalEncounters++;
-				m_portalTraces[screenX].traces[portalEncounters].rayStart = ddaStart;
-				m_portalTraces[screenX].traces[portalEncounters].rayTrajectory = ddaTrajectory;
-				m_portalTraces[screenX].traces[portalEncounters].accumulatedLength = m_portalTraces[screenX].traces[portalEncounters - 1].accumulatedLength + ddaTrajectory.Length();
-				if (portalEncounters >= RAYCAST_PORTAL_LIMIT)
-				{
-					break;
-				}
-            }
-			
+			bool bRefreshed = false;
+			PortalSearch& portalSearch = m_portalSearches[screenX];
+			if (bRefresh && portalSearch.refreshDelay > 0)
+			{
+				portalSearch.refreshDelay--;
+			}
+			else if (bRefresh)
+			{
+				bRefreshed = TracePortalColumn(screenX, rayEnd, true);
+				portalSearch.refreshBackoff = bRefreshed ? 0 : std::min((portalSearch.refreshBackoff * 2) + 1, PORTAL_TRACE_REFRESH_BACKOFF);
+				portalSearch.refreshDelay = portalSearch.refreshBackoff;
+			}
+			if (!bRefreshed)
+			{
+				TracePortalColumn(screenX, rayEnd, false);
+			}
 			rayEnd += rayStep;
 		}
-		
-		return 0;
 	};
 	
 	Spear::ThreadManager& threader = Spear::ServiceLocator::GetThreadManager();
-	Spear::TaskHandle PortalsTaskHandle;
-	threader.DispatchTaskDistributed(PreProcessPortalsTask, &PortalsTaskHandle, m_softwareRenderingThreads);
-	PortalsTaskHandle.WaitForTaskComplete();
+	threader.ParallelFor(0, m_rayConfig.xResolution, Spear::ThreadManager::AUTO_GRAIN, PreProcessPortalsTask);
+
+	BuildPortalWindows();
 }
 
-void Raycaster::PreProcessSprites()
+bool Raycaster::TracePortalColumn(int screenX, const Vector2f& rayEnd, bool bRefresh)
 {
-	m_numSpritesToRender = 0;
+	PortalTraces& portalTraces = m_portalTraces[screenX];
+	PortalSearch& portalSearch = m_portalSearches[screenX];
+	if (bRefresh && portalSearch.finalTrace < 0)
+	{
+		return false;
+	}
+
+	auto portalPredicate = [](const GridNode& node) {return node.specialFlag == SPECIAL_MIRROR || node.specialFlag == SPECIAL_MIRROR_PORTAL || node.specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED;};
+	Vector2f ddaStart = m_frame.viewPos;
+	Vector2f ddaEnd = rayEnd;
+	Vector2f ddaTrajectory = rayEnd - ddaStart;
+	LineSearchData search;
 	
-	// TODO: Explore how we can use this pre-process step to 'insert' portal sprite clones based on portals we have line-of-sight with
-	for (int i = 0; i < m_spriteCount; i++)
+	// Clear the initial trace - we don't need to clear the deeper traces since they will only be visited if we end up overwriting them as part of this search loop anyway
+	portalTraces.traces[0].rayStart = ddaStart;
+	portalTraces.traces[0].rayTrajectory = ddaTrajectory;
+	portalTraces.traces[0].accumulatedLength = ddaTrajectory.Length();
+	portalTraces.traces[0].unfoldScale = Vector2f(1.f, 1.f);
+	portalTraces.traces[0].unfoldOffset = Vector2f(0.f, 0.f);
+	portalTraces.traces[0].nearDistance = 0.f;
+	portalTraces.traces[0].window = -1;
+	portalTraces.finalTrace = 0;
+
+	// Every trace lies along this column's ray once unfolded
+	const Vector2f rayDirection = Normalize(ddaTrajectory);
+	const float forwardPerLength = Dot(rayDirection, m_frame.viewForward);
+	Vector2f unfoldScale(1.f, 1.f);
+	
+	int portalEncounters = 0;
+	auto LineSearchMirrors = [&]()
 	{
-		const RaycastSprite& sprite = m_sprites[i];
-		const Vector2f relativePosition = sprite.spritePos - m_frame.viewPos;
+		return m_bFixedPointDDA ? m_map->LineSearchDDA<DDAFixed>(ddaStart, ddaEnd, TILE_ANY_MIRROR, portalPredicate, &search) : m_map->LineSearchDDA(ddaStart, ddaEnd, TILE_ANY_MIRROR, portalPredicate, &search);
+	};
 
-		// NOTE: m_frame.viewForward is a unit vector
-		// Dot product of relativePosition with viewForward gives us the forward depth to the sprite
-		const float forwardDistance = Dot(relativePosition, m_frame.viewForward);
-		if (forwardDistance < 0.f)
+	// Where the trace now crosses the face it was last searched onto: which tile along the face it lands in can change, but nothing else can be in the way (see IsPortalTraceClear)
+	auto ResolveFace = [&](const PortalFace& face)
+	{
+		const float startAlong = face.bVerticalHit ? ddaStart.y : ddaStart.x;
+		const float moveAlong = face.bVerticalHit ? ddaTrajectory.y : ddaTrajectory.x;
+		if (moveAlong * face.stepSign <= 0.f)
 		{
-			continue;
+			return false;
 		}
 
-		// NOTE: m_frame.screenPlaneVector is a unit vector
-		// Dot product of relativePosition with screenPlaneVector gives us the horizonal distance to the sprite from viewForward (midscreen)
-		const float rightDistance = Dot(relativePosition, m_frame.screenPlaneVector);
-
-		// SohCahToa (Toa) also means: tan(angle) * adjacentLength = oppositeLength
-		// in this case, 'angle' is half our fov, and 'adjacent' is our forward distance = this results in the horizontal distance from viewForward to screen's edge
-		const float halfViewWidth = tanf(m_frame.fov / 2.f) * forwardDistance;
-
-		// Convert halfViewWidth and rightDistance into a range between -1 and +1, then convert that into a percentage from 0.f to 1.f
-		float screenPercent = (rightDistance / halfViewWidth);
-		screenPercent = (screenPercent * 0.5f) + 0.5f;
-
-		// ScreenPos.X is simply screenPercent multiplied by xResolution
-		// ScreenPos.Y is middle of screen (yResolution / 2), shifted by viewPitch (vertical look), with spriteHeight (scaled by distance) applied
-		const Vector2i screenPos{ int(m_rayConfig.xResolution * screenPercent), ((m_rayConfig.yResolution / 2) + int(m_frame.viewPitch) + int(sprite.height / forwardDistance)) };
-
-		// Calculate sprite size scaled by distance/resolution/fov
-		Vector2f spriteSize = ((sprite.size / forwardDistance) * Vector2f(m_rayConfig.xResolution * m_frame.fovSpriteMultiplier, m_rayConfig.yResolution * (m_frame.fovWallMultiplier / 2)));
-
-		// Calculate edges based on size
-		Vector2i screenStart = screenPos - (spriteSize / 2).ToInt();
-		Vector2i screenEnd = screenPos + (spriteSize / 2).ToInt();
+		const float faceAlong = static_cast<float>((face.bVerticalHit ? face.tile.y : face.tile.x) + (face.stepSign > 0 ? 0 : 1));
+		const float percentComplete = (faceAlong - startAlong) / moveAlong;
+		if (!(percentComplete > 0.f && percentComplete < 1.f))
+		{
+			return false;
+		}
 
-		if (screenEnd.x < 0 || screenStart.x >= m_rayConfig.xResolution)
+		Vector2f hitPos = ddaStart + (ddaTrajectory * percentComplete);
+		Vector2i tile = face.tile;
+		if (face.bVerticalHit)
 		{
-			continue;
+			hitPos.y = faceAlong;
+			tile.x = static_cast<int>(std::floor(hitPos.x));
+		}
+		else
+		{
+			hitPos.x = faceAlong;
+			tile.y = static_cast<int>(std::floor(hitPos.y));
+		}
+		if (tile.x < 0 || tile.x >= m_map->gridWidth || tile.y < 0 || tile.y >= m_map->gridHeight)
+		{
+			return false;
 		}
 
-		const float renderDepth = forwardDistance / m_rayConfig.farClip;
+		const int nodeIndex = m_map->NodeIndex(tile.x, tile.y);
+		if (!(m_map->pTileFlags[nodeIndex] & TILE_ANY_MIRROR) || !portalPredicate(m_map->pNodes[nodeIndex]))
+		{
+			return false;
+		}
+		search.node = &m_map->pNodes[nodeIndex];
+		search.tile = tile;
+		search.hitPos = hitPos;
+		search.bVerticalHit = face.bVerticalHit;
+		search.percentComplete = percentComplete;
+		return true;
+	};
 
-		const int spId = m_numSpritesToRender++;
-		m_frameSprites[spId].spriteStart = screenStart;
-		m_frameSprites[spId].spriteEnd = screenEnd;
-		m_frameSprites[spId].spriteTex = sprite.textureId;
-		m_frameSprites[spId].spriteDepth = renderDepth;
-	}
+	while (true)
+	{
+		bool bHit;
+		if (bRefresh)
+		{
+			bHit = portalEncounters < portalSearch.finalTrace;
+			if (bHit && !ResolveFace(portalSearch.faces[portalEncounters]))
+			{
+				return false;
+			}
 
-	// Sort sprites so furthest are rendered first - useful if we want to support transparency
-	std::sort(m_frameSprites, m_frameSprites + m_numSpritesToRender, [](const RaycastSpriteData& a, const RaycastSpriteData& b) {
-		return a.spriteDepth > b.spriteDepth;
-	});
+			// Only the part of the trace within the mirror bounds can meet anything, and that part must still be within reach of the one which was searched
+			Vector2f clippedStart;
+			Vector2f clippedEnd;
+			const bool bReachesMirrors = ClipToMirrorBounds(ddaStart, bHit ? search.hitPos : ddaEnd, clippedStart, clippedEnd);
+			if (bHit || bReachesMirrors)
+			{
+				if (!bReachesMirrors
+					|| !portalSearch.bReachedMirrors[portalEncounters]
+					|| (clippedStart - portalSearch.starts[portalEncounters]).Length() >= PORTAL_TRACE_REFRESH_MOVE
+					|| (clippedEnd - portalSearch.ends[portalEncounters]).Length() >= PORTAL_TRACE_REFRESH_MOVE)
+				{
+					return false;
+				}
+				if (!portalSearch.bClearChecked[portalEncounters])
+				{
+					const PortalFace* pStartFace = portalEncounters > 0 ? &portalSearch.faces[portalEncounters - 1] : nullptr;
+					const PortalFace* pEndFace = bHit ? &portalSearch.faces[portalEncounters] : nullptr;
+					portalSearch.bClear[portalEncounters] = IsPortalTraceClear(portalSearch.starts[portalEncounters], portalSearch.ends[portalEncounters], pStartFace, pEndFace);
+					portalSearch.bClearChecked[portalEncounters] = true;
+				}
+				if (!portalSearch.bClear[portalEncounters])
+				{
+					return false;
+				}
+			}
+		}
+		else
+		{
+			bHit = CanReachMirrors(ddaStart, ddaEnd) && LineSearchMirrors();
+			if (bHit)
+			{
+				PortalFace& face = portalSearch.faces[portalEncounters];
+				face.tile = search.tile;
+				face.bVerticalHit = search.bVerticalHit;
+				face.stepSign = (search.bVerticalHit ? ddaTrajectory.y : ddaTrajectory.x) > 0.f ? 1 : -1;
+			}
+			portalSearch.bReachedMirrors[portalEncounters] = ClipToMirrorBounds(ddaStart, bHit ? search.hitPos : ddaEnd, portalSearch.starts[portalEncounters], portalSearch.ends[portalEncounters]);
+			portalSearch.bClearChecked[portalEncounters] = false;
+		}
+		if (!bHit)
+		{
+			break;
+		}
+
+		float percentRemaining = 1.f - search.percentComplete;
+		
+		// Reign in the already-stored trajectory values based on how far along the ray we were when we collided with a portal
+		portalTraces.traces[portalEncounters].rayTrajectory *= search.percentComplete;
+		portalTraces.traces[portalEncounters].accumulatedLength = portalTraces.traces[portalEncounters].rayTrajectory.Length();
+		if (portalEncounters > 0)
+		{
+			portalTraces.traces[portalEncounters].accumulatedLength += portalTraces.traces[portalEncounters - 1].accumulatedLength;
+		}
+		
+		portalTraces.finalTrace++;
+		
+		// Figure out trajectory for the next trace
+		ddaStart = search.hitPos;
+		ddaTrajectory *= percentRemaining;
+		if (search.node->specialFlag == SPECIAL_MIRROR)
+		{
+			search.bVerticalHit ? ddaTrajectory.y *= -1 : ddaTrajectory.x *= -1;
+			search.bVerticalHit ? unfoldScale.y *= -1 : unfoldScale.x *= -1;
+		}
+		else
+		{
+			// if not default mirror, it's an inverted mirror
+			ddaTrajectory *= -1;
+			unfoldScale *= -1;
+			
+			if (search.node->specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
+			{
+				// If multiple MirrorPortalConjoined are touching, do some extra processing to treat them as a single inverted mirror, otherwise the image gets split up
+				const Vector2i exitTile = m_map->GetExitTileForConjoinedPortal(search.tile, !search.bVerticalHit);
+				ddaStart += (exitTile - search.tile).ToFloat();
+			}
+			
+			// invert the mirror so rays entering along left side exit along right side and vice versa
+			if (search.bVerticalHit)
+			{
+				int truncX = static_cast<int>(ddaStart.x);
+				ddaStart.x = truncX + (1 - (ddaStart.x - truncX));
+			}
+			else
+			{
+				int truncY = static_cast<int>(ddaStart.y);
+				ddaStart.y = truncY + (1 - (ddaStart.y - truncY));
+			}
+		}
+		ddaEnd = ddaStart + ddaTrajectory;
+		
+		// Prep the next PortalTrace
+		portalEncounters++;
+		portalTraces.traces[portalEncounters].rayStart = ddaStart;
+		portalTraces.traces[portalEncounters].rayTrajectory = ddaTrajectory;
+		portalTraces.traces[portalEncounters].accumulatedLength = portalTraces.traces[portalEncounters - 1].accumulatedLength + ddaTrajectory.Length();
+
+		// Where the new trace starts along the unbent ray gives the rest of its unfolding
+		const float startLength = portalTraces.traces[portalEncounters - 1].accumulatedLength;
+		portalTraces.traces[portalEncounters].unfoldScale = unfoldScale;
+		portalTraces.traces[portalEncounters].unfoldOffset = (m_frame.viewPos + (rayDirection * startLength)) - (unfoldScale * ddaStart);
+		portalTraces.traces[portalEncounters].nearDistance = startLength * forwardPerLength;
+		if (portalEncounters >= RAYCAST_PORTAL_LIMIT)
+		{
+			break;
+		}
+	}
+
+	if (!bRefresh)
+	{
+		portalSearch.finalTrace = portalEncounters;
+	}
+	return true;
+}
+
+bool Raycaster::IsPortalTraceClear(const Vector2f& start, const Vector2f& end, const PortalFace* pStartFace, const PortalFace* pEndFace)
+{
+	// Anything less than a tile from the trace lies in a tile it passes through or a neighbour of one, so while none of those are mirrors a trace that stays
+	// within PORTAL_TRACE_REFRESH_MOVE of it can't meet one before its end face. Tiles behind the faces it starts and ends on can't be entered without crossing those first.
+	auto IsBehindFace = [](int x, int y, const PortalFace* pFace)
+	{
+		if (!pFace)
+		{
+			return false;
+		}
+		const int along = pFace->bVerticalHit ? y : x;
+		const int faceAlong = pFace->bVerticalHit ? pFace->tile.y : pFace->tile.x;
+		return pFace->stepSign > 0 ? along >= faceAlong : along <= faceAlong;
+	};
+
+	const Vector2f trajectory = end - start;
+	const float length = trajectory.Length();
+	GridDDA<DDAFloat> dda;
+	dda.Begin(start, length > 0.f ? Normalize(trajectory) : Vector2f(1.f, 0.f));
+	while (true)
+	{
+		if (IsNearMirror(dda.mapCheck.x, dda.mapCheck.y))
+		{
+			for (int y = dda.mapCheck.y - 1; y <= dda.mapCheck.y + 1; y++)
+			{
+				for (int x = dda.mapCheck.x - 1; x <= dda.mapCheck.x + 1; x++)
+				{
+					if (x < 0 || x >= m_map->gridWidth || y < 0 || y >= m_map->gridHeight || IsBehindFace(x, y, pStartFace) || IsBehindFace(x, y, pEndFace))
+					{
+						continue;
+					}
+					if (m_map->pTileFlags[m_map->NodeIndex(x, y)] & TILE_ANY_MIRROR)
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		dda.Step();
+		if (dda.distance >= length)
+		{
+			return true;
+		}
+	}
+}
+
+void Raycaster::BuildPortalWindows()
+{
+	// Sweep the columns once, extending the window open at each trace depth for as long as the next column's trace at that depth unfolds the same way
+	m_portalWindows.clear();
+	int openWindows[RAYCAST_PORTAL_LIMIT + 1];
+	std::fill(openWindows, openWindows + RAYCAST_PORTAL_LIMIT + 1, -1);
+	for (int screenX = 0; screenX < m_rayConfig.xResolution; screenX++)
+	{
+		PortalTraces& traces = m_portalTraces[screenX];
+		for (int trace = 1; trace <= RAYCAST_PORTAL_LIMIT; trace++)
+		{
+			if (trace > traces.finalTrace)
+			{
+				openWindows[trace] = -1;
+				continue;
+			}
+
+			PortalTrace& portalTrace = traces.traces[trace];
+			int& window = openWindows[trace];
+			if (window == -1
+				|| m_portalWindows[window].unfoldScale != portalTrace.unfoldScale
+				|| (m_portalWindows[window].unfoldOffset - portalTrace.unfoldOffset).Length() > PORTAL_WINDOW_UNFOLD_TOLERANCE)
+			{
+				window = static_cast<int>(m_portalWindows.size());
+				PortalWindow& newWindow = m_portalWindows.emplace_back();
+				newWindow.trace = trace;
+				newWindow.xStart = screenX;
+				newWindow.unfoldScale = portalTrace.unfoldScale;
+				newWindow.unfoldOffset = portalTrace.unfoldOffset;
+				newWindow.nearDistance = portalTrace.nearDistance;
+			}
+			m_portalWindows[window].xEnd = screenX;
+			m_portalWindows[window].nearDistance = std::min(m_portalWindows[window].nearDistance, portalTrace.nearDistance);
+			portalTrace.window = window;
+		}
+	}
+}
+
+bool Raycaster::ProjectSprite(const RaycastSprite& sprite, const Vector2f& position, RaycastSpriteData& outSprite)
+{
+	const Vector2f relativePosition = position - m_frame.viewPos;
+
+	// NOTE: m_frame.viewForward is a unit vector
+	// Dot product of relativePosition with viewForward gives us the forward depth to the sprite
+	const float forwardDistance = Dot(relativePosition, m_frame.viewForward);
+	if (forwardDistance < 0.f)
+	{
+		return false;
+	}
+
+	// NOTE: m_frame.screenPlaneVector is a unit vector
+	// Dot product of relativePosition with screenPlaneVector gives us the horizonal distance to the sprite from viewForward (midscreen)
+	const float rightDistance = Dot(relativePosition, m_frame.screenPlaneVector);
+
+	// SohCahToa (Toa) also means: tan(angle) * adjacentLength = oppositeLength
+	// in this case, 'angle' is half our fov, and 'adjacent' is our forward distance = this results in the horizontal distance from viewForward to screen's edge
+	const float halfViewWidth = tanf(m_frame.fov / 2.f) * forwardDistance;
+
+	// Convert halfViewWidth and rightDistance into a range between -1 and +1, then convert that into a percentage from 0.f to 1.f
+	float screenPercent = (rightDistance / halfViewWidth);
+	screenPercent = (screenPercent * 0.5f) + 0.5f;
+
+	// ScreenPos.X is simply screenPercent multiplied by xResolution
+	// ScreenPos.Y is middle of screen (yResolution / 2), shifted by viewPitch (vertical look), with spriteHeight (scaled by distance) applied
+	const Vector2i screenPos{ int(m_rayConfig.xResolution * screenPercent), ((m_rayConfig.yResolution / 2) + int(m_frame.viewPitch) + int(sprite.height / forwardDistance)) };
+
+	// Calculate sprite size scaled by distance/resolution/fov
+	Vector2f spriteSize = ((sprite.size / forwardDistance) * Vector2f(m_rayConfig.xResolution * m_frame.fovSpriteMultiplier, m_rayConfig.yResolution * (m_frame.fovWallMultiplier / 2)));
+
+	// Calculate edges based on size
+	Vector2i screenStart = screenPos - (spriteSize / 2).ToInt();
+	Vector2i screenEnd = screenPos + (spriteSize / 2).ToInt();
+
+	if (screenEnd.x < 0 || screenStart.x >= m_rayConfig.xResolution || screenEnd.y < 0 || screenStart.y >= m_rayConfig.yResolution)
+	{
+		return false;
+	}
+
+	outSprite.spriteStart = screenStart;
+	outSprite.spriteEnd = screenEnd;
+	outSprite.spriteTex = sprite.textureId;
+	outSprite.spriteDepth = forwardDistance / m_rayConfig.farClip;
+	outSprite.portalTrace = 0;
+	outSprite.portalWindow = -1;
+	return true;
+}
+
+void Raycaster::PreProcessSprites()
+{
+	// Clones seen through mirrors/portals need the per-column traces to clip them, which only the software renderer has
+	const bool bPortalClones = m_bPortalRenderingEnabled && m_bSoftwareRendering && !m_portalWindows.empty();
+	const size_t capacity = m_sprites.size() + (bPortalClones ? SPRITE_PORTAL_CLONE_LIMIT : 0);
+	if (m_frameSprites.size() < capacity)
+	{
+		m_frameSprites.resize(capacity);
+	}
+
+	// Sprites in regions which can't be seen from the camera's region are skipped, provided the visibility set was built for at least our far clip/encounter limit
+	// (the visibility set follows mirrors/portals, so this holds for clones too)
+	// Sprites are still drawn beyond the far clip, where no wall hides them but the visibility set's traces never reached: only those nearer (along the ray they're seen by) can be culled
+	LevelVisibility& visibility = m_map->visibility;
+	const bool bCullByVisibility = visibility.IsValidFor(m_rayConfig.farClip, m_rayConfig.rayEncounterLimit);
+	const int viewRegion = visibility.GetRegionIndex(m_frame.viewPos.ToInt());
+	if (bCullByVisibility)
+	{
+		// Traced in the background, so a region entered for the first time just culls nothing until its set is ready
+		visibility.PrefetchRegionsAround(*m_map, m_frame.viewPos.ToInt());
+	}
+	auto IsCulled = [bCullByVisibility](bool bRegionVisible, const Vector2f& position)
+	{
+		return bCullByVisibility && !bRegionVisible && (position - m_frame.viewPos).LengthSqr() <= m_rayConfig.farClip * m_rayConfig.farClip;
+	};
+
+	// Sprites are independent of each other, so are projected in parallel, each claiming output slots as it goes
+	// Every clone is a sprite projected from where it appears along the unbent rays of a portal window, using the window's unfolding
+	// Clones are only gathered as candidates here: which of them survive the per frame limit mustn't depend on which thread got there first
+	std::atomic<int> spriteSlots{ 0 };
+	std::mutex cloneMutex;
+	m_spriteCloneCandidates.clear();
+	auto PreProcessSpritesTask = [bCullByVisibility, bPortalClones, viewRegion, &visibility, &IsCulled, &spriteSlots, &cloneMutex](int spriteLowerBound, int spriteUpperBound)
+	{
+		std::vector<SpriteCloneCandidate> clones;
+		for (int i = spriteLowerBound; i < spriteUpperBound; i++) // for the chunk of sprites claimed by this thread...
+		{
+			const RaycastSprite& sprite = m_sprites[i];
+			const bool bRegionVisible = !bCullByVisibility || visibility.IsRegionVisible(viewRegion, visibility.GetRegionIndex(sprite.spritePos.ToInt()));
+
+			RaycastSpriteData projected;
+			if (!IsCulled(bRegionVisible, sprite.spritePos) && ProjectSprite(sprite, sprite.spritePos, projected))
+			{
+				m_frameSprites[spriteSlots++] = projected;
+			}
+
+			if (!bPortalClones)
+			{
+				continue;
+			}
+			for (int window = 0; window < static_cast<int>(m_portalWindows.size()); window++)
+			{
+				const PortalWindow& portalWindow = m_portalWindows[window];
+				const Vector2f unfoldedPos = (portalWindow.unfoldScale * sprite.spritePos) + portalWindow.unfoldOffset;
+				if (IsCulled(bRegionVisible, unfoldedPos) || !ProjectSprite(sprite, unfoldedPos, projected)
+					|| projected.spriteEnd.x < portalWindow.xStart || projected.spriteStart.x > portalWindow.xEnd
+					|| projected.spriteDepth * m_rayConfig.farClip <= portalWindow.nearDistance)
+				{
+					continue;
+				}
+				projected.portalTrace = portalWindow.trace;
+				projected.portalWindow = window;
+				clones.push_back({ projected, i });
+			}
+		}
+
+		if (!clones.empty())
+		{
+			std::scoped_lock<std::mutex> lock(cloneMutex);
+			m_spriteCloneCandidates.insert(m_spriteCloneCandidates.end(), clones.begin(), clones.end());
+		}
+	};
+	Spear::ThreadManager& threader = Spear::ServiceLocator::GetThreadManager();
+	threader.ParallelFor(0, m_spriteCount, Spear::ThreadManager::AUTO_GRAIN, PreProcessSpritesTask);
+	m_numSpritesToRender = spriteSlots;
+
+	// Bounded per frame, so a hall of mirrors can't multiply sprites without limit: the nearest clones are kept (ties broken on sprite then window, so the same ones survive every run)
+	auto NearerClone = [](const SpriteCloneCandidate& a, const SpriteCloneCandidate& b) {
+		if (a.projected.spriteDepth != b.projected.spriteDepth) return a.projected.spriteDepth < b.projected.spriteDepth;
+		if (a.spriteIndex != b.spriteIndex) return a.spriteIndex < b.spriteIndex;
+		return a.projected.portalWindow < b.projected.portalWindow;
+	};
+	if (m_spriteCloneCandidates.size() > SPRITE_PORTAL_CLONE_LIMIT)
+	{
+		std::nth_element(m_spriteCloneCandidates.begin(), m_spriteCloneCandidates.begin() + SPRITE_PORTAL_CLONE_LIMIT, m_spriteCloneCandidates.end(), NearerClone);
+		m_spriteCloneCandidates.resize(SPRITE_PORTAL_CLONE_LIMIT);
+	}
+	for (const SpriteCloneCandidate& clone : m_spriteCloneCandidates)
+	{
+		m_frameSprites[m_numSpritesToRender++] = clone.projected;
+	}
+
+	// Sort sprites so furthest are rendered first - useful if we want to support transparency
+	// Slots were claimed in whatever order threads got to them, so ties are broken on everything else to keep the output deterministic
+	std::sort(m_frameSprites.begin(), m_frameSprites.begin() + m_numSpritesToRender, [](const RaycastSpriteData& a, const RaycastSpriteData& b) {
+		if (a.spriteDepth != b.spriteDepth) return a.spriteDepth > b.spriteDepth;
+		if (a.portalWindow != b.portalWindow) return a.portalWindow < b.portalWindow;
+		if (a.spriteTex != b.spriteTex) return a.spriteTex < b.spriteTex;
+		if (a.spriteStart.x != b.spriteStart.x) return a.spriteStart.x < b.spriteStart.x;
+		if (a.spriteStart.y != b.spriteStart.y) return a.spriteStart.y < b.spriteStart.y;
+		if (a.spriteEnd.x != b.spriteEnd.x) return a.spriteEnd.x < b.spriteEnd.x;
+		return a.spriteEnd.y < b.spriteEnd.y;
+	});
+
+	if (m_bSoftwareRendering)
+	{
+		BinSprites();
+	}
+}
+
+bool Raycaster::IsSpriteVisibleInColumn(const RaycastSpriteData& sprite, int screenX)
+{
+	// Only between the mirror/portal it's seen through (if any) and the next one along the column's trace
+	const PortalTraces& traces = m_portalTraces[screenX];
+	const int trace = sprite.portalTrace;
+	if (trace > traces.finalTrace || (trace > 0 && traces.traces[trace].window != sprite.portalWindow))
+	{
+		return false;
+	}
+	const float forwardDistance = sprite.spriteDepth * m_rayConfig.farClip;
+	return (trace == 0 || forwardDistance > traces.traces[trace].nearDistance)
+		&& (trace == traces.finalTrace || forwardDistance < traces.traces[trace + 1].nearDistance);
+}
+
+void Raycaster::BinSprites()
+{
+	m_spriteTilesX = (m_rayConfig.xResolution + SPRITE_TILE_WIDTH - 1) / SPRITE_TILE_WIDTH;
+	m_spriteTilesY = (m_rayConfig.yResolution + SPRITE_TILE_HEIGHT - 1) / SPRITE_TILE_HEIGHT;
+	const int tileCount = m_spriteTilesX * m_spriteTilesY;
+	m_spriteBinStarts.assign(tileCount + 1, 0);
+
+	// Range of tiles each sprite's (on-screen) bounds overlap
+	auto ForEachTile = [](const RaycastSpriteData& sprite, auto&& function)
+	{
+		const int tileXStart = std::max(0, sprite.spriteStart.x) / SPRITE_TILE_WIDTH;
+		const int tileXEnd = std::min(sprite.spriteEnd.x, m_rayConfig.xResolution - 1) / SPRITE_TILE_WIDTH;
+		const int tileYStart = std::max(0, sprite.spriteStart.y) / SPRITE_TILE_HEIGHT;
+		const int tileYEnd = std::min(sprite.spriteEnd.y, m_rayConfig.yResolution - 1) / SPRITE_TILE_HEIGHT;
+		for (int tileY = tileYStart; tileY <= tileYEnd; tileY++)
+		{
+			for (int tileX = tileXStart; tileX <= tileXEnd; tileX++)
+			{
+				function(tileX + (tileY * m_spriteTilesX));
+			}
+		}
+	};
+
+	// Count each tile's sprites and accumulate them into the end of each tile's range, then fill the ranges back to front
+	// (walking sprites in reverse keeps each tile's range in sorted order, and leaves m_spriteBinStarts at the start of each range)
+	for (int i = 0; i < m_numSpritesToRender; i++)
+	{
+		ForEachTile(m_frameSprites[i], [](int tileIndex) { m_spriteBinStarts[tileIndex]++; });
+	}
+	for (int tileIndex = 1; tileIndex <= tileCount; tileIndex++)
+	{
+		m_spriteBinStarts[tileIndex] += m_spriteBinStarts[tileIndex - 1];
+	}
+	m_spriteBinSprites.resize(m_spriteBinStarts[tileCount]);
+	for (int i = m_numSpritesToRender - 1; i >= 0; i--)
+	{
+		ForEachTile(m_frameSprites[i], [i](int tileIndex) { m_spriteBinSprites[--m_spriteBinStarts[tileIndex]] = i; });
+	}
+}
+
+void Raycaster::DrawSpriteTile(int tileIndex, const Spear::TextureBase* pSpriteTextures, int xLowerBound, int xUpperBound)
+{
+	const int binStart = m_spriteBinStarts[tileIndex];
+	const int binEnd = m_spriteBinStarts[tileIndex + 1];
+	if (binStart == binEnd)
+	{
+		return;
+	}
+
+	const int tileX = tileIndex % m_spriteTilesX;
+	const int tileY = tileIndex / m_spriteTilesX;
+	xLowerBound = std::max(xLowerBound, tileX * SPRITE_TILE_WIDTH);
+	xUpperBound = std::min(xUpperBound, std::min((tileX + 1) * SPRITE_TILE_WIDTH, m_rayConfig.xResolution));
+	const int yLowerBound = tileY * SPRITE_TILE_HEIGHT;
+	const int yUpperBound = std::min((tileY + 1) * SPRITE_TILE_HEIGHT, m_rayConfig.yResolution);
+
+	// Furthest depth already drawn down each of the tile's columns: any sprite at least that far away is hidden down the whole column
+	// Sprites only ever bring depth nearer, so this stays a safe bound while the tile's sprites are drawn
+	Spear::BackgroundDepth columnMaxDepth[SPRITE_TILE_WIDTH];
+	for (int x = xLowerBound; x < xUpperBound; x++)
+	{
+		Spear::BackgroundDepth maxDepth = m_bgTexDepth[x + (yLowerBound * m_rayConfig.xResolution)];
+		for (int y = yLowerBound + 1; y < yUpperBound; y++)
+		{
+			maxDepth = std::max(maxDepth, m_bgTexDepth[x + (y * m_rayConfig.xResolution)]);
+		}
+		columnMaxDepth[x - xLowerBound] = maxDepth;
+	}
+
+	for (int bin = binStart; bin < binEnd; bin++)
+	{
+		const RaycastSpriteData& sprite = m_frameSprites[m_spriteBinSprites[bin]];
+		const SpriteSampling sampling = PrepareSpriteSampling(sprite, pSpriteTextures);
+		for (int x = std::max(xLowerBound, sprite.spriteStart.x); x <= std::min(sprite.spriteEnd.x, xUpperBound - 1); x++)
+		{
+			if (sampling.depth < columnMaxDepth[x - xLowerBound] && (!m_bPortalRenderingEnabled || IsSpriteVisibleInColumn(sprite, x)))
+			{
+				DrawSpriteColumn(sprite, sampling, pSpriteTextures, x, yLowerBound, yUpperBound);
+			}
+		}
+	}
+}
+
+Raycaster::SpriteSampling Raycaster::PrepareSpriteSampling(const RaycastSpriteData& sprite, const Spear::TextureBase* pSpriteTextures)
+{
+	// The sprite's screen range maps exactly onto the texture's width/height (the far edge is clamped back onto the last texel when sampled)
+	SpriteSampling sampling;
+	sampling.texXStep = (static_cast<s64>(pSpriteTextures->GetWidth()) << 16) / std::max(1, sprite.spriteEnd.x - sprite.spriteStart.x);
+	sampling.texYStep = (static_cast<s64>(pSpriteTextures->GetHeight() - 1) << 16) / std::max(1, sprite.spriteEnd.y - sprite.spriteStart.y);
+	sampling.depth = Spear::ToBackgroundDepth(sprite.spriteDepth);
+	return sampling;
+}
+
+int Raycaster::SelectMipLevel(const Spear::TextureBase* pTextures, float texelsPerPixel)
+{
+	// Coarsest level which still has at least one texel per pixel
+	if (!m_bMipmapping || !(texelsPerPixel >= 2.f))
+	{
+		return 0;
+	}
+	return std::clamp(static_cast<int>(std::log2(texelsPerPixel)), 0, std::max(0, pTextures->GetMipLevels() - 1));
+}
+
+bool Raycaster::IsFloorRow(int y)
+{
+	return y < (static_cast<float>(m_rayConfig.yResolution) / 2) + m_frame.viewPitch;
+}
+
+bool Raycaster::PreparePlaneRow(int y, const Spear::TextureBase* pMapTextures, PlaneRowParams& outRow)
+{
+	bool bIsFloor = IsFloorRow(y);
+
+	// Current y position compared to the center of the screen (the horizon)
+	int rayPitch;
+	if (bIsFloor)
+	{
+		rayPitch = ((m_rayConfig.yResolution - y - 1) - (m_rayConfig.yResolution / 2)) + m_frame.viewPitch;
+	}
+	else
+	{
+		rayPitch = (y - (m_rayConfig.yResolution / 2)) - m_frame.viewPitch;
+	}
+	if (rayPitch == 0)
+	{
+		return false;
+	}
+
+	// Forward distance from the camera to hit the floor for the current row.
+	// 0.5 is the z position exactly in the middle between floor and ceiling.
+	float rowDistance[2];
+	const float defaultDistance = m_frame.viewHeight / rayPitch;
+	rowDistance[0] = defaultDistance * m_frame.planeHeights.x;
+	rowDistance[1] = defaultDistance * m_frame.planeHeights.y;
+
+	// Vector representing position offset equivalent to 1 pixel right (imagine topdown 2D view, this 'jumps' horizontally by 1 ray)
+	Vector2f rayStep[2];
+	const Vector2f rayPixelWidth = (m_frame.fovMaxAngle - m_frame.fovMinAngle) / m_rayConfig.xResolution;
+	rayStep[0] = rowDistance[0] * rayPixelWidth;
+	rayStep[1] = rowDistance[1] * rayPixelWidth;
+
+	// endpoint of first ray in row (left)
+	// essentially the 'left-most ray' along a length (depth) of rowDistance
+	Vector2f rayEnd[2];
+	rayEnd[0] = m_frame.viewPos + rowDistance[0] * m_frame.fovMinAngle;
+	rayEnd[1] = m_frame.viewPos + rowDistance[1] * m_frame.fovMinAngle;
+
+	// calculate 'depth' for this strip of floor (same depth will be shared for all drawn pixels in one row of X)
+	Vector2f rayStart[2];
+	float rayDepth[2];
+	rayStart[0] = m_frame.viewPos + Projection(rowDistance[0] * m_frame.fovMinAngle, m_frame.viewForward.Normal());
+	rayStart[1] = m_frame.viewPos + Projection(rowDistance[1] * m_frame.fovMinAngle, m_frame.viewForward.Normal());
+	rayDepth[0] = (rayEnd[0] - rayStart[0]).Length() / m_rayConfig.farClip;
+	rayDepth[1] = (rayEnd[1] - rayStart[1]).Length() / m_rayConfig.farClip;
+
+	// Prevent drawing floor textures behind camera
+	if (rowDistance[0] <= 0)
+	{
+		return false;
+	}
+
+	outRow.pNodes = m_map->pNodes;
+	outRow.pChunkSlots = m_map->pChunkSlots;
+	outRow.chunksX = m_map->chunksX;
+	outRow.gridWidth = m_map->gridWidth;
+	outRow.gridHeight = m_map->gridHeight;
+	for (int layer = 0; layer < 2; layer++)
+	{
+		// Adjacent pixels in the row sample rayStep apart, so pick the mip with about one texel per step
+		const int mipLevel = SelectMipLevel(pMapTextures, rayStep[layer].Length() * pMapTextures->GetWidth());
+		outRow.pTexels[layer] = pMapTextures->GetTexelsRGBAMip(mipLevel, 0);
+		outRow.texWidth[layer] = pMapTextures->GetMipWidth(mipLevel);
+		outRow.texHeight[layer] = pMapTextures->GetMipHeight(mipLevel);
+		outRow.texIdOffset[layer] = static_cast<int>((bIsFloor ? offsetof(GridNode, texIdFloor) : offsetof(GridNode, texIdRoof)) / sizeof(int)) + layer;
+		outRow.rayEnd[layer] = rayEnd[layer];
+		outRow.rayStep[layer] = rayStep[layer];
+		outRow.rayDepth[layer] = Spear::ToBackgroundDepth(rayDepth[layer]);
+	}
+
+	// Indexes into texture/depth arrays for the start of the row equal to Y value
+	const int rowIndex = y * m_rayConfig.xResolution;
+	outRow.pOutRGBA = &m_bgTexRGBA[rowIndex];
+	outRow.pOutDepth = &m_bgTexDepth[rowIndex];
+	outRow.pixelCount = m_rayConfig.xResolution;
+	outRow.clearDepth = Spear::ToBackgroundDepth(m_rayConfig.farClip);
+	return true;
+}
+
+bool Raycaster::SamplePlanePixel(const PlaneRowParams& row, int x, u32& outTexel, Spear::BackgroundDepth& outDepth)
+{
+	const int* pNodeInts = reinterpret_cast<const int*>(row.pNodes);
+
+	for (int layer = 0; layer < 2; layer++)
+	{
+		// Sample point calculated from pixel index (matching the row kernels), then walked through any portals along this column
+		Vector2f samplePoint(row.rayEnd[layer].x + row.rayStep[layer].x * static_cast<float>(x), row.rayEnd[layer].y + row.rayStep[layer].y * static_cast<float>(x));
+		if (m_bPortalRenderingEnabled && m_portalTraces[x].finalTrace > 0)
+		{
+			samplePoint = m_portalTraces[x].GetPointAtTraceDistance((samplePoint - m_frame.viewPos).Length());
+		}
+
+		const int mapCellX = static_cast<int>(samplePoint.x);
+		const int mapCellY = static_cast<int>(samplePoint.y);
+		if (mapCellX < 0 || mapCellX >= row.gridWidth || mapCellY < 0 || mapCellY >= row.gridHeight)
+		{
+			continue;
+		}
+
+		const int texId = pNodeInts[(m_map->NodeIndex(mapCellX, mapCellY) * (sizeof(GridNode) / sizeof(int))) + row.texIdOffset[layer]];
+		if (texId == eLevelTextures::TEX_NONE)
+		{
+			continue;
+		}
+
+		const int texWidth = row.texWidth[layer];
+		const int texHeight = row.texHeight[layer];
+		int texX = static_cast<int>((samplePoint.x - mapCellX) * texWidth);
+		int texY = static_cast<int>((samplePoint.y - mapCellY) * texHeight);
+		if (texX < 0)
+			texX += texWidth;
+		if (texY < 0)
+			texY += texHeight;
+
+		ASSERT(texX < texWidth);
+		ASSERT(texY < texHeight);
+		outTexel = row.pTexels[layer][(texId * texWidth * texHeight) + texX + (texY * texWidth)];
+		outDepth = row.rayDepth[layer];
+
+		// We're drawing the floors nearest-first, so no need to calculate layers BEHIND this
+		return true;
+	}
+	return false;
+}
+
+template <typename Scalar, u8 Features>
+void Raycaster::RaycastWallColumn(int screenX, const Spear::TextureBase* pMapTextures, std::vector<ColumnSeam>* pDeferredSeams)
+{
+	Vector2f rayStart = m_frame.viewPos;
+	Vector2f rayEnd{ m_frame.screenPlaneEdgePositionL - (m_frame.raySpacingDir * m_frame.raySpacingLength * screenX) };
+	Vector2f rayDir = Normalize(rayEnd - rayStart);
+
+	GridDDA<Scalar> dda;
+	dda.Begin(rayStart, rayDir);
+	Vector2i& mapCheck = dda.mapCheck;
+	Vector2i& step = dda.step;
+	const typename Scalar::Length farClipLength = dda.ToLength(m_rayConfig.farClip);
+
+	// ====================================
+	// DETERMINE RAY LENGTH
+	// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
+	int rayEncounters{ 0 }; // track how many walls this ray has encountered (used to render tall walls behind short walls)
+	eRayHit rayHit{ RAY_NOHIT };
+	int wallNodeIndex{ 0 };
+	MapData::ChunkCursor cursor;
+	while (rayEncounters < m_rayConfig.rayEncounterLimit && dda.distance < farClipLength)
+	{
+		rayHit = RAY_NOHIT;
+		while (rayHit == RAY_NOHIT && dda.distance < farClipLength)
+		{
+			const bool side = dda.Step();
+
+			// Check position is within range of array
+			if (mapCheck.x >= 0 && mapCheck.x < m_map->gridWidth && mapCheck.y >= 0 && mapCheck.y < m_map->gridHeight)
+			{
+				wallNodeIndex = cursor.NodeIndex(*m_map, mapCheck.x, mapCheck.y);
+
+				// most tiles along a ray are empty: test the compact flags plane and skip them without touching the GridNode
+				const u8 tileFlags = m_map->pTileFlags[wallNodeIndex];
+				if (tileFlags == TILE_EMPTY)
+				{
+					continue;
+				}
+				
+				if constexpr ((Features & WALL_PORTALS) != 0)
+				{
+					// is tile a mirror of any kind?
+					if (tileFlags & TILE_ANY_MIRROR)
+					{							
+						// flip ray direction and depenetrate mirror
+						if (tileFlags & TILE_ANY_PORTAL) // if not a basic mirror, this must be a portal mirror with an inverted image
+						{
+							step *= -1;
+						
+							if (tileFlags & TILE_PORTAL_CONJOINED)
+							{
+								// If multiple MirrorPortalConjoined are touching, do some extra processing to treat them as a single inverted mirror, otherwise the image gets split up
+								mapCheck = m_map->GetExitTileForConjoinedPortal(mapCheck, side);
+							}
+						}
+						else // standard mirror, no special behaviour
+						{
+							side ? step.x *= -1 : step.y *= -1;
+						}
+						side ? mapCheck.x += step.x : mapCheck.y += step.y;
+					}
+				}
+				
+				// if tile has any wall textures we can draw those here (if the tile is also a mirror that's still fine since we can draw cutout textures over it for extra detail)
+				if (tileFlags & TILE_WALL)
+				{
+					rayHit = side ? RAY_HIT_SIDE : RAY_HIT_FRONT;
+					rayEncounters++;
+				}
+			}
+			else
+			{
+				// if ray has left the grid, might as well quit here
+				break;
+			}
+		}
+
+		// ====================================
+		// RENDER
+		// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
+		if (rayHit)
+		{
+			Vector2f intersection{ rayStart + rayDir * dda.Distance() };
+			float depth{ Projection(intersection - m_frame.viewPos, m_frame.viewForward * m_rayConfig.farClip).Length() };
+			float renderDepth = depth / m_rayConfig.farClip;
+			const Spear::BackgroundDepth storedDepth = Spear::ToBackgroundDepth(renderDepth);
+			const float halfHeight{ (1 + (m_rayConfig.yResolution / 2) / depth) * m_frame.fovWallMultiplier };
+			const float fullHeight{ halfHeight * 2};
+
+			int mid{ static_cast<int>(m_frame.viewPitch + (m_rayConfig.yResolution / 2)) };
+			float bottom{ mid - halfHeight };
+			float top{ mid + halfHeight };
+
+			// Mip level with about one texel per screen pixel down the wall strip
+			const int mipLevel = SelectMipLevel(pMapTextures, pMapTextures->GetHeight() / fullHeight);
+			const int texWidth = pMapTextures->GetMipWidth(mipLevel);
+			const int texHeight = pMapTextures->GetMipHeight(mipLevel);
+
+			const GridNode& node = m_map->pNodes[wallNodeIndex];
+			const u32* pWallTexture{ nullptr }; // column-major texels, so each wall strip reads one contiguous column
+			
+			int texX = -1;
+			auto CalcTexX = [&]()
+			{
+				// X Index into WallTexture = x position inside cell
+				float percentageIntoTexture = rayHit == RAY_HIT_FRONT ? (intersection.x - static_cast<int>(intersection.x)) : (intersection.y - static_cast<int>(intersection.y));
+				texX = static_cast<int>(percentageIntoTexture * (texWidth - 1));
+				if (texX < 0)
+				{
+					texX += texWidth;
+				}
+				if ((rayHit == RAY_HIT_SIDE && rayDir.x < 0)
+				|| (rayHit == RAY_HIT_FRONT && rayDir.y < 0))
+				{
+					texX = (texWidth - 1) - texX; // keeps texture horizontal direction consistent per side, necessary for maintaing portal illusions
+				}
+				ASSERT(texX < texWidth && texX >= 0);
+			};
+			if (node.texIdWall != TEX_NONE)
+			{
+				pWallTexture = pMapTextures->GetTexelsRGBAColumnMajorMip(mipLevel, node.texIdWall);
+				CalcTexX();
+			}
+
+			// Respect any drawFlags specified in editor (a hidden face still corrects the seams of its extended walls below)
+			bool bFaceDrawn{ true };
+			if constexpr ((Features & WALL_DRAW_FLAGS) != 0)
+			{
+				if (node.drawFlags != eDrawFlags::DRAW_DEFAULT)
+				{
+					if (rayHit == RAY_HIT_SIDE)
+					{
+						bFaceDrawn = !((rayDir.x > 0 && !(node.drawFlags & DRAW_W)) || (rayDir.x < 0 && !(node.drawFlags & DRAW_E)));
+					}
+					else
+					{
+						bFaceDrawn = !((rayDir.y > 0 && !(node.drawFlags & DRAW_N)) || (rayDir.y < 0 && !(node.drawFlags & DRAW_S)));
+					}
+				}
+			}
+
+			// Draws textured vertical line segment for wall between bottom and top
+			const int xResolution = m_rayConfig.xResolution;
+			const int texYMax = texHeight - 1;
+			auto DrawStrip = [&]()
+			{
+				// Walls can be drawn based on Floor/Wall/Roof. As such, certain strips may have no texture active and should be skipped.
+				if (!pWallTexture || !bFaceDrawn)
+				{
+					return;
+				}
+
+				// Clipped to the screen up front, leaving the loop with just the depth test and texel write
+				const int stripBottom = static_cast<int>(bottom);
+				const int stripTop = static_cast<int>(top);
+				const float stripHeight = static_cast<float>(stripTop - stripBottom);
+				const int yStart = std::max(0, stripBottom);
+				const int yEnd = std::min(stripTop, m_rayConfig.yResolution - 1);
+				const u32* pTexColumn = pWallTexture + (texX * texHeight);
+				for (int screenY = yStart, screenIndex = screenX + (yStart * xResolution); screenY <= yEnd; screenY++, screenIndex += xResolution)
+				{
+					// Draw only if our depth is nearer than any existing pixel
+					if (storedDepth < m_bgTexDepth[screenIndex])
+					{
+						// Y Index into WallTexture = percentage through current strip
+						const int texY = texYMax - static_cast<int>((static_cast<float>(screenY - stripBottom) / stripHeight) * texYMax);
+						ASSERT(texY < texHeight && texY >= 0);
+
+						const u32 texel = pTexColumn[texY];
+						if (texel & 0xFF000000)
+						{
+							m_bgTexRGBA[screenIndex] = texel;
+							m_bgTexDepth[screenIndex] = storedDepth;
+						}
+					}
+				}
+			};
+
+			// 'Core' wall strip
+			DrawStrip();
+
+			if constexpr ((Features & WALL_MULTI_STOREY) != 0)
+			{
+				// Cleans up small pixel gaps formed by Roof/Floor extending into walls above/below the playspace. Deferred by column rendering until its planes are drawn, since seams are detected against them.
+				auto FixSeams = [&](int yStart, int yStep, const GLuint& correctivePixel)
+				{
+					const ColumnSeam seam{ yStart, yStep, correctivePixel, renderDepth };
+					if (pDeferredSeams)
+					{
+						pDeferredSeams->push_back(seam);
+					}
+					else
+					{
+						FixColumnSeam(screenX, seam);
+					}
+				};
+
+				// Upper wall strips
+				for (int renderingUp = 1; renderingUp <= node.extendUp; renderingUp++)
+				{
+					bottom = top + 1;
+					top = bottom + fullHeight;
+					
+					if (node.texIdRoof[0] != TEX_NONE)
+					{
+						pWallTexture = pMapTextures->GetTexelsRGBAColumnMajorMip(mipLevel, node.texIdRoof[0]);
+					}
+					else if (node.texIdWall != TEX_NONE)
+					{
+						pWallTexture = pMapTextures->GetTexelsRGBAColumnMajorMip(mipLevel, node.texIdWall);
+					}
+					else
+					{
+						pWallTexture = nullptr;
+					}
+
+					if (texX == -1 && pWallTexture)
+					{
+						CalcTexX();
+					}
+
+					if (pWallTexture && renderingUp == 1 && node.texIdWall == TEX_NONE)
+					{
+						FixSeams(bottom, -1, pWallTexture[(texHeight - 1) + (texX * texHeight)]);
+					}
+					DrawStrip();
+				}
+
+				// Lower wall strips
+				bottom = mid - halfHeight;
+				top = mid + halfHeight;
+				for (int renderingDown = 1; renderingDown <= node.extendDown; renderingDown++)
+				{
+					top = bottom - 1;
+					bottom = top - fullHeight;
+					
+					if (node.texIdFloor[0] != TEX_NONE)
+					{
+						pWallTexture = pMapTextures->GetTexelsRGBAColumnMajorMip(mipLevel, node.texIdFloor[0]);
+					}
+					else if (node.texIdWall != TEX_NONE)
+					{
+						pWallTexture = pMapTextures->GetTexelsRGBAColumnMajorMip(mipLevel, node.texIdWall);
+					}
+					else
+					{
+						pWallTexture = nullptr;
+					}
+
+					if (texX == -1 && pWallTexture)
+					{
+						CalcTexX();
+					}
+
+					if (pWallTexture && renderingDown == 1 && node.texIdWall == TEX_NONE)
+					{
+						FixSeams(top, 1, pWallTexture[texX * texHeight]);
+					}
+					DrawStrip();
+				}
+			}
+		}
+	}
+}
+
+Raycaster::WallColumnFunction Raycaster::SelectWallColumn()
+{
+	const u8 features = m_mapWallFeatures | (m_bPortalRenderingEnabled ? WALL_PORTALS : 0);
+	return m_bFixedPointDDA ? SelectWallColumn<DDAFixed>(features) : SelectWallColumn<DDAFloat>(features);
+}
+
+template <typename Scalar>
+Raycaster::WallColumnFunction Raycaster::SelectWallColumn(u8 features)
+{
+	static_assert(WALL_FEATURES_ALL == 7, "every eWallFeatures combination needs a variant below");
+	static constexpr WallColumnFunction variants[WALL_FEATURES_ALL + 1]
+	{
+		&RaycastWallColumn<Scalar, 0>, &RaycastWallColumn<Scalar, 1>, &RaycastWallColumn<Scalar, 2>, &RaycastWallColumn<Scalar, 3>,
+		&RaycastWallColumn<Scalar, 4>, &RaycastWallColumn<Scalar, 5>, &RaycastWallColumn<Scalar, 6>, &RaycastWallColumn<Scalar, 7>
+	};
+	return variants[features & WALL_FEATURES_ALL];
 }
 
-void Raycaster::Draw3DGridCPU(const Vector2f& inPos, float inPitch, const float angle)
-{
-	Spear::Renderer& renderer = Spear::ServiceLocator::GetScreenRenderer();
-	Spear::ThreadManager& threader = Spear::ServiceLocator::GetThreadManager();
-	
-	// Floor/Ceiling Casting
-	auto RaycastPlanesTask = [](int taskId)
+// Corrects small pixel gaps formed by Roof/Floor extending into walls above/below the playspace
+void Raycaster::FixColumnSeam(int screenX, const ColumnSeam& seam)
+{
+	int yStart = seam.yStart + seam.yStep;
+	constexpr int seamCorrectionLimit{ 10 };
+	const int seamCorrectionEnd = yStart + (seamCorrectionLimit * seam.yStep);
+	
+	// Detect whether this strip is a seam or just the end of a wall
+	bool bIsSeam{ false };
+	for (int screenY = yStart; std::abs(screenY - seamCorrectionEnd) > 0; screenY += seam.yStep)
+	{
+		if (screenY >= m_rayConfig.yResolution || screenY < 0)
+		{
+			continue;
+		}
+	
+		const int screenIndex{ screenX + (screenY * m_rayConfig.xResolution) };
+		GLuint& nextColByte = m_bgTexRGBA[screenIndex];
+		bool nextByteIsInDepthRange = abs(Spear::FromBackgroundDepth(m_bgTexDepth[screenIndex]) - seam.renderDepth) < m_rayConfig.correctivePixelDepthTolerance;
+		if (nextColByte && nextByteIsInDepthRange)
+		{
+			bIsSeam = true;
+			break;
+		}
+	}
+	if (!bIsSeam)
+	{
+		return;
+	}
+	
+	// If this is a seam (ie. wall connected to floor/ceiling) fill pixels sequentially until first non-empty pixel is reached
+	for (int screenY = yStart; std::abs(screenY - seamCorrectionEnd) > 0; screenY += seam.yStep)
+	{
+		if (screenY >= m_rayConfig.yResolution || screenY < 0)
+		{
+			continue;
+		}
+	
+		const int screenIndex{ screenX + (screenY * m_rayConfig.xResolution) };
+		GLuint& nextColByte = m_bgTexRGBA[screenIndex];
+		bool nextByteIsInDepthRange = abs(Spear::FromBackgroundDepth(m_bgTexDepth[screenIndex]) - seam.renderDepth) < m_rayConfig.correctivePixelDepthTolerance;
+		if (nextColByte == 0 || !nextByteIsInDepthRange)
+		{
+			if (m_rayConfig.highlightCorrectivePixels)
+			{
+				nextColByte |= (255 << 0);
+				nextColByte |= (0 << 8);
+				nextColByte |= (0 << 16);
+				nextColByte |= (255 << 24);
+			}
+			else
+			{
+				nextColByte = seam.correctivePixel;
+			}
+			m_bgTexDepth[screenIndex] = Spear::ToBackgroundDepth(seam.renderDepth);
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+void Raycaster::Draw3DGridCPU(const Vector2f& inPos, float inPitch, const float angle)
+{
+	// Render straight into the renderer's mapped upload buffers where supported, so uploading is just a GPU-side copy
+	Spear::Renderer& renderer = Spear::ServiceLocator::GetScreenRenderer();
+	Spear::Renderer::BackgroundStaging staging;
+	const bool bStaging = renderer.AcquireBackgroundStaging(m_rayConfig.xResolution, m_rayConfig.yResolution, staging);
+	if (bStaging)
+	{
+		m_bgTexRGBA = staging.pRGBA;
+		m_bgTexDepth = staging.pDepth;
+	}
+
+	if (m_bColumnRendering)
+	{
+		m_planeHistory.bValid = false;
+		StartPhase(PHASE_RAYCAST_COLUMNS);
+		RaycastColumnsCPU();
+		EndPhase(PHASE_RAYCAST_COLUMNS);
+	}
+	else
+	{
+		RaycastPassesCPU();
+	}
+
+	if (m_bOutputChecksumEnabled)
 	{
-		const Spear::TextureBase* pMapTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(0);
+		m_frameStats.outputChecksum = CalculateOutputChecksum();
+	}
 
-		int yLowerBound = YResolutionPerThread() * taskId;
-		int yUpperBound = taskId == m_softwareRenderingThreads - 1 ? m_rayConfig.yResolution : yLowerBound + YResolutionPerThread(); // avoid skipping pixels under non-perfect division
+	StartPhase(PHASE_RAYCAST_UPLOAD);
+	// Upload Raycast image for this frame
+	if (bStaging)
+	{
+		renderer.SubmitBackgroundStaging();
+		m_bgTexRGBA = m_localTexRGBA;
+		m_bgTexDepth = m_localTexDepth;
+	}
+	else
+	{
+		renderer.SetBackgroundTextureDataRGBA(m_bgTexRGBA, m_bgTexDepth, m_rayConfig.xResolution, m_rayConfig.yResolution);
+	}
+	EndPhase(PHASE_RAYCAST_UPLOAD);
+}
 
-		for (int y = yLowerBound; y < yUpperBound; y++) // for the chunk of Y pixels allocated to this thread...
+template <bool bPortalsInView>
+void Raycaster::DrawPlaneRow(const PlaneRowParams& row)
+{
+	// Without portals, each layer's sample point is a straight walk across the row: hand the whole row to the (SIMD) kernel
+	if constexpr (!bPortalsInView)
+	{
+		m_planesKernel(row, 0, row.pixelCount);
+	}
+	else
+	{
+		// Only columns looking through a portal need sampling per pixel, runs of the others are still a straight walk
+		int xStart = 0;
+		while (xStart < row.pixelCount)
 		{
-			bool bIsFloor = y < (static_cast<float>(m_rayConfig.yResolution) / 2) + m_frame.viewPitch;
-
-			// Current y position compared to the center of the screen (the horizon)
-			int rayPitch;
-			if (bIsFloor)
-			{
-				rayPitch = ((m_rayConfig.yResolution - y - 1) - (m_rayConfig.yResolution / 2)) + m_frame.viewPitch;
-			}
-			else
+			const bool bThroughPortal = m_portalTraces[xStart].finalTrace > 0;
+			int xEnd = xStart + 1;
+			while (xEnd < row.pixelCount && (m_portalTraces[xEnd].finalTrace > 0) == bThroughPortal)
 			{
-				rayPitch = (y - (m_rayConfig.yResolution / 2)) - m_frame.viewPitch;
+				xEnd++;
 			}
-			if (rayPitch == 0)
+
+			if (!bThroughPortal)
 			{
-				continue;
+				m_planesKernel(row, xStart, xEnd);
 			}
-
-			// Forward distance from the camera to hit the floor for the current row.
-			// 0.5 is the z position exactly in the middle between floor and ceiling.
-			float rowDistance[2];
-			const float defaultDistance = m_frame.viewHeight / rayPitch;
-			rowDistance[0] = defaultDistance * m_frame.planeHeights.x;
-			rowDistance[1] = defaultDistance * m_frame.planeHeights.y;
-
-			// Vector representing position offset equivalent to 1 pixel right (imagine topdown 2D view, this 'jumps' horizontally by 1 ray)
-			Vector2f rayStep[2];
-			const Vector2f rayPixelWidth = (m_frame.fovMaxAngle - m_frame.fovMinAngle) / m_rayConfig.xResolution;
-			rayStep[0] = rowDistance[0] * rayPixelWidth;
-			rayStep[1] = rowDistance[1] * rayPixelWidth;
-
-			// endpoint of first ray in row (left)
-			// essentially the 'left-most ray' along a length (depth) of rowDistance
-			Vector2f rayEnd[2];
-			rayEnd[0] = m_frame.viewPos + rowDistance[0] * m_frame.fovMinAngle;
-			rayEnd[1] = m_frame.viewPos + rowDistance[1] * m_frame.fovMinAngle;
-
-			// calculate 'depth' for this strip of floor (same depth will be shared for all drawn pixels in one row of X)
-			Vector2f rayStart[2];
-			float rayDepth[2];
-			rayStart[0] = m_frame.viewPos + Projection(rowDistance[0] * m_frame.fovMinAngle, m_frame.viewForward.Normal());
-			rayStart[1] = m_frame.viewPos + Projection(rowDistance[1] * m_frame.fovMinAngle, m_frame.viewForward.Normal());
-			rayDepth[0] = (rayEnd[0] - rayStart[0]).Length() / m_rayConfig.farClip;
-			rayDepth[1] = (rayEnd[1] - rayStart[1]).Length() / m_rayConfig.farClip;
-
-			// Indexes into texture/depth arrays for the start of the row equal to Y value
-			const int rowIndex = y * m_rayConfig.xResolution;
-
-			// Draw background texture
-			for (int x = 0; x < m_rayConfig.xResolution; ++x)
+			else
 			{
-				// Prevent drawing floor textures behind camera
-				if (rowDistance[0] > 0)
+				for (int x = xStart; x < xEnd; x++)
 				{
-					for (int layer = 0; layer < 2; layer++)
+					u32 texel;
+					Spear::BackgroundDepth depth;
+					if (!SamplePlanePixel(row, x, texel, depth))
 					{
-						// Get samplePoint via our portalTraces if world is using portals 
-						Vector2f samplePoint = m_bPortalRenderingEnabled ? m_portalTraces[x].GetPointAtTraceDistance((rayEnd[layer] - m_frame.viewPos).Length()) : rayEnd[layer];
-					
-						// Render floor
-						const int mapCellX = (int)(samplePoint.x);
-						const int mapCellY = (int)(samplePoint.y);
-
-						if (const GridNode* node = m_map->GetNode(mapCellX, mapCellY))
-						{
-							// Floor tex sampling
-							if ((bIsFloor && node->texIdFloor[layer] != eLevelTextures::TEX_NONE) || (!bIsFloor && node->texIdRoof[layer] != eLevelTextures::TEX_NONE))
-							{
-								const SDL_Surface* pWorldTexture = pMapTextures->GetSDLSurface(bIsFloor ? node->texIdFloor[layer] : node->texIdRoof[layer]);
-								ASSERT(pWorldTexture);
-
-								int texX = static_cast<int>((samplePoint.x - mapCellX) * pWorldTexture->w);
-								int texY = static_cast<int>((samplePoint.y - mapCellY) * pWorldTexture->h);
-								if (texX < 0)
-									texX += pWorldTexture->w;
-								if (texY < 0)
-									texY += pWorldTexture->h;
-
-								ASSERT(texX < pWorldTexture->w);
-								ASSERT(texY < pWorldTexture->h);
-								Uint32* pixel = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pWorldTexture->pixels) + (texY * pWorldTexture->pitch) + (texX * pWorldTexture->format->BytesPerPixel));
-								Uint8 r, g, b, a;
-								SDL_GetRGBA(*pixel, pWorldTexture->format, &r, &g, &b, &a);
-
-								const int textureArrayIndex{ rowIndex + x };
-								GLuint& colByte = m_bgTexRGBA[textureArrayIndex];
-								colByte |= (r << 0);
-								colByte |= (g << 8);
-								colByte |= (b << 16);
-								colByte |= (a << 24);
-
-								m_bgTexDepth[textureArrayIndex] = rayDepth[layer];
-
-								// We're drawing the floors nearest-first, so break this inner for-loop as soon as we draw a pixel (ie. no need to calculate pixels BEHIND this)
-								break;
-							}
-						}
+						texel = 0;
+						depth = row.clearDepth;
 					}
-					rayEnd[0] += rayStep[0];
-					rayEnd[1] += rayStep[1];
+					row.pOutRGBA[x] = texel;
+					row.pOutDepth[x] = depth;
 				}
 			}
+			xStart = xEnd;
 		}
+	}
+}
 
-		return 0;
-	};
-	START_PROFILE("Raycast Planes")
-	Spear::TaskHandle RaycastPlanesTaskHandle;
-	threader.DispatchTaskDistributed(RaycastPlanesTask, &RaycastPlanesTaskHandle, m_softwareRenderingThreads);
-	RaycastPlanesTaskHandle.WaitForTaskComplete();
-	END_PROFILE("Raycast Planes")
-
-	// Using DDA (digital differential analysis) to quickly calculate intersections
-	auto RaycastWallsTask = [](int taskId)
+void Raycaster::ResolvePlaneLayerIds(const PlaneRowParams& row, bool bIsFloor, u8* pOutLayerIds)
+{
+	// Each layer writes its own depth across the whole row, so depth tells us which layer (if any) produced each pixel
+	const u8 layerIds[2]{ PlaneLayerId(bIsFloor, 0), PlaneLayerId(bIsFloor, 1) };
+	for (int x = 0; x < row.pixelCount; x++)
 	{
-		const Spear::TextureBase* pMapTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(0);
+		const Spear::BackgroundDepth depth = row.pOutDepth[x];
+		pOutLayerIds[x] = depth == row.rayDepth[0] ? layerIds[0] : (depth == row.rayDepth[1] ? layerIds[1] : 0);
+	}
+}
 
-		int xLowerBound = XResolutionPerThread() * taskId;
-		int xUpperBound = taskId == m_softwareRenderingThreads - 1 ? m_rayConfig.xResolution : xLowerBound + XResolutionPerThread(); // avoid skipping pixels under non-perfect division
+bool Raycaster::PortalsInView()
+{
+	if (!m_bPortalRenderingEnabled)
+	{
+		return false;
+	}
 
-		for (int screenX = xLowerBound; screenX < xUpperBound; screenX++) // for the chunk of X pixels allocated to this thread...
+	for (int x = 0; x < m_rayConfig.xResolution; x++)
+	{
+		if (m_portalTraces[x].finalTrace > 0)
 		{
-			Vector2f rayStart = m_frame.viewPos;
-			Vector2f rayEnd{ m_frame.screenPlaneEdgePositionL - (m_frame.raySpacingDir * m_frame.raySpacingLength * screenX) };
-			Vector2f rayDir = Normalize(rayEnd - rayStart);
+			return true;
+		}
+	}
+	return false;
+}
 
-			Vector2f rayUnitStepSize{ sqrt(1 + (rayDir.y / rayDir.x) * (rayDir.y / rayDir.x)),		// length required to travel 1 X unit in Ray Direction
-										sqrt(1 + (rayDir.x / rayDir.y) * (rayDir.x / rayDir.y)) };	// length required to travel 1 Y unit in Ray Direction
+bool Raycaster::CanReprojectPlanes(bool bPortalsInView)
+{
+	// Portals fold the planes onto themselves, so a point's previous screen position can't be found by projection alone
+	if (!m_planeHistory.bValid || bPortalsInView || m_planeHistory.bPortalsInView)
+	{
+		return false;
+	}
 
-			Vector2i mapCheck = rayStart.ToInt(); // truncation will 'snap' position to tile
-			Vector2f rayLength1D; // total length of ray: via x units, via y units
-			Vector2i step;
+	// Anything which changes the projection of every row at once
+	const RaycastFrameData& previous = m_planeHistory.frame;
+	if (previous.viewHeight != m_frame.viewHeight || previous.fov != m_frame.fov || previous.planeHeights != m_frame.planeHeights)
+	{
+		return false;
+	}
 
-			// ====================================
-			// PREPARE INITIAL RAY LENGTH/DIRECTION
-			// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
-			if (rayDir.x < 0)
-			{
-				// going left
-				step.x = -1;
+	// Large camera motion leaves too much of the screen unseen last frame to be worth reprojecting
+	const Vector2f moved = m_frame.viewPos - previous.viewPos;
+	return Dot(moved, moved) <= PLANE_REPROJECT_MAX_MOVE * PLANE_REPROJECT_MAX_MOVE
+		&& Dot(m_frame.viewForward, previous.viewForward) >= cos(PLANE_REPROJECT_MAX_TURN)
+		&& std::abs(m_frame.viewPitch - previous.viewPitch) <= PLANE_REPROJECT_MAX_PITCH * m_rayConfig.yResolution;
+}
 
-				// calculate ray length needed to reach left edge. Example: rayStart position of (7.33) - 7 leaves us with: 0.33 (ie. we are 33% across this tile)
-				// 0.33 * rayUnitStepsize = length of the ray to travel 1 unit in X, scaled by the actual distance from edge
-				rayLength1D.x = (rayStart.x - static_cast<float>(mapCheck.x)) * rayUnitStepSize.x;
-			}
-			else
+void Raycaster::ReprojectPlaneRow(const PlaneRowParams& row, bool bIsFloor, u8* pOutLayerIds)
+{
+	const RaycastFrameData& previous = m_planeHistory.frame;
+	const GLuint* pPreviousRGBA = m_planeHistory.pRGBA[!m_planeHistory.current];
+	const u8* pPreviousLayerIds = m_planeHistory.pLayerIds[!m_planeHistory.current];
+	const int xResolution = m_rayConfig.xResolution;
+	const int yResolution = m_rayConfig.yResolution;
+
+	// Inverse of PreparePlaneRow for the previous camera: a point's forward depth gives its row (via rowDistance and rayPitch), its offset along the fov span gives its column
+	const Vector2f fovSpan = previous.fovMaxAngle - previous.fovMinAngle;
+	const float cosHalfFov = Dot(previous.fovMinAngle, previous.viewForward);
+	const float spanScale = cosHalfFov / Dot(fovSpan, fovSpan);
+	const float horizon = bIsFloor ? static_cast<float>((yResolution - 1) - (yResolution / 2)) + previous.viewPitch : static_cast<float>(yResolution / 2) + previous.viewPitch;
+
+	// Sample points step linearly across the row, so their depth and span offset relative to the previous camera do too
+	struct LayerProjection
+	{
+		float depthStart;
+		float depthStep;
+		float spanStart;
+		float spanStep;
+		float pitchScale; // rayPitch * depth
+		u8 layerId;
+	};
+	LayerProjection projections[2];
+	for (int layer = 0; layer < 2; layer++)
+	{
+		const Vector2f offset = row.rayEnd[layer] - previous.viewPos;
+		projections[layer].depthStart = Dot(offset, previous.viewForward);
+		projections[layer].depthStep = Dot(row.rayStep[layer], previous.viewForward);
+		projections[layer].spanStart = Dot(offset, fovSpan);
+		projections[layer].spanStep = Dot(row.rayStep[layer], fovSpan);
+		projections[layer].pitchScale = previous.viewHeight * (layer == 0 ? previous.planeHeights.x : previous.planeHeights.y) * cosHalfFov;
+		projections[layer].layerId = PlaneLayerId(bIsFloor, layer);
+	}
+
+	for (int x = 0; x < row.pixelCount; x++)
+	{
+		bool bResolved{ false };
+		for (int layer = 0; layer < 2; layer++)
+		{
+			const LayerProjection& projection = projections[layer];
+			const float depth = projection.depthStart + (projection.depthStep * x);
+			if (depth < PLANE_REPROJECT_MIN_DEPTH)
 			{
-				// going right
-				step.x = 1;
+				break;
+			}
 
-				// calculate length to reach right edge. Example: 8 - position (7.33) = 0.66, multiplied by length of 1 x unit in ray direction
-				rayLength1D.x = (static_cast<float>(mapCheck.x + 1) - rayStart.x) * rayUnitStepSize.x;
+			const float invDepth = 1.f / depth;
+			const float previousX = xResolution * (((projection.spanStart + (projection.spanStep * x)) * invDepth * spanScale) + 0.5f);
+			const float rayPitch = projection.pitchScale * invDepth;
+			const float previousY = bIsFloor ? horizon - rayPitch : horizon + rayPitch;
+			if (!(previousX >= -0.5f && previousX < xResolution - 0.5f && previousY >= -0.5f && previousY < yResolution - 0.5f))
+			{
+				break;
 			}
-			if (rayDir.y < 0)
+
+			const int previousIndex = static_cast<int>(previousX + 0.5f) + (static_cast<int>(previousY + 0.5f) * xResolution);
+			const u8 previousLayerId = pPreviousLayerIds[previousIndex];
+			if (previousLayerId == projection.layerId)
 			{
-				step.y = -1;
-				rayLength1D.y = (rayStart.y - static_cast<float>(mapCheck.y)) * rayUnitStepSize.y;
+				row.pOutRGBA[x] = pPreviousRGBA[previousIndex];
+				row.pOutDepth[x] = row.rayDepth[layer];
+				pOutLayerIds[x] = previousLayerId;
+				bResolved = true;
+				break;
 			}
-			else
+
+			// Last frame saw straight through this layer here (to the outer layer, or to nothing), so it has no texture at this point
+			if (layer == 0 && (previousLayerId == 0 || previousLayerId == projections[1].layerId))
 			{
-				step.y = 1;
-				rayLength1D.y = (static_cast<float>(mapCheck.y + 1) - rayStart.y) * rayUnitStepSize.y;
+				continue;
 			}
 
-			// ====================================
-			// DETERMINE RAY LENGTH
-			// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
-			int rayEncounters{ 0 }; // track how many walls this ray has encountered (used to render tall walls behind short walls)
-			eRayHit rayHit{ RAY_NOHIT };
-			float distance{ 0.f };
-			int wallNodeIndex{ 0 };
-			while (rayEncounters < m_rayConfig.rayEncounterLimit && distance < m_rayConfig.farClip)
+			// Neither layer has a texture here
+			if (layer == 1 && previousLayerId == 0)
 			{
-				rayHit = RAY_NOHIT;
-				while (rayHit == RAY_NOHIT && distance < m_rayConfig.farClip)
-				{
-					bool side{ false };
-					if (rayLength1D.x < rayLength1D.y)
-					{
-						// X distance is currently shortest, increase X
-						mapCheck.x += step.x;
-						distance = rayLength1D.x;
-						rayLength1D.x += rayUnitStepSize.x; // increase ray by 1 X unit
+				row.pOutRGBA[x] = 0;
+				row.pOutDepth[x] = row.clearDepth;
+				pOutLayerIds[x] = 0;
+				bResolved = true;
+			}
+			break;
+		}
 
-						side = true;
-					}
-					else
-					{
-						// Y distance is currently shortest, increase Y
-						mapCheck.y += step.y;
-						distance = rayLength1D.y;
-						rayLength1D.y += rayUnitStepSize.y; // increase ray by 1 Y unit
-					}
+		// Off-screen or hidden by something else last frame: sample it this frame instead
+		if (!bResolved)
+		{
+			RaycastPlanesKernel::DrawPixelsScalar(row, x, x + 1);
+			const Spear::BackgroundDepth depth = row.pOutDepth[x];
+			pOutLayerIds[x] = depth == row.rayDepth[0] ? projections[0].layerId : (depth == row.rayDepth[1] ? projections[1].layerId : 0);
+		}
+	}
+}
 
-					// Check position is within range of array
-					if (const GridNode* node = m_map->GetNode(mapCheck))
-					{
-						wallNodeIndex = mapCheck.x + (mapCheck.y * m_map->gridWidth);
-						
-						if (m_bPortalRenderingEnabled)
-						{
-							// is tile a mirror of any kind?
-							if (node->specialFlag == SPECIAL_MIRROR || node->specialFlag == SPECIAL_MIRROR_PORTAL || node->specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
-							{							
-								// flip ray direction and depenetrate mirror
-								if (node->specialFlag != SPECIAL_MIRROR) // if not a basic mirror, this must be a portal mirror with an inverted image
-								{
-									step *= -1;
-								
-									if (node->specialFlag == SPECIAL_MIRROR_PORTAL_CONJOINED)
-									{
-										// If multiple MirrorPortalConjoined are touching, do some extra processing to treat them as a single inverted mirror, otherwise the image gets split up
-										mapCheck = m_map->GetExitTileForConjoinedPortal(mapCheck, side);
-									}
-								}
-								else // standard mirror, no special behaviour
-								{
-									side ? step.x *= -1 : step.y *= -1;
-								}
-								side ? mapCheck.x += step.x : mapCheck.y += step.y;
-							}
-						}
-						
-						// if tile has any wall textures we can draw those here (if the tile is also a mirror that's still fine since we can draw cutout textures over it for extra detail)
-						const bool wallExists = node->texIdWall != TEX_NONE || (node->extendUp && node->texIdRoof[0] != TEX_NONE) || (node->extendDown && node->texIdFloor[0] != TEX_NONE);
-						if (wallExists)
-						{
-							rayHit = side ? RAY_HIT_SIDE : RAY_HIT_FRONT;
-							rayEncounters++;
-						}
-					}
-					else
-					{
-						// if ray has left the grid, might as well quit here
-						break;
-					}
-				}
+// Separate full-screen passes: planes by row, walls by column (depth tested against the planes), then sprites by row
+// The planes pass writes every pixel (empty pixels get cleared values), so the buffers never need clearing beforehand
+void Raycaster::RaycastPassesCPU()
+{
+	Spear::ThreadManager& threader = Spear::ServiceLocator::GetThreadManager();
+	
+	// Floor/Ceiling Casting
+	const bool bHalfRatePlanes = m_bHalfRatePlanes;
+	const bool bPortalsInView = PortalsInView();
+	const bool bReprojectPlanes = bHalfRatePlanes && CanReprojectPlanes(bPortalsInView);
+	const RaycastPlanesKernel::RowFunction DrawPlaneRowVariant = bPortalsInView ? &DrawPlaneRow<true> : &DrawPlaneRow<false>;
+	auto RaycastPlanesTask = [bHalfRatePlanes, bReprojectPlanes, DrawPlaneRowVariant](int yLowerBound, int yUpperBound)
+	{
+		const Spear::TextureBase* pMapTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(0);
+		GLuint* pHistoryRGBA = m_planeHistory.pRGBA[m_planeHistory.current];
+		u8* pHistoryLayerIds = m_planeHistory.pLayerIds[m_planeHistory.current];
+		std::vector<Spear::BackgroundDepth> rowDepth;
 
-				// ====================================
-				// RENDER
-				// vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
-				if (rayHit)
+		for (int y = yLowerBound; y < yUpperBound; y++) // for the chunk of Y pixels claimed by this thread...
+		{
+			const int rowIndex = y * m_rayConfig.xResolution;
+			PlaneRowParams row;
+			if (!PreparePlaneRow(y, pMapTextures, row))
+			{
+				ClearRows(y, y + 1);
+				if (bHalfRatePlanes)
 				{
-					Vector2f intersection{ rayStart + rayDir * distance };
-					float depth{ Projection(intersection - m_frame.viewPos, m_frame.viewForward * m_rayConfig.farClip).Length() };
-					float renderDepth = depth / m_rayConfig.farClip;
-					const float halfHeight{ (1 + (m_rayConfig.yResolution / 2) / depth) * m_frame.fovWallMultiplier };
-					const float fullHeight{ halfHeight * 2};
-
-					int mid{ static_cast<int>(m_frame.viewPitch + (m_rayConfig.yResolution / 2)) };
-					float bottom{ mid - halfHeight };
-					float top{ mid + halfHeight };
-
-					// Draw textured vertical line segments for wall
-					bool bWallFinished = false;
-					int renderingUp = 0;
-					int renderingDown = 0;
-
-					GridNode& node = m_map->pNodes[wallNodeIndex];
-					const SDL_Surface* pWallTexture{ nullptr };
-					
-					int texX = -1;
-					auto CalcTexX = [&]()
-					{
-						// X Index into WallTexture = x position inside cell
-						float percentageIntoTexture = rayHit == RAY_HIT_FRONT ? (intersection.x - static_cast<int>(intersection.x)) : (intersection.y - static_cast<int>(intersection.y));
-						texX = static_cast<int>(percentageIntoTexture * (pWallTexture->w - 1));
-						if (texX < 0)
-						{
-							texX += pWallTexture->w;
-						}
-						if ((rayHit == RAY_HIT_SIDE && rayDir.x < 0)
-						|| (rayHit == RAY_HIT_FRONT && rayDir.y < 0))
-						{
-							texX = (pWallTexture->w - 1) - texX; // keeps texture horizontal direction consistent per side, necessary for maintaing portal illusions
-						}
-						ASSERT(texX < pWallTexture->w && texX >= 0);
-					};
-					if (node.texIdWall != TEX_NONE)
-					{
-						pWallTexture = pMapTextures->GetSDLSurface(node.texIdWall);
-						CalcTexX();
-					}
+					std::fill(pHistoryRGBA + rowIndex, pHistoryRGBA + rowIndex + m_rayConfig.xResolution, 0);
+					std::fill(pHistoryLayerIds + rowIndex, pHistoryLayerIds + rowIndex + m_rayConfig.xResolution, 0);
+				}
+				continue;
+			}
 
-					while (!bWallFinished)
-					{
-						// Loop to draw various wall strips. First used to draw 'core' wall strip. Then, upper wall strips, followed by lower wall strips.
-						for (int screenY = std::max(0, static_cast<int>(bottom)); screenY <= static_cast<int>(top); screenY++)
-						{
-							// Respect any drawFlags specified in editor 
-							if (node.drawFlags != eDrawFlags::DRAW_DEFAULT)
-							{
-								if (rayHit == RAY_HIT_SIDE)
-								{
-									if (rayDir.x > 0 && !(node.drawFlags & DRAW_W))
-									{
-										break;
-									}
-									if (rayDir.x < 0 && !(node.drawFlags & DRAW_E))
-									{
-										break;
-									}
-								}
-								else
-								{
-									if (rayDir.y > 0 && !(node.drawFlags & DRAW_N))
-									{
-										break;
-									}
-									if (rayDir.y < 0 && !(node.drawFlags & DRAW_S))
-									{
-										break;
-									}
-								}
-							}
+			if (!bHalfRatePlanes)
+			{
+				DrawPlaneRowVariant(row);
+				continue;
+			}
 
-							// Walls can be drawn based on Floor/Wall/Roof. As such, certain visits to this loop may have no texture active and should be skipped.
-							if (!pWallTexture)
-							{
-								break;
-							}
+			// Draw into the history first (the output buffers may be mapped upload memory, which is slow to read back) then copy out
+			GLuint* pOutRGBA = row.pOutRGBA;
+			Spear::BackgroundDepth* pOutDepth = row.pOutDepth;
+			rowDepth.resize(row.pixelCount);
+			row.pOutRGBA = pHistoryRGBA + rowIndex;
+			row.pOutDepth = rowDepth.data();
+			if (bReprojectPlanes && (y & 1) != m_planeHistory.rowParity)
+			{
+				ReprojectPlaneRow(row, IsFloorRow(y), pHistoryLayerIds + rowIndex);
+			}
+			else
+			{
+				DrawPlaneRowVariant(row);
+				ResolvePlaneLayerIds(row, IsFloorRow(y), pHistoryLayerIds + rowIndex);
+			}
+			std::copy(row.pOutRGBA, row.pOutRGBA + row.pixelCount, pOutRGBA);
+			std::copy(row.pOutDepth, row.pOutDepth + row.pixelCount, pOutDepth);
+		}
+	};
+	StartPhase(PHASE_RAYCAST_PLANES);
+	threader.ParallelFor(0, m_rayConfig.yResolution, Spear::ThreadManager::AUTO_GRAIN, RaycastPlanesTask);
+	EndPhase(PHASE_RAYCAST_PLANES);
 
-							// If we go off the bottom of the screen, skip any remaining wall strip.
-							if (screenY >= m_rayConfig.yResolution)
-							{
-								break;
-							}
+	// Keep this frame's planes (before walls/sprites cover them) for the next frame to reproject from
+	m_planeHistory.bValid = bHalfRatePlanes;
+	if (bHalfRatePlanes)
+	{
+		m_planeHistory.frame = m_frame;
+		m_planeHistory.bPortalsInView = bPortalsInView;
+		m_planeHistory.current ^= 1;
+		m_planeHistory.rowParity ^= 1;
+	}
 
-							// Draw only if our depth is nearer than any existing pixel
-							const int screenIndex{ screenX + (screenY * m_rayConfig.xResolution) };
-							if (renderDepth < m_bgTexDepth[screenIndex])
-							{
-								// Y Index into WallTexture = percentage through current Y forloop
-								int texY = (pWallTexture->h - 1) - static_cast<int>((static_cast<float>(screenY - static_cast<int>(bottom)) / (static_cast<int>(top) - static_cast<int>(bottom))) * (pWallTexture->h - 1));
-								ASSERT(texY < pWallTexture->h && texY >= 0);
-
-								Uint32* pixel = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pWallTexture->pixels) + (texY * pWallTexture->pitch) + (texX * pWallTexture->format->BytesPerPixel));
-								Uint8 r, g, b, a;
-								SDL_GetRGBA(*pixel, pWallTexture->format, &r, &g, &b, &a);
-								if (!a)
-								{
-									continue;
-								}
-
-								GLuint& colByte = m_bgTexRGBA[screenIndex];
-								colByte = 0;
-								colByte |= (r << 0);
-								colByte |= (g << 8);
-								colByte |= (b << 16);
-								colByte |= (a << 24);
-
-								m_bgTexDepth[screenIndex] = renderDepth;
-							}
-						}
+	// Using DDA (digital differential analysis) to quickly calculate intersections
+	const WallColumnFunction RaycastWallColumnVariant = SelectWallColumn();
+	auto RaycastWallsTask = [RaycastWallColumnVariant](int xLowerBound, int xUpperBound)
+	{
+		const Spear::TextureBase* pMapTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(0);
+		for (int screenX = xLowerBound; screenX < xUpperBound; screenX++) // for the chunk of X pixels claimed by this thread...
+		{
+			RaycastWallColumnVariant(screenX, pMapTextures, nullptr);
+		}
+	};
+	StartPhase(PHASE_RAYCAST_WALLS);
+	threader.ParallelFor(0, m_rayConfig.xResolution, Spear::ThreadManager::AUTO_GRAIN, RaycastWallsTask);
+	EndPhase(PHASE_RAYCAST_WALLS);
 
-						// Lambda function used to cleanup picture. Corrects small pixel gaps formed by Roof/Floor extending into walls above/below the playspace.
-						auto FixSeams = [&](int yStart, int yStep, const GLuint& correctivePixel)
-						{
-							yStart += yStep;
-							constexpr int seamCorrectionLimit{ 10 };
-							const int seamCorrectionEnd = yStart + (seamCorrectionLimit * yStep);
+	// Each tile only draws the sprites binned into it, so cost follows the screen area sprites cover rather than threads x sprites
+	auto RaycastSpritesTask = [](int tileLowerBound, int tileUpperBound)
+	{
+		const Spear::TextureBase* pSpriteTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(GlobalTextureBatches::BATCH_SPRITESET_1);
+		for (int tileIndex = tileLowerBound; tileIndex < tileUpperBound; tileIndex++) // for the chunk of tiles claimed by this thread...
+		{
+			DrawSpriteTile(tileIndex, pSpriteTextures, 0, m_rayConfig.xResolution);
+		}
+	};
+	StartPhase(PHASE_RAYCAST_SPRITES);
+	threader.ParallelFor(0, m_spriteTilesX * m_spriteTilesY, Spear::ThreadManager::AUTO_GRAIN, RaycastSpritesTask);
+	EndPhase(PHASE_RAYCAST_SPRITES);
+}
 
-							// Detect whether this strip is a seam or just the end of a wall
-							bool bIsSeam{ false };
-							for (int screenY = yStart; std::abs(screenY - seamCorrectionEnd) > 0; screenY += yStep)
-							{
-								if (screenY >= m_rayConfig.yResolution || screenY < 0)
-								{
-									continue;
-								}
-
-								const int screenIndex{ screenX + (screenY * m_rayConfig.xResolution) };
-								GLuint& nextColByte = m_bgTexRGBA[screenIndex];
-								bool nextByteIsInDepthRange = abs(m_bgTexDepth[screenIndex] - renderDepth) < m_rayConfig.correctivePixelDepthTolerance;
-								if (nextColByte && nextByteIsInDepthRange)
-								{
-									bIsSeam = true;
-									break;
-								}
-							}
-							if (!bIsSeam)
-							{
-								return;
-							}
+// Each thread renders whole columns start to finish: walls front-to-back, then only the floor/ceiling not hidden behind them, then sprites.
+// Avoids the barriers between separate passes and most of their overdraw (especially where tall walls cover most of the screen)
+void Raycaster::RaycastColumnsCPU()
+{
+	// Row setup is shared by every column, so prepare it once up front
+	const Spear::TextureBase* pMapTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(0);
+	for (int y = 0; y < m_rayConfig.yResolution; y++)
+	{
+		if (!PreparePlaneRow(y, pMapTextures, m_planeRows[y]))
+		{
+			m_planeRows[y].pixelCount = 0;
+		}
+	}
 
-							// If this is a seam (ie. wall connected to floor/ceiling) fill pixels sequentially until first non-empty pixel is reached
-							for (int screenY = yStart; std::abs(screenY - seamCorrectionEnd) > 0; screenY += yStep)
-							{
-								if (screenY >= m_rayConfig.yResolution || screenY < 0)
-								{
-									continue;
-								}
-
-								const int screenIndex{ screenX + (screenY * m_rayConfig.xResolution) };
-								GLuint& nextColByte = m_bgTexRGBA[screenIndex];
-								bool nextByteIsInDepthRange = abs(m_bgTexDepth[screenIndex] - renderDepth) < m_rayConfig.correctivePixelDepthTolerance;
-								if (nextColByte == 0 || !nextByteIsInDepthRange)
-								{
-									if (m_rayConfig.highlightCorrectivePixels)
-									{
-										nextColByte |= (255 << 0);
-										nextColByte |= (0 << 8);
-										nextColByte |= (0 << 16);
-										nextColByte |= (255 << 24);
-									}
-									else
-									{
-										nextColByte = correctivePixel;
-									}
-									m_bgTexDepth[screenIndex] = renderDepth;
-								}
-								else
-								{
-									break;
-								}
-							}
-						};
+	const WallColumnFunction RaycastWallColumnVariant = SelectWallColumn();
+	auto RaycastColumnsTask = [RaycastWallColumnVariant](int xLowerBound, int xUpperBound)
+	{
+		const Spear::TextureBase* pMapTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(0);
+		const Spear::TextureBase* pSpriteTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(GlobalTextureBatches::BATCH_SPRITESET_1);
+		const Spear::BackgroundDepth clearDepth = Spear::ToBackgroundDepth(m_rayConfig.farClip);
+		std::vector<ColumnSeam> seams;
 
-						// Prepare data for next iteration to render upper wall strips.
-						if (node.extendUp > renderingUp++)
-						{
-							bottom = top + 1;
-							top = bottom + fullHeight;
-							
-							if (node.texIdRoof[0] != TEX_NONE)
-							{
-								pWallTexture = pMapTextures->GetSDLSurface(node.texIdRoof[0]);
-							}
-							else if (node.texIdWall != TEX_NONE)
-							{
-								pWallTexture = pMapTextures->GetSDLSurface(node.texIdWall);
-							}
-							else
-							{
-								pWallTexture = nullptr;
-							}
+		for (int screenX = xLowerBound; screenX < xUpperBound; screenX++) // for the chunk of X pixels claimed by this thread...
+		{
+			// Walls depth test against each other, so the column is cleared first (while it's being pulled into cache anyway)
+			for (int y = 0; y < m_rayConfig.yResolution; y++)
+			{
+				const int screenIndex{ screenX + (y * m_rayConfig.xResolution) };
+				m_bgTexRGBA[screenIndex] = 0;
+				m_bgTexDepth[screenIndex] = clearDepth;
+			}
 
-							if (texX == -1 && pWallTexture)
-							{
-								CalcTexX();
-							}
+			seams.clear();
+			RaycastWallColumnVariant(screenX, pMapTextures, &seams);
 
-							if (pWallTexture && renderingUp == 1 && node.texIdWall == TEX_NONE)
-							{
-								const Uint32* correctivePixel = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pWallTexture->pixels) + ((pWallTexture->w - 1) * pWallTexture->pitch) + (texX * pWallTexture->format->BytesPerPixel));
-								Uint8 r, g, b, a;
-								SDL_GetRGBA(*correctivePixel, pWallTexture->format, &r, &g, &b, &a);
-								FixSeams(bottom, -1, r | (g << 8) | (b << 16) | (a << 24));
-							}
-						}
-						// Prepare data for next iteration to render lower wall strips.
-						else if (node.extendDown > renderingDown++)
-						{
-							if (renderingDown == 1)
-							{
-								bottom = mid - halfHeight;
-								top = mid + halfHeight;
-							}
-							top = bottom - 1;
-							bottom = top - fullHeight;
-							
-							if (node.texIdFloor[0] != TEX_NONE)
-							{
-								pWallTexture = pMapTextures->GetSDLSurface(node.texIdFloor[0]);
-							}
-							else if (node.texIdWall != TEX_NONE)
-							{
-								pWallTexture = pMapTextures->GetSDLSurface(node.texIdWall);
-							}
-							else
-							{
-								pWallTexture = nullptr;
-							}
+			for (int y = 0; y < m_rayConfig.yResolution; y++)
+			{
+				const PlaneRowParams& row = m_planeRows[y];
+				if (row.pixelCount == 0)
+				{
+					continue;
+				}
 
-							if (texX == -1 && pWallTexture)
-							{
-								CalcTexX();
-							}
+				// Wall pixels are always opaque, so any colour here is a wall. Skip sampling if it's nearer than either plane layer could be.
+				const int screenIndex{ screenX + (y * m_rayConfig.xResolution) };
+				const bool bHasWall = m_bgTexRGBA[screenIndex] != 0;
+				if (bHasWall && m_bgTexDepth[screenIndex] < std::min(row.rayDepth[0], row.rayDepth[1]))
+				{
+					continue;
+				}
 
-							if (pWallTexture && renderingDown == 1 && node.texIdWall == TEX_NONE)
-							{
-								const Uint32* correctivePixel = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pWallTexture->pixels) + (texX * pWallTexture->format->BytesPerPixel));
-								Uint8 r, g, b, a;
-								SDL_GetRGBA(*correctivePixel, pWallTexture->format, &r, &g, &b, &a);
-								FixSeams(top, 1, r | (g << 8) | (b << 16) | (a << 24));
-							}
-						}
-						else
-						{
-							bWallFinished = true;
-						}
-					}
+				// Walls only draw over planes when strictly nearer, so the plane wins ties
+				u32 texel;
+				Spear::BackgroundDepth depth;
+				if (SamplePlanePixel(row, screenX, texel, depth) && (!bHasWall || depth <= m_bgTexDepth[screenIndex]))
+				{
+					m_bgTexRGBA[screenIndex] = texel;
+					m_bgTexDepth[screenIndex] = depth;
 				}
 			}
+
+			for (const ColumnSeam& seam : seams)
+			{
+				FixColumnSeam(screenX, seam);
+			}
+
+			// Down the column through each tile it passes, so only the sprites binned there are visited
+			for (int tileIndex = screenX / SPRITE_TILE_WIDTH; tileIndex < m_spriteTilesX * m_spriteTilesY; tileIndex += m_spriteTilesX)
+			{
+				DrawSpriteTile(tileIndex, pSpriteTextures, screenX, screenX + 1);
+			}
 		}
-		return 0;
 	};
-	START_PROFILE("Raycast Walls")
-	Spear::TaskHandle RaycastWallsTaskHandle;
-	threader.DispatchTaskDistributed(RaycastWallsTask, &RaycastWallsTaskHandle, m_softwareRenderingThreads);
-	RaycastWallsTaskHandle.WaitForTaskComplete();
-	END_PROFILE("Raycast Walls")
 
-	auto RaycastSpritesTask = [](int taskId)
-	{
-		const Vector2i cutoffMin(0, YResolutionPerThread() * taskId);
-		const Vector2i cutoffMax(m_rayConfig.xResolution, YResolutionPerThread() * (taskId + 1));
+	Spear::ServiceLocator::GetThreadManager().ParallelFor(0, m_rayConfig.xResolution, Spear::ThreadManager::AUTO_GRAIN, RaycastColumnsTask);
+}
 
-		const Spear::TextureBase* pSpriteTextures = Spear::ServiceLocator::GetScreenRenderer().GetBatchTextures(GlobalTextureBatches::BATCH_SPRITESET_1);
+void Raycaster::DrawSpriteColumn(const RaycastSpriteData& sprite, const SpriteSampling& sampling, const Spear::TextureBase* pSpriteTextures, int screenX, int yLowerBound, int yUpperBound)
+{
+	const int texWidth = pSpriteTextures->GetWidth();
+	const int texHeight = pSpriteTextures->GetHeight();
+	const int texX = static_cast<int>(std::min<s64>(texWidth - 1, ((screenX - sprite.spriteStart.x) * sampling.texXStep) >> 16));
+	const u32* pColumn = pSpriteTextures->GetTexelsRGBAColumnMajor(sprite.spriteTex) + (texX * texHeight);
+
+	// Only the opaque runs of the texture column are visited. Without them, the whole column is one run and every texel's alpha is tested instead.
+	const Spear::TexelSpan fallback{ 0, static_cast<u16>(texHeight) };
+	int spanCount = 1;
+	const Spear::TexelSpan* pSpans = &fallback;
+	const bool bTestAlpha = !pSpriteTextures->HasOpaqueSpans();
+	if (!bTestAlpha)
+	{
+		pSpans = pSpriteTextures->GetOpaqueSpans(sprite.spriteTex, texX, spanCount);
+	}
 
-		for (int i = 0; i < m_numSpritesToRender; i++)
+	// Row k of the sprite samples texY = min(texHeight - 1, ((texHeight << 16) - (k * texYStep)) >> 16), which only ever decreases down the screen
+	const s64 texYStart = static_cast<s64>(texHeight) << 16;
+	const int yFirst = std::max(yLowerBound, sprite.spriteStart.y);
+	const int yLast = std::min(sprite.spriteEnd.y, yUpperBound - 1);
+	for (int span = 0; span < spanCount; span++)
+	{
+		// Rows whose texY falls within [start, end)
+		int kMin = 0;
+		int kMax = yLast - sprite.spriteStart.y;
+		if (pSpans[span].end < texHeight)
+		{
+			if (sampling.texYStep == 0)
+			{
+				continue;
+			}
+			kMin = std::max<s64>(kMin, ((static_cast<s64>(texHeight - pSpans[span].end) << 16) / sampling.texYStep) + 1);
+		}
+		if (sampling.texYStep != 0)
 		{
-			const SDL_Surface* pSpriteTexture = pSpriteTextures->GetSDLSurface(m_frameSprites[i].spriteTex);
+			kMax = std::min<s64>(kMax, (static_cast<s64>(texHeight - pSpans[span].start) << 16) / sampling.texYStep);
+		}
 
-			for (int y = std::max(cutoffMin.y, m_frameSprites[i].spriteStart.y); y <= std::min(m_frameSprites[i].spriteEnd.y, cutoffMax.y - 1); y++)
+		const int yStart = std::max(yFirst, sprite.spriteStart.y + kMin);
+		const int yEnd = sprite.spriteStart.y + kMax;
+		s64 texY = texYStart - ((yStart - sprite.spriteStart.y) * sampling.texYStep);
+		for (int y = yStart; y <= yEnd; y++, texY -= sampling.texYStep)
+		{
+			const int screenIndex = screenX + (y * m_rayConfig.xResolution);
+			if (sampling.depth < m_bgTexDepth[screenIndex])
 			{
-				for (int x = std::max(cutoffMin.x, m_frameSprites[i].spriteStart.x); x <= std::min(m_frameSprites[i].spriteEnd.x, cutoffMax.x - 1); x++)
+				const u32 texel = pColumn[std::min<s64>(texHeight - 1, texY >> 16)];
+				if (bTestAlpha && !(texel & 0xFF000000))
 				{
-					int screenIndex = x + (y * m_rayConfig.xResolution);
-					if (m_frameSprites[i].spriteDepth < m_bgTexDepth[screenIndex])
-					{
-						int texX = (float(x - m_frameSprites[i].spriteStart.x) / (m_frameSprites[i].spriteEnd.x - m_frameSprites[i].spriteStart.x)) * pSpriteTexture->w;
-						int texY = pSpriteTexture->h - (float(y - m_frameSprites[i].spriteStart.y) / (m_frameSprites[i].spriteEnd.y - m_frameSprites[i].spriteStart.y)) * (pSpriteTexture->h - 1);
-
-						Uint32* pixel = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pSpriteTexture->pixels) + (texY * pSpriteTexture->pitch) + (texX * pSpriteTexture->format->BytesPerPixel));
-						Uint8 r, g, b, a;
-						SDL_GetRGBA(*pixel, pSpriteTexture->format, &r, &g, &b, &a);
-						if (!a)
-						{
-							continue;
-						}
-
-						GLuint& colByte = m_bgTexRGBA[screenIndex];
-						colByte = 0;
-						colByte |= (r << 0);
-						colByte |= (g << 8);
-						colByte |= (b << 16);
-						colByte |= (a << 24);
-
-						m_bgTexDepth[screenIndex] = m_frameSprites[i].spriteDepth;
-					}
+					continue;
 				}
+
+				m_bgTexRGBA[screenIndex] = texel;
+				m_bgTexDepth[screenIndex] = sampling.depth;
 			}
 		}
-
-		return 0;
-	};
-	START_PROFILE("Raycast Sprites")
-	Spear::TaskHandle RaycastSpritesTaskHandle;
-	threader.DispatchTaskDistributed(RaycastSpritesTask, &RaycastSpritesTaskHandle, m_softwareRenderingThreads);
-	RaycastSpritesTaskHandle.WaitForTaskComplete();
-	END_PROFILE("Raycast Sprites")
-
-	START_PROFILE("Raycast Upload")
-	// Upload Raycast image for this frame
-	renderer.SetBackgroundTextureDataRGBA(m_bgTexRGBA, m_bgTexDepth, m_rayConfig.xResolution, m_rayConfig.yResolution);
-	ClearRaycasterArrays();
-	END_PROFILE("Raycast Upload")
+	}
 }
 
 void Raycaster::Draw3DGridCompute(const Vector2f& pos, float pitch, const float angle)
@@ -1278,16 +2440,21 @@ void Raycaster::Draw3DGridCompute(const Vector2f& pos, float pitch, const float
 		m_computeShader.program[0] = Spear::ShaderCompiler::CreateShaderProgram("../Shaders/RaycastPlanesCS.glsl");
 		m_computeShader.program[1] = Spear::ShaderCompiler::CreateShaderProgram("../Shaders/RaycastWallsCS.glsl");
 
-		// GridNodes Binding SSBO (Shader Storage Buffer Object) - Used to pass array data to shader
+		// Map Binding SSBOs (Shader Storage Buffer Object) - Used to pass array data to shader. Map data only changes on Init, so these are not re-uploaded per frame.
 		glGenBuffers(1, &m_computeShader.gridnodesSSBO);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.gridnodesSSBO);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, m_map->TotalNodes() * sizeof(GridNode), m_map->pNodes, GL_STATIC_DRAW);
+		glGenBuffers(1, &m_computeShader.tileFlagsSSBO);
+		glGenBuffers(1, &m_computeShader.chunkSlotsSSBO);
+		UploadMapToGPU();
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_computeShader.gridnodesSSBO); // bind slot 2
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, m_computeShader.tileFlagsSSBO); // bind slot 6 - compact u8 per tile, read by shaders as packed uints
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, m_computeShader.chunkSlotsSSBO); // bind slot 7 - maps each map chunk to its slot in GridNodes/TileFlags
 
 		// Sprites Binding SSBO
 		glGenBuffers(1, &m_computeShader.spritesSSBO);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.spritesSSBO);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, RAYCAST_SPRITE_LIMIT * sizeof(RaycastSpriteData), m_frameSprites, GL_STATIC_DRAW);
+		m_computeShader.spritesCapacity = std::max(m_numSpritesToRender, 1);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_computeShader.spritesCapacity * sizeof(RaycastSpriteData), nullptr, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_numSpritesToRender * sizeof(RaycastSpriteData), m_frameSprites.data());
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_computeShader.spritesSSBO); // bind slot 5
 
 		// RayConfig Binding UBO (Uniform Buffer Object) - Used to pass a single struct as a uniform to shader
@@ -1316,6 +2483,7 @@ void Raycaster::Draw3DGridCompute(const Vector2f& pos, float pitch, const float
 		for (int i = 0; i < m_computeShader.programSize; i++)
 		{
 			m_computeShader.gridDimensionsLoc[i] = glGetUniformLocation(m_computeShader.program[i], "gridDimensions");
+			m_computeShader.chunksXLoc[i] = glGetUniformLocation(m_computeShader.program[i], "chunksX");
 			m_computeShader.worldTexturesLoc[i] = glGetUniformLocation(m_computeShader.program[i], "worldTextures");
 			m_computeShader.spriteTexturesLoc[i] = glGetUniformLocation(m_computeShader.program[i], "spriteTextures");
 			m_computeShader.spriteCountLoc[i] = glGetUniformLocation(m_computeShader.program[i], "spriteCount");
@@ -1325,13 +2493,14 @@ void Raycaster::Draw3DGridCompute(const Vector2f& pos, float pitch, const float
 	{
 		// If buffers already exist, just update the data
 
-		// Upload GridNode data
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.gridnodesSSBO);
-		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_map->TotalNodes() * sizeof(GridNode), m_map->pNodes);
-
-		// Upload Sprites data
+		// Upload Sprites data (growing the buffer, with some headroom, if this frame has more than it can hold)
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_computeShader.spritesSSBO);
-		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_numSpritesToRender * sizeof(RaycastSpriteData), m_frameSprites);
+		if (m_numSpritesToRender > m_computeShader.spritesCapacity)
+		{
+			m_computeShader.spritesCapacity = m_numSpritesToRender * 2;
+			glBufferData(GL_SHADER_STORAGE_BUFFER, m_computeShader.spritesCapacity * sizeof(RaycastSpriteData), nullptr, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_numSpritesToRender * sizeof(RaycastSpriteData), m_frameSprites.data());
 
 		// Upload RayConfig
 		glBindBuffer(GL_UNIFORM_BUFFER, m_computeShader.rayconfigUBO);
@@ -1344,27 +2513,14 @@ void Raycaster::Draw3DGridCompute(const Vector2f& pos, float pitch, const float
 	}
 
 	// Format & Bind screen texture
+	// Shaders only write the region covered by the current resolution, so storage is reserved at the maximum like the software path
+	renderer.ReserveBackgroundResolution(m_maxResolution.x, m_maxResolution.y, GL_R32F); // compute shaders bind depth as an r32f image
+	renderer.SetBackgroundResolution(m_rayConfig.xResolution, m_rayConfig.yResolution);
 	Spear::Texture& screenTexture = renderer.GetBackgroundTextureForNextFrame();
-	if(screenTexture.GetWidth() != m_rayConfig.xResolution || screenTexture.GetHeight() != m_rayConfig.yResolution)
-	{
-		screenTexture.Resize(m_rayConfig.xResolution, m_rayConfig.yResolution);
-	}
 	glBindImageTexture(0, screenTexture.GetGpuTextureId(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
 
-	// Format & Bind depth buffer
+	// Bind depth buffer
 	GLuint depthTexture = renderer.GetBackgroundDepthBufferForNextFrame();
-	glBindTexture(GL_TEXTURE_2D, depthTexture);
-	glTexImage2D(
-		GL_TEXTURE_2D,
-		0,
-		GL_R32F,
-		m_rayConfig.xResolution,
-		m_rayConfig.yResolution,
-		0,
-		GL_RED,
-		GL_FLOAT,
-		NULL
-	);
 	glBindImageTexture(1, depthTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
 
 	// Pass in TextureArray for world textures
@@ -1382,6 +2538,7 @@ void Raycaster::Draw3DGridCompute(const Vector2f& pos, float pitch, const float
 	{
 		glUseProgram(m_computeShader.program[i]);
 		glUniform2i(m_computeShader.gridDimensionsLoc[i], m_map->gridWidth, m_map->gridHeight);
+		glUniform1i(m_computeShader.chunksXLoc[i], m_map->chunksX);
 		glUniform1i(m_computeShader.spriteCountLoc[i], m_numSpritesToRender);
 		glUniform1i(m_computeShader.worldTexturesLoc[i], 0); // set sampler to read world textures from GL_TEXTURE0
 		glUniform1i(m_computeShader.spriteTexturesLoc[i], 1); // set sampler to read sprite textures from GL_TEXTURE1
@@ -1389,10 +2546,10 @@ void Raycaster::Draw3DGridCompute(const Vector2f& pos, float pitch, const float
 		switch (i)
 		{
 			case 0: // PLANES - 1 invocation per screen pixel
-				glDispatchCompute(screenTexture.GetWidth(), screenTexture.GetHeight(), 1);
+				glDispatchCompute(m_rayConfig.xResolution, m_rayConfig.yResolution, 1);
 				break;
 			case 1: // WALLS - 1 invocation per screen column
-				glDispatchCompute(screenTexture.GetWidth(), 1, 1);
+				glDispatchCompute(m_rayConfig.xResolution, 1, 1);
 				break;
 		}
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
@@ -1,8 +1,13 @@
 #pragma once
 #include "LevelData.h"
 #include "PanelRaycaster.h"
+#include "RaycastPlanesKernel.h"
 
 struct RaycasterConfig;
+namespace Spear
+{
+	class TextureBase;
+}
 
 struct RaycastSprite
 {
@@ -25,9 +30,30 @@ class Raycaster
 	};
 
 	static constexpr int RAYCAST_PORTAL_LIMIT{ 9 };
-	static constexpr int RAYCAST_SPRITE_LIMIT{ 100 };
 
 public:
+	// Timed sections of a 3D frame, reported through GetLastFrameStats
+	enum eRaycastPhase
+	{
+		PHASE_PREPROCESS_PORTALS,
+		PHASE_PREPROCESS_SPRITES,
+		PHASE_RAYCAST_PLANES,
+		PHASE_RAYCAST_WALLS,
+		PHASE_RAYCAST_SPRITES,
+		PHASE_RAYCAST_COLUMNS,
+		PHASE_RAYCAST_UPLOAD,
+
+		PHASE_TOTAL
+	};
+	static constexpr const char* PHASE_NAMES[PHASE_TOTAL] = { "Preprocess Portals", "Preprocess Sprites", "Raycast Planes", "Raycast Walls", "Raycast Sprites", "Raycast Columns", "Raycast Upload" };
+
+	// Gathered in every build configuration (unlike FrameProfiler) so tools can measure Release builds
+	struct RaycastFrameStats
+	{
+		float phaseMs[PHASE_TOTAL]{};
+		u64 outputChecksum{ 0 }; // hash of colour/depth output, only calculated while checksums are enabled
+	};
+
 	//static void SubmitNewGrid(u8 width, u8 height, const s8* pWorldIds, const u8* pRoofIds);
 	static void Init(MapData& map);
 	static RaycasterConfig GetConfigCopy();
@@ -43,36 +69,86 @@ public:
 	static void Draw2DGrid(const Vector2f& pos, const float angle);
 	static void Draw3DGrid(const Vector2f& pos, float pitch, const float angle);
 
+	// Stats for the most recent Draw3DGrid call
+	static const RaycastFrameStats& GetLastFrameStats();
+	static void SetOutputChecksumEnabled(bool bEnabled);
+
+	// Software renderer only: render each screen column in a single pass rather than separate planes/walls/sprites passes
+	static void SetColumnRenderingEnabled(bool bEnabled);
+
+	// Software renderer only: sample floors/ceilings/walls from smaller mip levels with distance
+	static void SetMipmappingEnabled(bool bEnabled);
+
+	// Software renderer only (separate passes): render alternate rows of floor/ceiling each frame, reprojecting the others from the previous frame
+	static void SetHalfRatePlanesEnabled(bool bEnabled);
+
+	// Software renderer only: walk rays through the grid with 16.16 fixed point lengths (see DDAFixed) rather than float
+	static void SetFixedPointDDAEnabled(bool bEnabled);
+
 private:
+	static void StartPhase(eRaycastPhase phase);
+	static void EndPhase(eRaycastPhase phase);
+	static u64 CalculateOutputChecksum();
+
 	static void RecreateBackgroundArrays(int width, int height);
+	static void ApplyResolutionScale();
+	static void UpdateDynamicResolution(float frameMs);
 	static void ClearRaycasterArrays();
+	static void ClearRows(int yLowerBound, int yUpperBound);
 
 	static void PreProcessPortals();
 	static void PreProcessSprites();
 	
+	template <typename Scalar>
+	static void Draw2DRay(const Vector2f& pos, Vector2f rayDir, const Vector2f& camOffset, float lineDepth); // draws the segments of one ray of Draw2DGrid, split at each mirror/portal
 	static void Draw3DGridCPU(const Vector2f& pos, float pitch, const float angle);
+	static void RaycastPassesCPU();
+	static void RaycastColumnsCPU();
 	static void Draw3DGridCompute(const Vector2f& pos, float pitch, const float angle);
 
 	// ImGui Panel
 	static PanelRaycaster debugPanel;
 
 	// (INPUT) Raycast Data
-	static RaycasterConfig m_rayConfig;
+	static RaycasterConfig m_rayConfig; // x/yResolution are the resolution currently rendered, see m_maxResolution
 	static MapData* m_map;
 
+	// Dynamic resolution: buffers are allocated once for m_maxResolution (the configured x/yResolution) and frames render at m_resolutionScale of it
+	struct DynamicResolutionState
+	{
+		float scale{ 1.f };
+		float averageFrameMs{ 0.f };
+		int framesSinceChange{ 0 };
+	};
+	static Vector2i m_maxResolution;
+	static DynamicResolutionState m_dynamicResolution;
+
 	// (OUTPUT) Depth/Texture Data
-	static GLfloat* m_bgTexDepth;
+	static Spear::BackgroundDepth* m_bgTexDepth;
 	static GLuint* m_bgTexRGBA;
+	static Spear::BackgroundDepth* m_localTexDepth;	// owned arrays which m_bgTex* point at, except while rendering into the renderer's staging buffers
+	static GLuint* m_localTexRGBA;
 	
 	// (RENDERING SETTINGS)
 	friend class PanelRaycaster;
 	static bool m_bSoftwareRendering;
 	static bool m_bPortalRenderingEnabled;
-	static int m_softwareRenderingThreads;
-	static int XResolutionPerThread();
-	static int YResolutionPerThread();
+	static bool m_bSimdPlanes;
+	static RaycastPlanesKernel::PixelsFunction m_planesKernel; // selected from m_bSimdPlanes and CPU support
+	static bool m_bColumnRendering;
+	static bool m_bMipmapping;
+	static bool m_bHalfRatePlanes;
+	static bool m_bFixedPointDDA;
+	static int TileFlagsBufferSize();
+	static void UploadMapToGPU();
 
-	static RaycastSprite m_sprites[RAYCAST_SPRITE_LIMIT];
+	// (STATS)
+	static RaycastFrameStats m_frameStats;
+	static u64 m_phaseStartTimestamps[PHASE_TOTAL];
+	static bool m_bOutputChecksumEnabled;
+
+	// Grows to the most sprites ever submitted in a frame and is then reused, ClearSprites only resets the count
+	static std::vector<RaycastSprite> m_sprites;
 	static int m_spriteCount;
 
 	// For storing internal per-frame data
@@ -109,19 +185,115 @@ private:
 
 	struct RaycastSpriteData
 	{
+		// CAUTION - CHANGES MADE TO THIS STRUCT MUST BE REFLECTED IN RAYCASTER COMPUTE SHADER
+		// ===================================================================================
+
 		Vector2i spriteStart;
 		Vector2i spriteEnd;
 		int spriteTex;
 		float spriteDepth;
+		int portalTrace{ 0 };	// 0 if seen directly, otherwise the portal trace (ie. number of mirror/portal bounces) it's seen through
+		int portalWindow{ -1 };	// m_portalWindows entry it's seen through, only drawn in that window's columns
 	};
-	static RaycastSpriteData m_frameSprites[RAYCAST_SPRITE_LIMIT];
+	static bool ProjectSprite(const RaycastSprite& sprite, const Vector2f& position, RaycastSpriteData& outSprite); // returns false if not on screen
+	static bool IsSpriteVisibleInColumn(const RaycastSpriteData& sprite, int screenX); // against the mirrors/portals in the column
+	static std::vector<RaycastSpriteData> m_frameSprites; // sorted furthest first, only the first m_numSpritesToRender are this frame's
 	static int m_numSpritesToRender;
+
+	// Sprites seen through mirrors/portals this frame, before being cut down to SPRITE_PORTAL_CLONE_LIMIT and added to m_frameSprites
+	struct SpriteCloneCandidate
+	{
+		RaycastSpriteData projected;
+		int spriteIndex; // m_sprites entry it's a clone of
+	};
+	static std::vector<SpriteCloneCandidate> m_spriteCloneCandidates;
+
+	// Sprites binned into screen tiles by PreProcessSprites, so rendering only visits the sprites which overlap each tile
+	// Indices of the sprites overlapping tile t (furthest first) are m_spriteBinSprites[m_spriteBinStarts[t]] until m_spriteBinStarts[t + 1]
+	static void BinSprites();
+	static void DrawSpriteTile(int tileIndex, const Spear::TextureBase* pSpriteTextures, int xLowerBound, int xUpperBound); // only the columns of the tile within the bounds
+	static int m_spriteTilesX;
+	static int m_spriteTilesY;
+	static std::vector<int> m_spriteBinStarts;
+	static std::vector<int> m_spriteBinSprites;
+
+	// Optional wall features. RaycastWallColumn is compiled for every combination, so maps which never use a feature don't test for it per ray/pixel.
+	enum eWallFeatures : u8
+	{
+		WALL_PORTALS = 1 << 0,		// mirrors/portals redirect rays
+		WALL_DRAW_FLAGS = 1 << 1,	// walls may hide some of their faces (eDrawFlags)
+		WALL_MULTI_STOREY = 1 << 2,	// walls may extend up/down (GridNode::extendUp/extendDown)
+
+		WALL_FEATURES_ALL = WALL_PORTALS | WALL_DRAW_FLAGS | WALL_MULTI_STOREY
+	};
+	static u8 m_mapWallFeatures; // found across the whole map at Init (WALL_PORTALS follows m_bPortalRenderingEnabled instead)
+
+	// Wall-to-plane seam found while drawing a wall column, see FixColumnSeam
+	struct ColumnSeam
+	{
+		int yStart;
+		int yStep;
+		GLuint correctivePixel;
+		float renderDepth;
+	};
+
+	// Fixed point (16.16) steps for walking a sprite's texture across/down the screen, worked out once per sprite rather than per pixel
+	struct SpriteSampling
+	{
+		s64 texXStep;	// texels per screen column
+		s64 texYStep;	// texels per screen row (texture rows are walked bottom to top down the screen)
+		Spear::BackgroundDepth depth;
+	};
+	static SpriteSampling PrepareSpriteSampling(const RaycastSpriteData& sprite, const Spear::TextureBase* pSpriteTextures);
+
+	// Per-column/row building blocks shared by RaycastPassesCPU and RaycastColumnsCPU
+	static int SelectMipLevel(const Spear::TextureBase* pTextures, float texelsPerPixel); // 0 if mipmapping is disabled
+	static bool IsFloorRow(int y);
+	static bool PreparePlaneRow(int y, const Spear::TextureBase* pMapTextures, PlaneRowParams& outRow); // returns false if row has no floor/ceiling to draw
+	static bool SamplePlanePixel(const PlaneRowParams& row, int x, u32& outTexel, Spear::BackgroundDepth& outDepth); // returns false if no layer has a texture at this pixel
+	template <typename Scalar, u8 Features>
+	static void RaycastWallColumn(int screenX, const Spear::TextureBase* pMapTextures, std::vector<ColumnSeam>* pDeferredSeams); // seams are fixed immediately if pDeferredSeams is null. Scalar picks the GridDDA lengths, Features the eWallFeatures compiled in.
+	using WallColumnFunction = void(*)(int screenX, const Spear::TextureBase* pMapTextures, std::vector<ColumnSeam>* pDeferredSeams);
+	static WallColumnFunction SelectWallColumn(); // variant of RaycastWallColumn for this frame's settings and the map's features
+	template <typename Scalar>
+	static WallColumnFunction SelectWallColumn(u8 features);
+	static void FixColumnSeam(int screenX, const ColumnSeam& seam);
+	static void DrawSpriteColumn(const RaycastSpriteData& sprite, const SpriteSampling& sampling, const Spear::TextureBase* pSpriteTextures, int screenX, int yLowerBound, int yUpperBound);
+	static PlaneRowParams* m_planeRows; // prepared once per frame for RaycastColumnsCPU
+
+	// Half-rate planes: the previous frame's floor/ceiling (kept before walls/sprites cover it) and the camera it was rendered from
+	// Every row is rendered instead after large camera movements, config/map changes, or while portals are in view (their sample points aren't a straight walk across the row)
+	struct PlaneHistory
+	{
+		GLuint* pRGBA[2]{};		// [current] is written this frame, [!current] holds the previous frame
+		u8* pLayerIds[2]{};		// PlaneLayerId of each pixel, 0 where no layer had a texture
+		int current{ 0 };
+		int rowParity{ 0 };		// rows rendered (rather than reprojected) this frame are those where (y & 1) == rowParity
+		bool bValid{ false };
+		bool bPortalsInView{ false };
+		RaycastFrameData frame;
+	};
+	static PlaneHistory m_planeHistory;
+	static u8 PlaneLayerId(bool bIsFloor, int layer) { return static_cast<u8>(1 + layer + (bIsFloor ? 0 : 2)); }
+	static bool PortalsInView();
+	static bool CanReprojectPlanes(bool bPortalsInView);
+	template <bool bPortalsInView>
+	static void DrawPlaneRow(const PlaneRowParams& row); // every pixel, sampling columns which look through portals per pixel (if any are in view this frame)
+	static void ResolvePlaneLayerIds(const PlaneRowParams& row, bool bIsFloor, u8* pOutLayerIds); // from the depths written by DrawPlaneRow
+	static void ReprojectPlaneRow(const PlaneRowParams& row, bool bIsFloor, u8* pOutLayerIds); // pixels which can't be found in the previous frame are sampled instead
 	
 	struct PortalTrace
 	{
 		Vector2f rayStart;
 		Vector2f rayTrajectory;
 		float accumulatedLength;
+
+		// Maps world positions along this trace to where they appear along the unbent ray: unfoldScale * position + unfoldOffset
+		// Mirrors and portals are axis aligned, so each bounce only ever flips the sign of one or both axes
+		Vector2f unfoldScale;
+		Vector2f unfoldOffset;
+		float nearDistance;	// forward (view space) distance at which this trace starts
+		int window;			// m_portalWindows entry this trace belongs to (traces beyond the first only)
 	};
 	struct PortalTraces
 	{
@@ -131,12 +303,75 @@ private:
 	};
 	static PortalTraces* m_portalTraces;
 
+	// Each column remembers the last traces it searched for and the faces they ended on, so while the view moves a little its traces are re-solved against those faces instead of searched again
+	struct PortalFace
+	{
+		Vector2i tile;
+		bool bVerticalHit;
+		int stepSign; // direction the trace crossed the face in, along the axis the face lies across
+	};
+	struct PortalSearch
+	{
+		int finalTrace{ -1 }; // -1 until the column has been searched
+		int refreshBackoff{ 0 }; // frames to search outright after a refresh fails, doubling while they keep failing (eg. sweeping past lots of mirrors)
+		int refreshDelay{ 0 };
+		PortalFace faces[RAYCAST_PORTAL_LIMIT];
+		bool bReachedMirrors[RAYCAST_PORTAL_LIMIT + 1];
+		Vector2f starts[RAYCAST_PORTAL_LIMIT + 1]; // each trace clipped to the mirror bounds
+		Vector2f ends[RAYCAST_PORTAL_LIMIT + 1];
+		bool bClearChecked[RAYCAST_PORTAL_LIMIT + 1]; // bClear is only worked out once a refresh needs it
+		bool bClear[RAYCAST_PORTAL_LIMIT + 1]; // no mirror within a tile of the clipped trace, other than behind the faces it starts and ends on
+	};
+	static PortalSearch* m_portalSearches;
+	static bool TracePortalColumn(int screenX, const Vector2f& rayEnd, bool bRefresh); // false if a refresh couldn't reuse the column's last search
+	static bool IsPortalTraceClear(const Vector2f& start, const Vector2f& end, const PortalFace* pStartFace, const PortalFace* pEndFace);
+
+	// Traces only depend on the view and the (static) map, so they're kept while the view doesn't change
+	struct PortalTraceView
+	{
+		const MapData* pMap{ nullptr };
+		Vector2f viewPos;
+		Vector2f fovMinAngle;
+		Vector2f fovMaxAngle;
+		float traceLength{ 0.f };
+		int xResolution{ 0 };
+	};
+	static PortalTraceView m_portalTraceView;
+	static bool m_bPortalTracesValid;
+
+	// Neighbouring columns whose trace at the same depth unfolds identically (eg. all looking into one mirror): sprites seen through a window are projected once for all of its columns
+	struct PortalWindow
+	{
+		int trace;
+		int xStart;
+		int xEnd; // inclusive
+		Vector2f unfoldScale;
+		Vector2f unfoldOffset;
+		float nearDistance; // nearest of its columns' trace nearDistance
+	};
+	static void BuildPortalWindows();
+	static std::vector<PortalWindow> m_portalWindows;
+
+	// Built at Init: bounds of every mirror tile (rays which never reach them skip the portal search), and which tiles around them touch one
+	static void BuildMirrorBounds();
+	static bool CanReachMirrors(const Vector2f& start, const Vector2f& end);
+	static bool ClipToMirrorBounds(const Vector2f& start, const Vector2f& end, Vector2f& outStart, Vector2f& outEnd);
+	static bool IsNearMirror(int x, int y); // a mirror tile among this tile and its neighbours
+	static Vector2f m_mirrorBoundsMin;
+	static Vector2f m_mirrorBoundsMax;
+	static std::vector<u8> m_mirrorHalo;
+	static Vector2i m_mirrorHaloMin;
+	static Vector2i m_mirrorHaloSize;
+
 	struct RaycastComputeShader
 	{
 		bool isInitialised{ false };
 
 		GLuint gridnodesSSBO{ 0 }; // SSBO - Shader Storage Buffer Object
+		GLuint tileFlagsSSBO{ 0 };
+		GLuint chunkSlotsSSBO{ 0 };
 		GLuint spritesSSBO{ 0 }; 
+		int spritesCapacity{ 0 }; // sprites spritesSSBO currently has room for
 		GLuint rayconfigUBO{ 0 }; // UBO - Uniform Buffer Object
 		GLuint framedataUBO{0};
 
@@ -144,6 +379,7 @@ private:
 		static const int programSize{2};
 		GLuint program[programSize];
 		GLuint gridDimensionsLoc[programSize];
+		GLuint chunksXLoc[programSize];
 		GLuint worldTexturesLoc[programSize];
 		GLuint spriteTexturesLoc[programSize];
 		GLuint spriteCountLoc[programSize];
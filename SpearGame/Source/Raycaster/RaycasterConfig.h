@@ -14,6 +14,11 @@ struct RaycasterConfig
 	// Used only for 2D top-down rendering. Scale 1 = 1 tile : 1 pixel.
 	float scale2D{ 75.f };
 
+	// Dynamic resolution: x/yResolution become the maximum, and the raycaster renders at a fraction of it (down to dynamicResolutionMinScale) to keep its own frame time within dynamicResolutionTargetMs
+	bool dynamicResolution{ false };
+	float dynamicResolutionTargetMs{ 8.f };
+	float dynamicResolutionMinScale{ 0.5f };
+
 	// Debug settings
 	bool highlightCorrectivePixels{ false };		// whether to render corrective pixels as BrightRed instead of using pixel-cloning
 	float correctivePixelDepthTolerance{ 0.01f };	// depth tolerance for considering other pixels when stitching seams together